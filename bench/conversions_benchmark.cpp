@@ -0,0 +1,523 @@
+/*
+ * UOS-ROS packages - Robot Operating System code by the University of Osnabrück
+ * Copyright (C) 2013 University of Osnabrück
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * conversions_benchmark.cpp
+ *
+ * Google Benchmark suite of the converters in conversions.h on synthetic point clouds and
+ * meshes from 10k to 50M elements. Reports points/s, bytes/s and heap allocations per
+ * iteration. Needs no ROS master, e.g.
+ *
+ *   lvr_ros_conversions_benchmark --benchmark_filter=PointCloud2 --benchmark_min_time=1
+ *
+ */
+
+#include "lvr_ros/conversions.h"
+#include "lvr_ros/serialization.h"
+
+#include <benchmark/benchmark.h>
+
+#include <atomic>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <new>
+
+#include <ros/console.h>
+#include <ros/serialization.h>
+#include <ros/time.h>
+
+/* heap allocation counting */
+
+namespace
+{
+std::atomic<size_t> g_allocations(0);
+std::atomic<size_t> g_allocated_bytes(0);
+
+void* countedAlloc(size_t size)
+{
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    g_allocated_bytes.fetch_add(size, std::memory_order_relaxed);
+    if (void* ptr = std::malloc(size ? size : 1))
+    {
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+} // namespace
+
+void* operator new(size_t size) { return countedAlloc(size); }
+void* operator new[](size_t size) { return countedAlloc(size); }
+void operator delete(void* ptr) noexcept { std::free(ptr); }
+void operator delete[](void* ptr) noexcept { std::free(ptr); }
+void operator delete(void* ptr, size_t) noexcept { std::free(ptr); }
+void operator delete[](void* ptr, size_t) noexcept { std::free(ptr); }
+
+namespace
+{
+
+/**
+ * Reports the allocations of the timed loop and the throughput of a benchmark
+ */
+class Throughput
+{
+public:
+    Throughput(benchmark::State& state)
+        : m_state(state),
+          m_allocations(g_allocations.load()),
+          m_bytes(g_allocated_bytes.load())
+    {
+    }
+
+    void report(size_t items, size_t bytes)
+    {
+        m_state.SetItemsProcessed(m_state.iterations() * items);
+        m_state.SetBytesProcessed(m_state.iterations() * bytes);
+        m_state.counters["allocs"] = benchmark::Counter(
+            static_cast<double>(g_allocations.load() - m_allocations), benchmark::Counter::kAvgIterations);
+        m_state.counters["alloc_bytes"] = benchmark::Counter(
+            static_cast<double>(g_allocated_bytes.load() - m_bytes), benchmark::Counter::kAvgIterations,
+            benchmark::Counter::OneK::kIs1024);
+    }
+
+private:
+    benchmark::State& m_state;
+    size_t m_allocations;
+    size_t m_bytes;
+};
+
+/* synthetic data */
+
+enum CloudLayout
+{
+    XYZ,                        // packed xyz
+    XYZ_PADDED,                 // xyz padded to 16 bytes, like pcl::PointXYZ
+    XYZ_RGB,                    // xyz and packed rgb
+    XYZ_NORMAL_RGB_INTENSITY,   // xyz, normals, rgb and intensity
+    XYZ_ORGANIZED_NAN           // organized 640 wide cloud with 30% invalid returns
+};
+
+sensor_msgs::PointCloud2 createCloud(size_t n, CloudLayout layout)
+{
+    sensor_msgs::PointCloud2 cloud;
+    int offset = 0;
+    offset = sensor_msgs::addPointField(cloud, "x", 1, sensor_msgs::PointField::FLOAT32, offset);
+    offset = sensor_msgs::addPointField(cloud, "y", 1, sensor_msgs::PointField::FLOAT32, offset);
+    offset = sensor_msgs::addPointField(cloud, "z", 1, sensor_msgs::PointField::FLOAT32, offset);
+    if (layout == XYZ_PADDED)
+    {
+        offset += sizeof(float);
+    }
+    if (layout == XYZ_NORMAL_RGB_INTENSITY)
+    {
+        offset = sensor_msgs::addPointField(cloud, "normal_x", 1, sensor_msgs::PointField::FLOAT32, offset);
+        offset = sensor_msgs::addPointField(cloud, "normal_y", 1, sensor_msgs::PointField::FLOAT32, offset);
+        offset = sensor_msgs::addPointField(cloud, "normal_z", 1, sensor_msgs::PointField::FLOAT32, offset);
+    }
+    if (layout == XYZ_RGB || layout == XYZ_NORMAL_RGB_INTENSITY)
+    {
+        offset = sensor_msgs::addPointField(cloud, "rgb", 1, sensor_msgs::PointField::FLOAT32, offset);
+    }
+    if (layout == XYZ_NORMAL_RGB_INTENSITY)
+    {
+        offset = sensor_msgs::addPointField(cloud, "intensity", 1, sensor_msgs::PointField::FLOAT32, offset);
+    }
+
+    cloud.point_step = offset;
+    cloud.width = layout == XYZ_ORGANIZED_NAN ? 640 : n;
+    cloud.height = layout == XYZ_ORGANIZED_NAN ? (n + 639) / 640 : 1;
+    cloud.row_step = cloud.width * cloud.point_step;
+    cloud.is_dense = layout != XYZ_ORGANIZED_NAN;
+    cloud.data.resize(cloud.height * cloud.row_step);
+
+    const size_t num_points = cloud.width * cloud.height;
+    for (size_t i = 0; i < num_points; i++)
+    {
+        uint8_t* point = &cloud.data[i * cloud.point_step];
+        float values[8] = {
+            std::sin(i * 0.001f) * 10.0f, std::cos(i * 0.001f) * 10.0f, i * 1e-6f,
+            0.0f, 0.0f, 1.0f, 0.0f, static_cast<float>(i % 256)
+        };
+        if (layout == XYZ_ORGANIZED_NAN && (i * 2654435761u) % 10 < 3)
+        {
+            values[0] = values[1] = values[2] = std::numeric_limits<float>::quiet_NaN();
+        }
+        const uint32_t rgb = static_cast<uint32_t>(i * 2654435761u) & 0xffffff;
+        std::memcpy(values + 6, &rgb, sizeof(rgb));
+        for (const auto& field : cloud.fields)
+        {
+            const int index = field.name == "x" ? 0 : field.name == "y" ? 1 : field.name == "z" ? 2
+                : field.name == "normal_x" ? 3 : field.name == "normal_y" ? 4 : field.name == "normal_z" ? 5
+                : field.name == "rgb" ? 6 : 7;
+            std::memcpy(point + field.offset, values + index, sizeof(float));
+        }
+    }
+    return cloud;
+}
+
+lvr2::PointBufferPtr createPointBuffer(size_t n)
+{
+    lvr2::PointBufferPtr buffer(new lvr2::PointBuffer);
+    lvr2::floatArr points(new float[n * 3]);
+    lvr2::ucharArr colors(new unsigned char[n * 3]);
+    lvr2::floatArr intensities(new float[n]);
+    boost::shared_array<double> stamps(new double[n]);
+    for (size_t i = 0; i < n; i++)
+    {
+        points[i * 3] = std::sin(i * 0.001f);
+        points[i * 3 + 1] = std::cos(i * 0.001f);
+        points[i * 3 + 2] = i * 1e-6f;
+        colors[i * 3] = colors[i * 3 + 1] = colors[i * 3 + 2] = static_cast<unsigned char>(i);
+        intensities[i] = static_cast<float>(i % 256);
+        stamps[i] = i * 1e-5;
+    }
+    buffer->setPointArray(points, n);
+    buffer->setColorArray(colors, n);
+    buffer->addFloatChannel(intensities, "intensity", n, 1);
+    buffer->addChannel<double>(stamps, "time", n, 1);
+    return buffer;
+}
+
+/**
+ * Regular grid mesh with about n vertices, normals and colors. With duplicate_rows, every
+ * other row of quads gets its own copy of its upper vertices, as tiled reconstructions do.
+ */
+lvr2::MeshBufferPtr createMeshBuffer(size_t n, bool duplicate_rows = false)
+{
+    const size_t width = std::max<size_t>(2, static_cast<size_t>(std::sqrt(static_cast<double>(n))));
+    const size_t height = std::max<size_t>(2, n / width);
+    const size_t num_grid = width * height;
+    const size_t num_extra = duplicate_rows ? (height / 2) * width : 0;
+    const size_t num_vertices = num_grid + num_extra;
+    const size_t num_faces = (width - 1) * (height - 1) * 2;
+
+    lvr2::floatArr vertices(new float[num_vertices * 3]);
+    lvr2::floatArr normals(new float[num_vertices * 3]);
+    lvr2::ucharArr colors(new unsigned char[num_vertices * 3]);
+    for (size_t i = 0; i < num_vertices; i++)
+    {
+        const size_t grid = i < num_grid ? i : ((i - num_grid) / width * 2 + 1) * width + (i - num_grid) % width;
+        vertices[i * 3] = static_cast<float>(grid % width);
+        vertices[i * 3 + 1] = static_cast<float>(grid / width);
+        vertices[i * 3 + 2] = std::sin(grid * 0.01f);
+        normals[i * 3] = 0.0f;
+        normals[i * 3 + 1] = 0.0f;
+        normals[i * 3 + 2] = 1.0f;
+        colors[i * 3] = colors[i * 3 + 1] = colors[i * 3 + 2] = static_cast<unsigned char>(grid);
+    }
+
+    lvr2::indexArray faces(new unsigned int[num_faces * 3]);
+    size_t f = 0;
+    for (size_t y = 0; y + 1 < height; y++)
+    {
+        for (size_t x = 0; x + 1 < width; x++)
+        {
+            const unsigned int a = y * width + x;
+            const unsigned int b = a + 1;
+            unsigned int c = a + width;
+            unsigned int d = c + 1;
+            if (duplicate_rows && (y + 1) % 2 == 1)
+            {
+                // the upper vertices of odd rows use the copies
+                c = num_grid + (y / 2) * width + x;
+                d = c + 1;
+            }
+            const unsigned int face[6] = {a, b, c, b, d, c};
+            std::memcpy(&faces[f * 3], face, sizeof(face));
+            f += 2;
+        }
+    }
+
+    lvr2::MeshBufferPtr buffer(new lvr2::MeshBuffer);
+    buffer->setVertices(vertices, num_vertices);
+    buffer->setVertexNormals(normals);
+    buffer->setVertexColors(colors, 3);
+    buffer->setFaceIndices(faces, num_faces);
+    return buffer;
+}
+
+size_t meshBytes(const lvr2::MeshBufferPtr& buffer)
+{
+    return buffer->numVertices() * 6 * sizeof(float) + buffer->numFaces() * 3 * sizeof(uint32_t);
+}
+
+void cloudArguments(benchmark::internal::Benchmark* benchmark)
+{
+    for (int layout : {XYZ, XYZ_PADDED, XYZ_RGB, XYZ_NORMAL_RGB_INTENSITY, XYZ_ORGANIZED_NAN})
+    {
+        for (int64_t n : {10000, 100000, 1000000, 10000000, 50000000})
+        {
+            benchmark->Args({n, layout});
+        }
+    }
+    benchmark->ArgNames({"points", "layout"})->Unit(benchmark::kMillisecond)->UseRealTime();
+}
+
+void sizeArguments(benchmark::internal::Benchmark* benchmark)
+{
+    for (int64_t n : {10000, 100000, 1000000, 10000000, 50000000})
+    {
+        benchmark->Arg(n);
+    }
+    benchmark->ArgName("elements")->Unit(benchmark::kMillisecond)->UseRealTime();
+}
+
+/* point clouds */
+
+void BM_fromPointCloud2ToPointBuffer(benchmark::State& state)
+{
+    const sensor_msgs::PointCloud2 cloud = createCloud(state.range(0), static_cast<CloudLayout>(state.range(1)));
+    Throughput throughput(state);
+    for (auto _ : state)
+    {
+        lvr2::PointBuffer buffer;
+        benchmark::DoNotOptimize(lvr_ros::fromPointCloud2ToPointBuffer(cloud, buffer));
+    }
+    throughput.report(cloud.width * cloud.height, cloud.data.size());
+}
+BENCHMARK(BM_fromPointCloud2ToPointBuffer)->Apply(cloudArguments);
+
+void BM_fromPointCloud2ToPointBufferDropNonFinite(benchmark::State& state)
+{
+    const sensor_msgs::PointCloud2 cloud = createCloud(state.range(0), static_cast<CloudLayout>(state.range(1)));
+    Throughput throughput(state);
+    for (auto _ : state)
+    {
+        lvr2::PointBuffer buffer;
+        lvr2::BoundingBox<lvr_ros::Vec> bounding_box;
+        size_t num_dropped = 0;
+        benchmark::DoNotOptimize(lvr_ros::fromPointCloud2ToPointBuffer(cloud, buffer, bounding_box, true, &num_dropped));
+    }
+    throughput.report(cloud.width * cloud.height, cloud.data.size());
+}
+BENCHMARK(BM_fromPointCloud2ToPointBufferDropNonFinite)->Apply(cloudArguments);
+
+void BM_PointCloud2ToPointBuffer(benchmark::State& state)
+{
+    const sensor_msgs::PointCloud2Ptr cloud(
+        new sensor_msgs::PointCloud2(createCloud(state.range(0), static_cast<CloudLayout>(state.range(1)))));
+    Throughput throughput(state);
+    for (auto _ : state)
+    {
+        lvr2::PointBufferPtr buffer;
+        lvr_ros::PointCloud2ToPointBuffer(cloud, buffer);
+        benchmark::DoNotOptimize(buffer);
+    }
+    throughput.report(cloud->width * cloud->height, cloud->data.size());
+}
+BENCHMARK(BM_PointCloud2ToPointBuffer)->Apply(cloudArguments);
+
+void BM_PointBufferToPointCloud2(benchmark::State& state)
+{
+    const size_t n = state.range(0);
+    const lvr2::PointBufferPtr buffer = createPointBuffer(n);
+    const bool aligned = state.range(1) != 0;
+    size_t bytes = 0;
+    Throughput throughput(state);
+    for (auto _ : state)
+    {
+        sensor_msgs::PointCloud2Ptr cloud(new sensor_msgs::PointCloud2);
+        lvr_ros::PointBufferToPointCloud2(buffer, "map", cloud, aligned);
+        bytes = cloud->data.size();
+        benchmark::DoNotOptimize(cloud->data.data());
+    }
+    throughput.report(n, bytes);
+}
+BENCHMARK(BM_PointBufferToPointCloud2)
+    ->ArgsProduct({{10000, 100000, 1000000, 10000000, 50000000}, {0, 1}})
+    ->ArgNames({"points", "aligned"})->Unit(benchmark::kMillisecond)->UseRealTime();
+
+/* meshes */
+
+void BM_fromMeshBufferToMeshGeometryMessage(benchmark::State& state)
+{
+    const lvr2::MeshBufferPtr buffer = createMeshBuffer(state.range(0));
+    Throughput throughput(state);
+    for (auto _ : state)
+    {
+        mesh_msgs::MeshGeometry mesh_geometry;
+        benchmark::DoNotOptimize(lvr_ros::fromMeshBufferToMeshGeometryMessage(buffer, mesh_geometry));
+    }
+    throughput.report(buffer->numVertices(), meshBytes(buffer));
+}
+BENCHMARK(BM_fromMeshBufferToMeshGeometryMessage)->Apply(sizeArguments);
+
+void BM_fromMeshGeometryMessageToMeshBuffer(benchmark::State& state)
+{
+    const lvr2::MeshBufferPtr source = createMeshBuffer(state.range(0));
+    mesh_msgs::MeshGeometry mesh_geometry;
+    lvr_ros::fromMeshBufferToMeshGeometryMessage(source, mesh_geometry);
+    Throughput throughput(state);
+    for (auto _ : state)
+    {
+        lvr2::MeshBufferPtr buffer(new lvr2::MeshBuffer);
+        benchmark::DoNotOptimize(lvr_ros::fromMeshGeometryMessageToMeshBuffer(mesh_geometry, buffer));
+    }
+    throughput.report(source->numVertices(), meshBytes(source));
+}
+BENCHMARK(BM_fromMeshGeometryMessageToMeshBuffer)->Apply(sizeArguments);
+
+void BM_fromMeshGeometryToMeshBuffer(benchmark::State& state)
+{
+    const lvr2::MeshBufferPtr source = createMeshBuffer(state.range(0));
+    mesh_msgs::MeshGeometry mesh_geometry;
+    lvr_ros::fromMeshBufferToMeshGeometryMessage(source, mesh_geometry);
+    Throughput throughput(state);
+    for (auto _ : state)
+    {
+        lvr2::MeshBuffer buffer;
+        benchmark::DoNotOptimize(lvr_ros::fromMeshGeometryToMeshBuffer(mesh_geometry, buffer));
+    }
+    throughput.report(source->numVertices(), meshBytes(source));
+}
+BENCHMARK(BM_fromMeshGeometryToMeshBuffer)->Apply(sizeArguments);
+
+void BM_fromMeshBufferToTriangleMesh(benchmark::State& state)
+{
+    const lvr2::MeshBufferPtr buffer = createMeshBuffer(state.range(0));
+    Throughput throughput(state);
+    for (auto _ : state)
+    {
+        mesh_msgs::MeshGeometry mesh_geometry;
+        benchmark::DoNotOptimize(lvr_ros::fromMeshBufferToTriangleMesh(buffer, mesh_geometry));
+    }
+    throughput.report(buffer->numVertices(), meshBytes(buffer));
+}
+BENCHMARK(BM_fromMeshBufferToTriangleMesh)->Apply(sizeArguments);
+
+void BM_fromMeshBufferToMeshAttributeMessages(benchmark::State& state)
+{
+    const lvr2::MeshBufferPtr buffer = createMeshBuffer(state.range(0));
+    Throughput throughput(state);
+    for (auto _ : state)
+    {
+        mesh_msgs::MeshMaterials materials;
+        mesh_msgs::MeshVertexColors colors;
+        benchmark::DoNotOptimize(lvr_ros::fromMeshBufferToMeshAttributeMessages(
+            buffer, materials, colors, boost::none, "benchmark"));
+    }
+    throughput.report(buffer->numVertices(), buffer->numVertices() * 3);
+}
+BENCHMARK(BM_fromMeshBufferToMeshAttributeMessages)->Apply(sizeArguments);
+
+void BM_serializeMeshBufferGeometryStamped(benchmark::State& state)
+{
+    lvr_ros::MeshBufferGeometryStamped message;
+    message.mesh_buffer = createMeshBuffer(state.range(0));
+    size_t bytes = 0;
+    Throughput throughput(state);
+    for (auto _ : state)
+    {
+        ros::SerializedMessage serialized = ros::serialization::serializeMessage(message);
+        bytes = serialized.num_bytes;
+        benchmark::DoNotOptimize(serialized.buf.get());
+    }
+    throughput.report(message.mesh_buffer->numVertices(), bytes);
+}
+BENCHMARK(BM_serializeMeshBufferGeometryStamped)->Apply(sizeArguments);
+
+void BM_serializeMeshGeometryStamped(benchmark::State& state)
+{
+    const lvr2::MeshBufferPtr buffer = createMeshBuffer(state.range(0));
+    size_t bytes = 0;
+    Throughput throughput(state);
+    for (auto _ : state)
+    {
+        // the message has to be built before it can be serialized
+        mesh_msgs::MeshGeometryStamped message;
+        lvr_ros::fromMeshBufferToMeshGeometryMessage(buffer, message.mesh_geometry);
+        ros::SerializedMessage serialized = ros::serialization::serializeMessage(message);
+        bytes = serialized.num_bytes;
+        benchmark::DoNotOptimize(serialized.buf.get());
+    }
+    throughput.report(buffer->numVertices(), bytes);
+}
+BENCHMARK(BM_serializeMeshGeometryStamped)->Apply(sizeArguments);
+
+void BM_weldVertices(benchmark::State& state)
+{
+    const lvr2::MeshBufferPtr source = createMeshBuffer(state.range(0), true);
+    Throughput throughput(state);
+    for (auto _ : state)
+    {
+        state.PauseTiming();
+        lvr2::MeshBuffer buffer;
+        buffer.setVertices(source->getVertices(), source->numVertices());
+        buffer.setVertexNormals(source->getVertexNormals());
+        buffer.setFaceIndices(source->getFaceIndices(), source->numFaces());
+        state.ResumeTiming();
+        benchmark::DoNotOptimize(lvr_ros::weldVertices(buffer, 1e-4f));
+    }
+    throughput.report(source->numVertices(), meshBytes(source));
+}
+BENCHMARK(BM_weldVertices)->Apply(sizeArguments);
+
+void BM_intensityToVertexColors(benchmark::State& state)
+{
+    const size_t n = state.range(0);
+    std::vector<float> intensity(n);
+    for (size_t i = 0; i < n; i++)
+    {
+        intensity[i] = std::sin(i * 0.001f);
+    }
+    Throughput throughput(state);
+    for (auto _ : state)
+    {
+        mesh_msgs::MeshVertexColors colors;
+        lvr_ros::intensityToVertexRainbowColors(intensity, colors);
+        benchmark::DoNotOptimize(colors.vertex_colors.data());
+    }
+    throughput.report(n, n * (sizeof(float) + sizeof(std_msgs::ColorRGBA)));
+}
+BENCHMARK(BM_intensityToVertexColors)->Apply(sizeArguments);
+
+void BM_toMeshGeometry(benchmark::State& state)
+{
+    const lvr2::MeshBufferPtr buffer = createMeshBuffer(state.range(0));
+    const lvr2::HalfEdgeMesh<lvr_ros::Vec> hem(buffer);
+    Throughput throughput(state);
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(lvr_ros::toMeshGeometry<float>(hem));
+    }
+    throughput.report(buffer->numVertices(), meshBytes(buffer));
+}
+BENCHMARK(BM_toMeshGeometry)->Apply(sizeArguments);
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    // the converters stamp their messages, without a node the time has to be initialized
+    ros::Time::init();
+
+    // keep the progress output of the converters out of the timings
+    if (ros::console::set_logger_level(ROSCONSOLE_DEFAULT_NAME, ros::console::levels::Warn))
+    {
+        ros::console::notifyLoggerLevelsChanged();
+    }
+
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv))
+    {
+        return 1;
+    }
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return 0;
+}
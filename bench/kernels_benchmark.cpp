@@ -0,0 +1,142 @@
+/*
+ * UOS-ROS packages - Robot Operating System code by the University of Osnabrück
+ * Copyright (C) 2013 University of Osnabrück
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * kernels_benchmark.cpp
+ *
+ * Compares the bulk conversion kernels against the element by element loops they
+ * replaced in conversions.cpp. Usage: lvr_ros_kernels_benchmark [num_vertices]
+ *
+ */
+
+#include "lvr_ros/kernels.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <vector>
+
+namespace
+{
+
+// Same layout as geometry_msgs::Point
+struct Point
+{
+    double x, y, z;
+};
+
+template<typename F>
+double bestOf(int runs, F f)
+{
+    double best = 1e30;
+    for (int r = 0; r < runs; r++)
+    {
+        auto start = std::chrono::steady_clock::now();
+        f();
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        best = std::min(best, elapsed.count());
+    }
+    return best;
+}
+
+void report(const char* name, double scalar, double kernel, size_t bytes)
+{
+    std::printf("%-22s scalar %8.2f ms   kernel %8.2f ms   speedup %5.2fx   %7.2f GB/s\n",
+                name, scalar * 1e3, kernel * 1e3, scalar / kernel, bytes / kernel * 1e-9);
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    const size_t n = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 10000000;
+    const int runs = 5;
+
+    std::printf("%zu vertices, kernels use %s\n", n, lvr_ros::kernels::instructionSet());
+
+    std::unique_ptr<float[]> floats(new float[n * 3]);
+    std::unique_ptr<uint32_t[]> indices(new uint32_t[n * 3]);
+    for (size_t i = 0; i < n * 3; i++)
+    {
+        floats[i] = std::sin(static_cast<float>(i)) * 100.0f;
+        indices[i] = static_cast<uint32_t>(i);
+    }
+    std::vector<Point> points(n);
+    std::unique_ptr<float[]> narrowed(new float[n * 3]);
+    std::unique_ptr<uint32_t[]> copied(new uint32_t[n * 3]);
+
+    // float -> double (MeshBuffer -> MeshGeometry)
+    double scalar = bestOf(runs, [&]
+    {
+        for (size_t i = 0; i < n; i++)
+        {
+            points[i].x = floats[i * 3];
+            points[i].y = floats[i * 3 + 1];
+            points[i].z = floats[i * 3 + 2];
+        }
+    });
+    double kernel = bestOf(runs, [&]
+    {
+        lvr_ros::kernels::floatToDouble(floats.get(), &points[0].x, n * 3);
+    });
+    report("float -> double", scalar, kernel, n * 3 * (sizeof(float) + sizeof(double)));
+
+    // double -> float (MeshGeometry -> MeshBuffer)
+    scalar = bestOf(runs, [&]
+    {
+        for (size_t i = 0; i < n; i++)
+        {
+            narrowed[i * 3] = static_cast<float>(points[i].x);
+            narrowed[i * 3 + 1] = static_cast<float>(points[i].y);
+            narrowed[i * 3 + 2] = static_cast<float>(points[i].z);
+        }
+    });
+    kernel = bestOf(runs, [&]
+    {
+        lvr_ros::kernels::doubleToFloat(&points[0].x, narrowed.get(), n * 3);
+    });
+    report("double -> float", scalar, kernel, n * 3 * (sizeof(float) + sizeof(double)));
+
+    for (size_t i = 0; i < n * 3; i++)
+    {
+        if (narrowed[i] != floats[i])
+        {
+            std::fprintf(stderr, "Round trip mismatch at %zu\n", i);
+            return 1;
+        }
+    }
+
+    // face indices
+    scalar = bestOf(runs, [&]
+    {
+        for (size_t i = 0; i < n; i++)
+        {
+            copied[i * 3] = indices[i * 3];
+            copied[i * 3 + 1] = indices[i * 3 + 1];
+            copied[i * 3 + 2] = indices[i * 3 + 2];
+        }
+    });
+    kernel = bestOf(runs, [&]
+    {
+        lvr_ros::kernels::copyIndices(indices.get(), copied.get(), n * 3);
+    });
+    report("indices", scalar, kernel, n * 3 * 2 * sizeof(uint32_t));
+
+    return 0;
+}
@@ -0,0 +1,353 @@
+/*
+ * UOS-ROS packages - Robot Operating System code by the University of Osnabrück
+ * Copyright (C) 2013 University of Osnabrück
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * regression_benchmark.cpp
+ *
+ * Runs the reconstruction of the node, from the PointCloud2 to the MeshGeometry message, on
+ * the synthetic scenes of synthetic_scenes.h and compares the wall time, the peak memory and
+ * the number of faces with a baseline. Every case runs in its own process, so its peak memory
+ * is not hidden by a larger case before it. Exits with 1 if a case regressed, e.g.
+ *
+ *   lvr_ros_regression_benchmark --baseline baseline.csv --update        (on the reference machine)
+ *   lvr_ros_regression_benchmark --baseline baseline.csv --tolerance 0.2
+ *
+ * Options:
+ *   --baseline <file>        CSV of the cases, created or replaced with --update
+ *   --config <file>          parameters in the format of config/lvr_params.yaml
+ *   --scenes <a,b,..>        default room,corridor,sphere,terrain,depth_grid
+ *   --points <n,m,..>        default 100000,1000000, the largest scenes of 100M points need several GB
+ *   --repeat <n>             best wall time of n runs, default 3
+ *   --tolerance <f>          allowed relative increase of the time and memory, default 0.15
+ *   --face-tolerance <f>     allowed relative change of the number of faces, default 0.02
+ *
+ */
+
+#include "lvr_ros/conversions.h"
+#include "lvr_ros/kernels.h"
+#include "lvr_ros/reconstruction_pipeline.h"
+#include "lvr_ros/synthetic_scenes.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace
+{
+
+struct Result
+{
+    double seconds = 0.0;
+    size_t peak_memory = 0;
+    size_t faces = 0;
+};
+
+struct Options
+{
+    std::string baseline;
+    std::string config;
+    std::vector<std::string> scenes = {"room", "corridor", "sphere", "terrain", "depth_grid"};
+    std::vector<size_t> points = {100000, 1000000};
+    int repeat = 3;
+    double tolerance = 0.15;
+    double face_tolerance = 0.02;
+    bool update = false;
+};
+
+std::vector<std::string> split(const std::string& list)
+{
+    std::vector<std::string> items;
+    std::istringstream stream(list);
+    std::string item;
+    while (std::getline(stream, item, ','))
+    {
+        if (!item.empty())
+        {
+            items.push_back(item);
+        }
+    }
+    return items;
+}
+
+std::string caseName(const std::string& scene, size_t points)
+{
+    return scene + "/" + std::to_string(points);
+}
+
+/**
+ * The path of the node from the cloud message to the geometry message, the timing starts with
+ * the point conversion and the cloud generation is not measured
+ */
+bool reconstruct(const lvr_ros::SyntheticScene& scene, const lvr_ros::ReconstructionConfig& config, Result& result)
+{
+    sensor_msgs::PointCloud2 cloud;
+    lvr_ros::generateSyntheticScene(scene, cloud);
+
+    lvr_ros::ReconstructionProgress progress;
+    lvr_ros::ReconstructionTiming timing;
+    lvr2::PointBufferPtr point_buffer(new lvr2::PointBuffer);
+    lvr2::MeshBufferPtr mesh_buffer(new lvr2::MeshBuffer);
+    lvr2::BoundingBox<lvr_ros::Vec> bounding_box;
+    {
+        lvr_ros::ReconstructionTiming::Scope timer(timing, "point conversion");
+        if (!lvr_ros::fromPointCloud2ToPointBuffer(cloud, *point_buffer, bounding_box, config.removeNonFinite))
+        {
+            return false;
+        }
+    }
+    if (!lvr_ros::reconstructMeshBuffer(point_buffer, mesh_buffer, config, progress, timing))
+    {
+        return false;
+    }
+    mesh_msgs::MeshGeometry geometry;
+    {
+        lvr_ros::ReconstructionTiming::Scope timer(timing, "message conversion");
+        if (!lvr_ros::fromMeshBufferToMeshGeometryMessage(mesh_buffer, geometry))
+        {
+            return false;
+        }
+    }
+
+    result.seconds = timing.totalSeconds();
+    result.peak_memory = lvr_ros::ReconstructionTiming::peakMemory();
+    result.faces = geometry.faces.size();
+    return true;
+}
+
+/**
+ * Runs a case in a child process, which reports its result through a pipe
+ */
+bool runCase(const lvr_ros::SyntheticScene& scene, const lvr_ros::ReconstructionConfig& config, Result& result)
+{
+    int fds[2];
+    if (pipe(fds) != 0)
+    {
+        return false;
+    }
+    const pid_t pid = fork();
+    if (pid < 0)
+    {
+        close(fds[0]);
+        close(fds[1]);
+        return false;
+    }
+    if (pid == 0)
+    {
+        close(fds[0]);
+        Result child;
+        const bool success = reconstruct(scene, config, child);
+        if (success)
+        {
+            const ssize_t written = write(fds[1], &child, sizeof(child));
+            (void) written;
+        }
+        close(fds[1]);
+        _exit(success ? 0 : 1);
+    }
+
+    close(fds[1]);
+    const bool received = read(fds[0], &result, sizeof(result)) == static_cast<ssize_t>(sizeof(result));
+    close(fds[0]);
+    int status = 0;
+    waitpid(pid, &status, 0);
+    return received && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+std::map<std::string, Result> readBaseline(const std::string& path)
+{
+    std::map<std::string, Result> baseline;
+    std::ifstream file(path);
+    std::string line;
+    while (std::getline(file, line))
+    {
+        if (line.empty() || line[0] == '#' || line.compare(0, 6, "scene,") == 0)
+        {
+            continue;
+        }
+        std::vector<std::string> columns = split(line);
+        if (columns.size() != 5)
+        {
+            continue;
+        }
+        Result result;
+        result.seconds = std::atof(columns[2].c_str());
+        result.peak_memory = std::strtoull(columns[3].c_str(), nullptr, 10) * 1024 * 1024;
+        result.faces = std::strtoull(columns[4].c_str(), nullptr, 10);
+        baseline[caseName(columns[0], std::strtoull(columns[1].c_str(), nullptr, 10))] = result;
+    }
+    return baseline;
+}
+
+double change(double value, double reference)
+{
+    return reference > 0.0 ? value / reference - 1.0 : 0.0;
+}
+
+bool parseOptions(int argc, char** argv, Options& options)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        const std::string arg = argv[i];
+        const bool has_value = i + 1 < argc;
+        if (arg == "--update") options.update = true;
+        else if (arg == "--baseline" && has_value) options.baseline = argv[++i];
+        else if (arg == "--config" && has_value) options.config = argv[++i];
+        else if (arg == "--scenes" && has_value) options.scenes = split(argv[++i]);
+        else if (arg == "--repeat" && has_value) options.repeat = std::max(1, std::atoi(argv[++i]));
+        else if (arg == "--tolerance" && has_value) options.tolerance = std::atof(argv[++i]);
+        else if (arg == "--face-tolerance" && has_value) options.face_tolerance = std::atof(argv[++i]);
+        else if (arg == "--points" && has_value)
+        {
+            options.points.clear();
+            for (const auto& points : split(argv[++i]))
+            {
+                options.points.push_back(std::strtoull(points.c_str(), nullptr, 10));
+            }
+        }
+        else return false;
+    }
+    return !(options.update && options.baseline.empty());
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    Options options;
+    if (!parseOptions(argc, argv, options))
+    {
+        std::fprintf(stderr, "Usage: lvr_ros_regression_benchmark [--baseline file [--update]] [--config file] "
+            "[--scenes a,b] [--points n,m] [--repeat n] [--tolerance f] [--face-tolerance f]\n");
+        return 2;
+    }
+
+    // keep the progress output of the reconstruction out of the table
+    if (ros::console::set_logger_level(ROSCONSOLE_DEFAULT_NAME, ros::console::levels::Warn))
+    {
+        ros::console::notifyLoggerLevelsChanged();
+    }
+
+    lvr_ros::ReconstructionConfig config = lvr_ros::ReconstructionConfig::__getDefault__();
+    if (!options.config.empty() && !lvr_ros::readConfigFile(options.config, config))
+    {
+        return 1;
+    }
+    const std::map<std::string, Result> baseline =
+        options.baseline.empty() ? std::map<std::string, Result>() : readBaseline(options.baseline);
+
+    std::printf("kernels use %s, tolerance %.0f %%, faces %.0f %%\n", lvr_ros::kernels::instructionSet(),
+        options.tolerance * 100, options.face_tolerance * 100);
+    std::printf("%-24s %10s %8s %10s %8s %10s %8s  %s\n",
+        "case", "time [s]", "change", "peak [MB]", "change", "faces", "change", "status");
+
+    std::ostringstream csv;
+    csv << "# " << lvr_ros::kernels::instructionSet() << ", " << options.config << "\n";
+    csv << "scene,points,seconds,peak_memory_mb,faces\n";
+    int regressions = 0;
+    int failures = 0;
+    for (const auto& scene_name : options.scenes)
+    {
+        lvr_ros::SyntheticScene scene;
+        if (!lvr_ros::parseSyntheticSceneType(scene_name, scene.type))
+        {
+            std::fprintf(stderr, "Unknown scene %s\n", scene_name.c_str());
+            return 2;
+        }
+        for (size_t points : options.points)
+        {
+            scene.points = points;
+            const std::string name = caseName(scene_name, points);
+
+            Result result;
+            bool success = true;
+            for (int run = 0; run < options.repeat && success; run++)
+            {
+                Result current;
+                success = runCase(scene, config, current);
+                result.seconds = run == 0 ? current.seconds : std::min(result.seconds, current.seconds);
+                result.peak_memory = std::max(result.peak_memory, current.peak_memory);
+                result.faces = current.faces;
+            }
+            if (!success)
+            {
+                std::printf("%-24s reconstruction failed\n", name.c_str());
+                failures++;
+                continue;
+            }
+            csv << scene_name << "," << points << "," << result.seconds << ","
+                << result.peak_memory / (1024 * 1024) << "," << result.faces << "\n";
+
+            const double peak = static_cast<double>(result.peak_memory) / (1024 * 1024);
+            auto reference = baseline.find(name);
+            if (reference == baseline.end())
+            {
+                std::printf("%-24s %10.3f %8s %10.0f %8s %10zu %8s  %s\n",
+                    name.c_str(), result.seconds, "", peak, "", result.faces, "", "new");
+                continue;
+            }
+
+            const Result& base = reference->second;
+            const double time_change = change(result.seconds, base.seconds);
+            const double memory_change = change(static_cast<double>(result.peak_memory), static_cast<double>(base.peak_memory));
+            const double face_change = change(static_cast<double>(result.faces), static_cast<double>(base.faces));
+            std::string status;
+            if (time_change > options.tolerance) status += " time";
+            if (memory_change > options.tolerance) status += " memory";
+            if (std::abs(face_change) > options.face_tolerance) status += " faces";
+            if (!status.empty())
+            {
+                regressions++;
+                status = "REGRESSED:" + status;
+            }
+            else
+            {
+                status = time_change < -options.tolerance ? "improved" : "ok";
+            }
+            std::printf("%-24s %10.3f %+7.1f%% %10.0f %+7.1f%% %10zu %+7.1f%%  %s\n",
+                name.c_str(), result.seconds, time_change * 100, peak, memory_change * 100,
+                result.faces, face_change * 100, status.c_str());
+        }
+    }
+
+    if (options.update)
+    {
+        std::ofstream file(options.baseline);
+        file << csv.str();
+        if (!file)
+        {
+            std::fprintf(stderr, "Could not write the baseline %s\n", options.baseline.c_str());
+            return 1;
+        }
+        std::printf("baseline written to %s\n", options.baseline.c_str());
+        return failures > 0 ? 1 : 0;
+    }
+    if (regressions + failures > 0)
+    {
+        std::printf("%d case(s) regressed, %d failed\n", regressions, failures);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,87 @@
+/*
+ * UOS-ROS packages - Robot Operating System code by the University of Osnabrück
+ * Copyright (C) 2013 University of Osnabrück
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * synthetic_scene.cpp
+ *
+ * Writes a synthetic scene of synthetic_scenes.h to a point cloud file, e.g. as input of
+ * lvr_ros_offline_reconstruction. The NaN returns of the depth grid are dropped.
+ *
+ *   lvr_ros_synthetic_scene [--points n | --density d] [--size m] [--noise m] [--seed s] <scene> <output>
+ *
+ * with the scenes room, corridor, sphere, terrain and depth_grid, the density in points per
+ * square meter and the size and noise in meters.
+ *
+ */
+
+#include "lvr_ros/conversions.h"
+#include "lvr_ros/synthetic_scenes.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+int main(int argc, char** argv)
+{
+    lvr_ros::SyntheticScene scene;
+    double density = 0.0;
+    std::vector<std::string> positional;
+    for (int i = 1; i < argc; i++)
+    {
+        const std::string arg = argv[i];
+        const bool has_value = i + 1 < argc;
+        if (arg == "--points" && has_value) scene.points = std::strtoull(argv[++i], nullptr, 10);
+        else if (arg == "--density" && has_value) density = std::atof(argv[++i]);
+        else if (arg == "--size" && has_value) scene.size = std::atof(argv[++i]);
+        else if (arg == "--noise" && has_value) scene.noise = std::atof(argv[++i]);
+        else if (arg == "--seed" && has_value) scene.seed = std::strtoull(argv[++i], nullptr, 10);
+        else positional.push_back(arg);
+    }
+
+    if (positional.size() != 2 || !lvr_ros::parseSyntheticSceneType(positional[0], scene.type) || scene.size <= 0.0)
+    {
+        std::fprintf(stderr, "Usage: lvr_ros_synthetic_scene [--points n | --density d] [--size m] [--noise m] "
+            "[--seed s] <room|corridor|sphere|terrain|depth_grid> <output>\n");
+        return 2;
+    }
+    if (density > 0.0)
+    {
+        const double area = lvr_ros::syntheticSceneArea(scene);
+        if (area <= 0.0)
+        {
+            std::fprintf(stderr, "The density of the %s is not defined, use --points\n", positional[0].c_str());
+            return 2;
+        }
+        scene.points = static_cast<size_t>(density * area);
+    }
+
+    sensor_msgs::PointCloud2 cloud;
+    lvr_ros::generateSyntheticScene(scene, cloud);
+
+    lvr2::PointBufferPtr buffer(new lvr2::PointBuffer);
+    lvr2::BoundingBox<lvr_ros::Vec> bounding_box;
+    if (!lvr_ros::fromPointCloud2ToPointBuffer(cloud, *buffer, bounding_box, true)
+        || !lvr_ros::writePointBuffer(buffer, positional[1]))
+    {
+        std::fprintf(stderr, "Could not write %s\n", positional[1].c_str());
+        return 1;
+    }
+    std::printf("%s: %zu points, %.1f x %.1f x %.1f m\n", positional[0].c_str(), buffer->numPoints(),
+        bounding_box.getXSize(), bounding_box.getYSize(), bounding_box.getZSize());
+    return 0;
+}
@@ -45,14 +45,58 @@
 #ifndef LVR_ROS__COLORS_H_
 #define LVR_ROS__COLORS_H_
 
+#include <cstddef>
 #include <std_msgs/ColorRGBA.h>
 
 namespace lvr_ros
 {
+  enum class ColorMap
+  {
+    RAINBOW,
+    JET,
+    HOT,
+    GRAY,
+    VIRIDIS
+  };
+
+  // number of colors in the colormap lookup tables
+  const size_t COLOR_MAP_LUT_SIZE = 1024;
+
   std_msgs::ColorRGBA getRainbowColor(const float value);
 
   void getRainbowColor(float value, float& r, float& g, float& b);
 
+  /**
+   * @brief Evaluates a colormap at value in [0, 1], values outside are clamped
+   */
+  void getColorMapColor(ColorMap map, float value, float& r, float& g, float& b);
+
+  /**
+   * @brief Returns the lookup table of a colormap: COLOR_MAP_LUT_SIZE interleaved RGBA
+   *        colors sampled over [0, 1], followed by a transparent black for non-finite values.
+   *        The tables are computed once on first use.
+   */
+  const float* getColorMapLUT(ColorMap map);
+
+  /**
+   * @brief Maps n values to colors of a colormap, normalized to [min, max]. Non-finite values
+   *        are mapped to transparent black. Large arrays are processed by all OpenMP threads.
+   *
+   * @param values  the values
+   * @param n       number of values
+   * @param map     the colormap
+   * @param min     value mapped to the start of the colormap
+   * @param max     value mapped to the end of the colormap
+   * @param colors  the output, space for n colors
+   */
+  void getColorMapColors(
+      const float* values,
+      size_t n,
+      ColorMap map,
+      float min,
+      float max,
+      std_msgs::ColorRGBA* colors);
+
 } /* namespace lvr_ros */
 
 #endif /* colors.h */
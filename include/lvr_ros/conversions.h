@@ -36,6 +36,7 @@
 #include <ros/console.h>
 
 #include <lvr2/geometry/BaseVector.hpp>
+#include <lvr2/geometry/BoundingBox.hpp>
 #include <lvr2/io/PointBuffer.hpp>
 #include <lvr2/io/MeshBuffer.hpp>
 #include <lvr2/geometry/BaseMesh.hpp>
@@ -69,6 +70,9 @@
 
 #include <sensor_msgs/point_cloud2_iterator.h>
 
+#include "lvr_ros/colors.h"
+#include "lvr_ros/kernels.h"
+
 
 namespace lvr_ros {
 
@@ -88,48 +92,75 @@ namespace lvr_ros {
     typedef boost::shared_ptr <MaterialGroup> MaterialGroupPtr;
 
 
+    /**
+     * Converts a HalfEdgeMesh to a MeshGeometry message. The vertex and face handles are compacted
+     * by a prefix scan over the handle indices, so vertices and faces keep the order of the mesh
+     * iterators, and the pre-sized message arrays are filled in parallel. Normals are only written
+     * if the normal map is not empty, vertices without normal get a zero normal.
+     */
     template<typename CoordType>
     inline const mesh_msgs::MeshGeometry toMeshGeometry(
             const lvr2::HalfEdgeMesh <lvr2::BaseVector<CoordType>> &hem,
             const lvr2::VertexMap <lvr2::Normal<CoordType>> &normals = lvr2::DenseVertexMap < lvr2::Normal <
                                                                        CoordType >> ()) {
         mesh_msgs::MeshGeometry mesh_msg;
-        mesh_msg.vertices.reserve(hem.numVertices());
-        mesh_msg.faces.reserve(hem.numFaces());
-
-        mesh_msg.vertex_normals.reserve(normals.numValues());
 
-        lvr2::DenseVertexMap <size_t> new_indices;
-        new_indices.reserve(hem.numVertices());
+        // new index of every vertex handle, deleted handles are skipped
+        const size_t num_vertex_handles = hem.nextVertexIndex();
+        std::vector<uint32_t> new_indices(num_vertex_handles);
+        #pragma omp parallel for schedule(static)
+        for (size_t i = 0; i < num_vertex_handles; i++) {
+            new_indices[i] = hem.containsVertex(lvr2::VertexHandle(i)) ? 1 : 0;
+        }
+        const size_t num_vertices = kernels::exclusiveScan(new_indices.data(), num_vertex_handles);
 
-        size_t k = 0;
-        for (auto vH: hem.vertices()) {
-            new_indices.insert(vH, k++);
+        const size_t num_face_handles = hem.nextFaceIndex();
+        std::vector<uint32_t> face_indices(num_face_handles);
+        #pragma omp parallel for schedule(static)
+        for (size_t i = 0; i < num_face_handles; i++) {
+            face_indices[i] = hem.containsFace(lvr2::FaceHandle(i)) ? 1 : 0;
+        }
+        const size_t num_faces = kernels::exclusiveScan(face_indices.data(), num_face_handles);
+
+        const bool has_normals = normals.numValues() > 0;
+        mesh_msg.vertices.resize(num_vertices);
+        mesh_msg.vertex_normals.resize(has_normals ? num_vertices : 0);
+        mesh_msg.faces.resize(num_faces);
+
+        #pragma omp parallel for schedule(static)
+        for (size_t i = 0; i < num_vertex_handles; i++) {
+            const lvr2::VertexHandle vH(i);
+            if (!hem.containsVertex(vH)) {
+                continue;
+            }
             const auto &pi = hem.getVertexPosition(vH);
-            geometry_msgs::Point p;
+            geometry_msgs::Point &p = mesh_msg.vertices[new_indices[i]];
             p.x = pi.x;
             p.y = pi.y;
             p.z = pi.z;
-            mesh_msg.vertices.push_back(p);
-        }
-
-        for (auto fH: hem.faces()) {
-            mesh_msgs::MeshTriangleIndices_ <allocator<void>> indices;
-            auto vHs = hem.getVerticesOfFace(fH);
-            indices.vertex_indices[0] = new_indices[vHs[0]];
-            indices.vertex_indices[1] = new_indices[vHs[1]];
-            indices.vertex_indices[2] = new_indices[vHs[2]];
-            mesh_msg.faces.push_back(indices);
 
+            if (has_normals) {
+                const auto n = normals.get(vH);
+                if (n) {
+                    geometry_msgs::Point &v = mesh_msg.vertex_normals[new_indices[i]];
+                    v.x = n->x;
+                    v.y = n->y;
+                    v.z = n->z;
+                }
+            }
         }
 
-        for (auto vH: hem.vertices()) {
-            const auto &n = normals[vH];
-            geometry_msgs::Point v;
-            v.x = n.x;
-            v.y = n.y;
-            v.z = n.z;
-            mesh_msg.vertex_normals.push_back(v);
+        #pragma omp parallel for schedule(static)
+        for (size_t i = 0; i < num_face_handles; i++) {
+            const lvr2::FaceHandle fH(i);
+            if (!hem.containsFace(fH)) {
+                continue;
+            }
+            const auto vHs = hem.getVerticesOfFace(fH);
+            auto &indices = mesh_msg.faces[face_indices[i]].vertex_indices;
+            indices[0] = new_indices[vHs[0].idx()];
+            indices[1] = new_indices[vHs[1].idx()];
+            indices[2] = new_indices[vHs[2].idx()];
         }
 
         return mesh_msg;
@@ -226,6 +257,47 @@ namespace lvr_ros {
     std::string mesh_uuid
     );
 
+/**
+ * @brief Convert the attributes of a lvr2::MeshBuffer, i.e. materials, texture coordinates,
+ *        vertex colors and textures, to messages. The geometry is not touched, it can be
+ *        streamed from the buffer with lvr_ros::MeshBufferGeometryStamped.
+ */
+    bool fromMeshBufferToMeshAttributeMessages(
+            const lvr2::MeshBufferPtr &buffer,
+            mesh_msgs::MeshMaterials &mesh_materials,
+            mesh_msgs::MeshVertexColors &mesh_vertex_colors,
+            boost::optional<std::vector < mesh_msgs::MeshTexture> &> texture_cache,
+            std::string mesh_uuid
+    );
+
+/**
+ * @brief Convert the materials and texture coordinates of a lvr2::MeshBuffer to a message
+ */
+    bool fromMeshBufferToMeshMaterialsMessage(
+            const lvr2::MeshBufferPtr &buffer,
+            mesh_msgs::MeshMaterials &mesh_materials
+    );
+
+/**
+ * @brief Convert the vertex colors of a lvr2::MeshBuffer to a message, it stays empty if the
+ *        buffer has no vertex colors
+ */
+    bool fromMeshBufferToMeshVertexColorsMessage(
+            const lvr2::MeshBufferPtr &buffer,
+            mesh_msgs::MeshVertexColors &mesh_vertex_colors
+    );
+
+/**
+ * @brief Convert a single texture of a lvr2::MeshBuffer to a message
+ * @return false if the buffer has no texture with the given index
+ */
+    bool fromMeshBufferToMeshTextureMessage(
+            const lvr2::MeshBufferPtr &buffer,
+            size_t texture_index,
+            const std::string &mesh_uuid,
+            mesh_msgs::MeshTexture &texture
+    );
+
 /**
  * @brief Convert lvr::MeshBuffer to mesh_msgs::TriangleMesh
  * @param buffer to be read
@@ -283,11 +355,30 @@ namespace lvr_ros {
             lvr2::MeshBuffer &buffer
     );
 
-/* TODO
-void removeDuplicates(lvr2::MeshBuffer& buffer);
+/**
+ * @brief Welds the vertices of a mesh which are closer than epsilon, e.g. the duplicated
+ *        border vertices of tiled reconstructions. The face indices are remapped and faces
+ *        which collapse are removed, together with their materials, normals and colors.
+ *        Welded vertices keep the position and texture coordinate of their first vertex,
+ *        their normals and colors are averaged. Other vertex channels are not updated.
+ *
+ * @param buffer the mesh to weld
+ * @param epsilon the welding distance, if not positive only equal positions are welded
+ *
+ * @return the number of removed vertices
+ */
+    size_t weldVertices(lvr2::MeshBuffer &buffer, float epsilon = 0.0f);
 
-void removeDuplicates(mesh_msgs::TriangleMesh& mesh);
-*/
+/**
+ * @brief Welds the vertices of a mesh_msgs::MeshGeometry which are closer than epsilon,
+ *        see weldVertices(lvr2::MeshBuffer&, float).
+ *
+ * @param mesh_geometry the mesh to weld
+ * @param epsilon the welding distance, if not positive only equal positions are welded
+ *
+ * @return the number of removed vertices
+ */
+    size_t weldVertices(mesh_msgs::MeshGeometry &mesh_geometry, float epsilon = 0.0f);
 
 /**
  * @brief Creates a LVR-MeshBufferPointer from a file
@@ -298,6 +389,22 @@ void removeDuplicates(mesh_msgs::TriangleMesh& mesh);
  */
     bool readMeshBuffer(lvr2::MeshBufferPtr &buffer, string path);
 
+/**
+ * @brief Reads the points of a file, e.g. a PLY or PCD cloud, in every format of lvr2::ModelFactory
+ *
+ * @param buffer  the points with their normals, colors and further channels
+ * @param path    Path to a point cloud file
+ *
+ * @return false if the file can not be read or contains no points
+ */
+    bool readPointBuffer(lvr2::PointBufferPtr &buffer, string path);
+
+/**
+ * @brief Writes the points of a buffer to a file, the format is chosen by lvr2::ModelFactory
+ *        from the extension of the path
+ */
+    bool writePointBuffer(lvr2::PointBufferPtr &buffer, string path);
+
 /**
  * @brief Writes a LVR-MeshBufferPointer to a file
  *
@@ -354,14 +461,44 @@ void removeDuplicates(mesh_msgs::TriangleMesh& mesh);
    );
    */
 /**
- * @brief Writes intensity values as rainbow colors for the vertex colors
+ * @brief Writes intensity values as colors of a colormap for the vertex colors
  *
  * @param intensity Intensity values as std::vector<float>
- * @param mesh      ROS-TriangleMeshGeometryMessage
+ * @param mesh      ROS-MeshVertexColors message
+ * @param color_map The colormap
  * @param min       The minimal value
  * @param max       The maximal value
  */
+    void intensityToVertexColors(
+            const std::vector<float> &intensity,
+            mesh_msgs::MeshVertexColors &mesh,
+            ColorMap color_map,
+            float min,
+            float max
+    );
 
+/**
+ * @brief Writes intensity values as colors of a colormap for the vertex colors,
+ *        normalized to the range of the finite values
+ *
+ * @param intensity Intensity values as std::vector<float>
+ * @param mesh      ROS-MeshVertexColors message
+ * @param color_map The colormap
+ */
+    void intensityToVertexColors(
+            const std::vector<float> &intensity,
+            mesh_msgs::MeshVertexColors &mesh,
+            ColorMap color_map
+    );
+
+/**
+ * @brief Writes intensity values as rainbow colors for the vertex colors
+ *
+ * @param intensity Intensity values as std::vector<float>
+ * @param mesh      ROS-MeshVertexColors message
+ * @param min       The minimal value
+ * @param max       The maximal value
+ */
     void intensityToVertexRainbowColors(
             const std::vector<float> &intensity,
             mesh_msgs::MeshVertexColors &mesh,
@@ -369,62 +506,100 @@ void removeDuplicates(mesh_msgs::TriangleMesh& mesh);
             float max
     );
 
+/**
+ * @brief Writes intensity values as rainbow colors for the vertex colors
+ *
+ * @param intensity Intensity values
+ * @param mesh      ROS-MeshVertexColors message
+ */
+    void intensityToVertexRainbowColors(const std::vector<float> &intensity, mesh_msgs::MeshVertexColors &mesh);
+
 /**
  * @brief Writes intensity values as rainbow colors for the vertex colors
  *
  * @param intensity Intensity values as DenseVertexMap<float>
- * @param mesh      ROS-TriangleMeshGeometryMessage
+ * @param mesh      ROS-MeshVertexColors message
  * @param min       The minimal value
  * @param max       The maximal value
  */
-    /*
-   void intensityToVertexRainbowColors(
-       const lvr2::DenseVertexMap<float>& intensity,
-       mesh_msgs::MeshGeometry& mesh,
-       float min,
-       float max
-   );
-     */
-/*
+    void intensityToVertexRainbowColors(
+            const lvr2::DenseVertexMap<float> &intensity,
+            mesh_msgs::MeshVertexColors &mesh,
+            float min,
+            float max
+    );
+
 /**
  * @brief Writes intensity values as rainbow colors for the vertex colors
  *
- * @param intensity Intensity values
- * @param mesh      ROS-TriangleMeshGeometryMessage
+ * @param intensity Intensity values as DenseVertexMap<float>
+ * @param mesh      ROS-MeshVertexColors message
  */
-
-    void intensityToVertexRainbowColors(const std::vector<float> &intensity, mesh_msgs::MeshVertexColors &mesh);
+    void intensityToVertexRainbowColors(
+            const lvr2::DenseVertexMap<float> &intensity,
+            mesh_msgs::MeshVertexColors &mesh
+    );
 
     /**
      * converts from pointcloud2 to lvr2::PointBuffer
-     * nan Points are covert as nan Point
+     * nan Points are covert as nan Point, see the overload below to drop them
      * @param cloud
      * @param buffer
      * @return
      */
     bool fromPointCloud2ToPointBuffer(const sensor_msgs::PointCloud2 &cloud, PointBuffer &buffer);
 
+    /**
+     * converts from pointcloud2 to lvr2::PointBuffer and computes the bounding box of the
+     * finite points in the same pass. Points, normals, colors ("rgb") and intensities
+     * ("intensities" or "intensity") are gathered in a single pass over the cloud.
+     * Optionally, points with non-finite coordinates (the invalid returns of organized clouds)
+     * are dropped from all channels, which takes one additional pass over the coordinates.
+     * @param cloud
+     * @param buffer
+     * @param bounding_box the bounding box of the finite points
+     * @param drop_non_finite drop points with a NaN or infinite x, y or z
+     * @param num_dropped if not null, set to the number of dropped points
+     * @return false if the cloud has no FLOAT32 x, y and z fields
+     */
+    bool fromPointCloud2ToPointBuffer(
+            const sensor_msgs::PointCloud2 &cloud,
+            PointBuffer &buffer,
+            lvr2::BoundingBox<Vec> &bounding_box,
+            bool drop_non_finite = false,
+            size_t *num_dropped = nullptr);
+
 /**
  * @brief converts lvr2::Pointbuffer to pointcloud2.
- *        Every channel is added as a pointfield.
+ *        Every channel is added as a pointfield of the matching datatype,
+ *        channels of all lvr2 channel types (char to double) are supported.
+ *        The fields are packed tightly behind x, y and z, ordered by decreasing value size.
  *
  * @param buffer the input lvr2::Pointbuffer
  * @param frame the frame of the converted pointcloud2
  * @param cloud the converted pointcloud2
+ * @param align_fields align every field to the size of its values, and the point step
+ *        to the largest value size
  */
     void
-    PointBufferToPointCloud2(const lvr2::PointBufferPtr &buffer, std::string frame, sensor_msgs::PointCloud2Ptr &cloud);
+    PointBufferToPointCloud2(
+            const lvr2::PointBufferPtr &buffer,
+            std::string frame,
+            sensor_msgs::PointCloud2Ptr &cloud,
+            bool align_fields = false);
 
 /**
  * @brief converts pointcloud2 to a newly created Pointerbuffer.
- *        Every pointfield is written into its own channel.
+ *        Every pointfield is written into its own channel of the matching type
+ *        (INT8 to char, ..., FLOAT64 to double), the fields x, y and z into the points,
+ *        converted to float if they have another numeric type.
  *
  * @param cloud the input cloud
  * @param buffer the converted lvr2::Pointbuffer
  *
- * @return 
+ * @return false if the cloud has no numeric fields x, y and z or less data than its dimensions
  */
-    void PointCloud2ToPointBuffer(const sensor_msgs::PointCloud2Ptr &cloud, lvr2::PointBufferPtr &buffer);
+    bool PointCloud2ToPointBuffer(const sensor_msgs::PointCloud2Ptr &cloud, lvr2::PointBufferPtr &buffer);
 
 
 /**
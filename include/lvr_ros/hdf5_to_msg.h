@@ -0,0 +1,127 @@
+/*
+ * UOS-ROS packages - Robot Operating System code by the University of Osnabrück
+ * Copyright (C) 2013 University of Osnabrück
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * hdf5_to_msg.h
+ *
+ * Streams the point clouds and meshes of a LVR2 HDF5 map to ROS messages.
+ *
+ */
+
+#ifndef LVR_ROS_HDF5_TO_MSG_H_
+#define LVR_ROS_HDF5_TO_MSG_H_
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <actionlib/client/simple_action_client.h>
+#include <hdf5.h>
+#include <ros/ros.h>
+#include <sensor_msgs/PointCloud2.h>
+
+#include "lvr_ros/ReconstructAction.h"
+
+namespace lvr_ros
+{
+
+/**
+ * @brief Publishes the point clouds and meshes of a HDF5 file, e.g. a LVR2 map or a mesh store.
+ *
+ * Every group with a "points" dataset is a point cloud, every group with a "vertices" and a
+ * "faces" or "face_indices" dataset is a mesh. The datasets of a group with one row per point
+ * are published as fields of the cloud.
+ *
+ * Clouds are read in chunks of chunkSize points with hyperslab reads, so the memory stays bounded
+ * by the chunk size no matter how large the map is. With acknowledge, every chunk is sent as a goal
+ * to the reconstruction action and the next chunk is only read once the previous one has been
+ * reconstructed, its mesh is published on "~mesh_geometry". Otherwise every chunk is published as
+ * its own PointCloud2 on "pointcloud". The reconstruction node only keeps the latest cloud of that
+ * topic waiting, so the rate has to be low enough for it to finish a chunk before the next one
+ * arrives, or chunks are dropped. Either way at most rate chunks per second are sent.
+ * Meshes can not be split, their datasets are read chunk-wise straight into the MeshBuffer and
+ * published as a whole on "~mesh_geometry".
+ *
+ * Parameters (private):
+ *  - inputFile: the HDF5 file
+ *  - rate: messages per second
+ *  - chunkSize: points per published cloud
+ *  - frameId: frame of the published messages
+ *  - loop: start again after the last message
+ *  - waitForSubscribers: wait for the first subscriber or the action server before publishing
+ *  - acknowledge: send the chunks to the reconstruction action and wait for every result
+ *  - reconstructionAction: name of the action of the reconstruction node
+ */
+class Hdf5ToMsg
+{
+public:
+    Hdf5ToMsg();
+
+    ~Hdf5ToMsg();
+
+    Hdf5ToMsg(const Hdf5ToMsg&) = delete;
+    Hdf5ToMsg& operator=(const Hdf5ToMsg&) = delete;
+
+    /**
+     * @brief Publishes the contents of the file until all is published or the node is shut down
+     * @return false if the file can not be read
+     */
+    bool run();
+
+private:
+    bool findSources();
+
+    /**
+     * @brief Publishes the points of a group chunk by chunk
+     */
+    bool publishCloud(const std::string& group_name);
+
+    bool publishMesh(const std::string& group_name);
+
+    /**
+     * @brief Publishes a chunk, or sends it to the reconstruction and waits for its result
+     * @return false if the node has been shut down
+     */
+    bool sendCloud(const sensor_msgs::PointCloud2Ptr& cloud);
+
+    typedef actionlib::SimpleActionClient<lvr_ros::ReconstructAction> ReconstructionClient;
+
+    ros::NodeHandle node_handle;
+    ros::Publisher cloud_publisher;
+    ros::Publisher mesh_publisher;
+
+    std::string input_file;
+    double rate;
+    size_t chunk_size;
+    std::string frame_id;
+    bool loop;
+    bool wait_for_subscribers;
+    bool acknowledge;
+
+    // the reconstruction action, only used with acknowledge
+    std::unique_ptr<ReconstructionClient> reconstruction_client;
+
+    hid_t file;
+
+    // groups of the clouds and meshes, in the order of their names
+    std::vector<std::string> cloud_groups;
+    std::vector<std::string> mesh_groups;
+};
+
+} // namespace lvr_ros
+
+#endif /* LVR_ROS_HDF5_TO_MSG_H_ */
@@ -0,0 +1,141 @@
+/*
+ * UOS-ROS packages - Robot Operating System code by the University of Osnabrück
+ * Copyright (C) 2013 University of Osnabrück
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * hdf5_utils.h
+ *
+ * Small helpers around the HDF5 C API shared by the mesh store and the HDF5 player.
+ *
+ */
+
+#ifndef LVR_ROS_HDF5_UTILS_H_
+#define LVR_ROS_HDF5_UTILS_H_
+
+#include <string>
+#include <vector>
+
+#include <hdf5.h>
+
+namespace lvr_ros {
+namespace hdf5 {
+
+/**
+ * @brief The native HDF5 memory type of T
+ */
+template<typename T> inline hid_t nativeType();
+template<> inline hid_t nativeType<char>() { return H5T_NATIVE_SCHAR; }
+template<> inline hid_t nativeType<unsigned char>() { return H5T_NATIVE_UCHAR; }
+template<> inline hid_t nativeType<short>() { return H5T_NATIVE_SHORT; }
+template<> inline hid_t nativeType<unsigned short>() { return H5T_NATIVE_USHORT; }
+template<> inline hid_t nativeType<int>() { return H5T_NATIVE_INT; }
+template<> inline hid_t nativeType<unsigned int>() { return H5T_NATIVE_UINT; }
+template<> inline hid_t nativeType<float>() { return H5T_NATIVE_FLOAT; }
+template<> inline hid_t nativeType<double>() { return H5T_NATIVE_DOUBLE; }
+
+/**
+ * @brief Calls visitor(T()) with the native C++ type T of the values of a dataset
+ * @return false if the values are not of a native integer or floating point type
+ */
+template<typename Visitor>
+bool visitNativeType(hid_t dataset, Visitor&& visitor)
+{
+    hid_t type = H5Dget_type(dataset);
+    hid_t native = H5Tget_native_type(type, H5T_DIR_ASCEND);
+    bool found = true;
+    if (H5Tequal(native, H5T_NATIVE_FLOAT) > 0) visitor(float());
+    else if (H5Tequal(native, H5T_NATIVE_DOUBLE) > 0) visitor(double());
+    else if (H5Tequal(native, H5T_NATIVE_UCHAR) > 0) visitor((unsigned char) 0);
+    else if (H5Tequal(native, H5T_NATIVE_SCHAR) > 0) visitor(char());
+    else if (H5Tequal(native, H5T_NATIVE_SHORT) > 0) visitor(short());
+    else if (H5Tequal(native, H5T_NATIVE_USHORT) > 0) visitor((unsigned short) 0);
+    else if (H5Tequal(native, H5T_NATIVE_INT) > 0) visitor(int());
+    else if (H5Tequal(native, H5T_NATIVE_UINT) > 0) visitor((unsigned int) 0);
+    else found = false;
+    H5Tclose(native);
+    H5Tclose(type);
+    return found;
+}
+
+/**
+ * @brief Whether a link exists, false instead of an error if an intermediate group is missing
+ */
+inline bool linkExists(hid_t location, const std::string& name)
+{
+    size_t end = 0;
+    while ((end = name.find('/', end + 1)) != std::string::npos)
+    {
+        if (H5Lexists(location, name.substr(0, end).c_str(), H5P_DEFAULT) <= 0)
+        {
+            return false;
+        }
+    }
+    return H5Lexists(location, name.c_str(), H5P_DEFAULT) > 0;
+}
+
+/**
+ * @brief The dimensions of a dataset, empty if it can not be read
+ */
+inline std::vector<hsize_t> datasetDims(hid_t dataset)
+{
+    std::vector<hsize_t> dims;
+    hid_t space = H5Dget_space(dataset);
+    if (space < 0)
+    {
+        return dims;
+    }
+    const int rank = H5Sget_simple_extent_ndims(space);
+    if (rank > 0)
+    {
+        dims.resize(rank);
+        H5Sget_simple_extent_dims(space, dims.data(), nullptr);
+    }
+    H5Sclose(space);
+    return dims;
+}
+
+/**
+ * @brief Reads the rows [first, first + count) of a dataset of rank 1 or 2 with a hyperslab
+ * @param width number of values per row, 1 for a dataset of rank 1
+ * @param dst count * width values
+ */
+template<typename T>
+bool readRows(hid_t dataset, hsize_t first, hsize_t count, hsize_t width, T* dst)
+{
+    if (count == 0)
+    {
+        return true;
+    }
+    hid_t file_space = H5Dget_space(dataset);
+    const int rank = H5Sget_simple_extent_ndims(file_space);
+    const hsize_t start[2] = {first, 0};
+    const hsize_t size[2] = {count, width};
+    herr_t status = H5Sselect_hyperslab(file_space, H5S_SELECT_SET, start, nullptr, size, nullptr);
+
+    hid_t memory_space = H5Screate_simple(rank, size, nullptr);
+    if (status >= 0)
+    {
+        status = H5Dread(dataset, nativeType<T>(), memory_space, file_space, H5P_DEFAULT, dst);
+    }
+    H5Sclose(memory_space);
+    H5Sclose(file_space);
+    return status >= 0;
+}
+
+} // namespace hdf5
+} // namespace lvr_ros
+
+#endif /* LVR_ROS_HDF5_UTILS_H_ */
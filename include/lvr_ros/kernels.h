@@ -0,0 +1,279 @@
+/*
+ * UOS-ROS packages - Robot Operating System code by the University of Osnabrück
+ * Copyright (C) 2013 University of Osnabrück
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * kernels.h
+ *
+ * Bulk conversion kernels used by the message conversions. The kernels work on plain
+ * arrays, pick the widest instruction set supported by the CPU at runtime (AVX, SSE2 or
+ * scalar) and split large arrays across the OpenMP threads.
+ *
+ */
+
+#ifndef LVR_ROS_KERNELS_H_
+#define LVR_ROS_KERNELS_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace lvr_ros {
+namespace kernels {
+
+/**
+ * @brief Converts n floats to doubles
+ * @param src the float array
+ * @param dst the output, does not need to be aligned for doubles (e.g. a ROS wire buffer)
+ * @param n number of values
+ */
+void floatToDouble(const float* src, void* dst, size_t n);
+
+/**
+ * @brief Converts n doubles to floats
+ * @param src the double array, does not need to be aligned for doubles
+ * @param dst the output
+ * @param n number of values
+ */
+void doubleToFloat(const void* src, float* dst, size_t n);
+
+/**
+ * @brief Copies n indices, e.g. interleaved triangle indices
+ */
+void copyIndices(const uint32_t* src, uint32_t* dst, size_t n);
+
+/**
+ * @brief Converts n 8 bit colors to interleaved RGBA floats in [0, 1]
+ * @param src the colors, channels bytes per color of which the first three are used
+ * @param channels number of bytes per color in src
+ * @param dst the output, four floats per color
+ * @param n number of colors
+ * @param alpha the alpha value written for every color
+ */
+void rgbToRGBAFloat(const uint8_t* src, size_t channels, float* dst, size_t n, float alpha = 1.0f);
+
+/**
+ * @brief Copies n elements of bytes each between strided arrays, e.g. one field of all points of
+ *        an interleaved point cloud from or into a dense channel array.
+ *
+ * The common element sizes of the PointField datatypes and counts are copied by loops
+ * specialized for their size, contiguous arrays by a plain memcpy.
+ *
+ * @param src the first source element
+ * @param src_step bytes between consecutive source elements
+ * @param dst the first destination element
+ * @param dst_step bytes between consecutive destination elements
+ * @param bytes size of one element
+ * @param n number of elements
+ */
+void copyStrided(const uint8_t* src, size_t src_step, uint8_t* dst, size_t dst_step, size_t bytes, size_t n);
+
+/**
+ * @brief A dense array written as one field of an interleaved point array
+ */
+struct InterleaveField
+{
+    const uint8_t* src = nullptr;  // bytes per point
+    size_t bytes = 0;              // size of the field
+    size_t offset = 0;             // offset of the field within a point
+};
+
+/**
+ * @brief Interleaves dense per point arrays into a point array, e.g. the data of a PointCloud2.
+ *
+ * The output is filled block by block, all fields of a block are written while the block is
+ * in the cache, instead of sweeping the whole output once per field. Bytes not covered by any
+ * field are left untouched.
+ *
+ * @param fields the fields to write
+ * @param num_fields number of fields
+ * @param dst the point array
+ * @param point_step bytes per point
+ * @param n number of points
+ */
+void interleave(const InterleaveField* fields, size_t num_fields, uint8_t* dst, size_t point_step, size_t n);
+
+/**
+ * @brief In place exclusive prefix sum, in parallel for large arrays, e.g. to turn flags of
+ *        kept elements into their indices after compaction
+ * @return the sum of all values
+ */
+uint32_t exclusiveScan(uint32_t* values, size_t n);
+
+/**
+ * @brief Byte offsets of the fields gathered from a PointCloud2 like point array.
+ *        Optional fields are set to -1 if the cloud does not contain them.
+ */
+struct CloudGatherLayout
+{
+    size_t width = 0;           // points per row
+    size_t height = 0;          // number of rows
+    size_t point_step = 0;      // bytes per point
+    size_t row_step = 0;        // bytes per row
+    uint32_t xyz[3] = {0, 4, 8};
+    int32_t normal[3] = {-1, -1, -1};
+    int32_t rgb = -1;           // three consecutive bytes
+    int32_t intensity = -1;
+};
+
+/**
+ * @brief Destination arrays of gatherCloud. Outputs for fields missing in the layout are
+ *        not touched and may be null. The bounding box is computed over the finite points.
+ */
+struct CloudGatherOutput
+{
+    float* points = nullptr;       // 3 per point
+    float* normals = nullptr;      // 3 per point
+    uint8_t* colors = nullptr;     // 3 per point
+    float* intensities = nullptr;  // 1 per point
+    float bb_min[3];
+    float bb_max[3];
+};
+
+/**
+ * @brief Output offsets for gathering only the points with finite x, y and z.
+ *        Computed by planCloudCompaction.
+ */
+struct CloudCompaction
+{
+    std::vector<size_t> block_offsets;  // first output index of every gather block
+    size_t num_finite = 0;              // number of points with finite coordinates
+};
+
+/**
+ * @brief Counts the points with finite coordinates of a point array in parallel and computes
+ *        where every block of points starts in the compacted output.
+ *
+ * @param data the raw point data, e.g. sensor_msgs::PointCloud2::data
+ * @param layout the resolved field offsets
+ * @param compaction the resulting offsets and the number of finite points
+ */
+void planCloudCompaction(const uint8_t* data, const CloudGatherLayout& layout, CloudCompaction& compaction);
+
+/**
+ * @brief Gathers all fields of a point array in a single pass and computes the bounding box.
+ *
+ * The layout is dispatched once to a loop specialized for the present fields and for
+ * packed xyz at offsets 0/4/8, and blocks of points are distributed over the OpenMP threads.
+ * If a compaction is given, points with non-finite coordinates are dropped from all outputs.
+ *
+ * @param data the raw point data, e.g. sensor_msgs::PointCloud2::data
+ * @param layout the resolved field offsets
+ * @param out the destination arrays, sized for width * height points, or for
+ *        compaction->num_finite points if compacting
+ * @param compaction the compaction planned by planCloudCompaction, or null to keep all points
+ */
+void gatherCloud(
+    const uint8_t* data,
+    const CloudGatherLayout& layout,
+    CloudGatherOutput& out,
+    const CloudCompaction* compaction = nullptr);
+
+/**
+ * @brief Welds the vertices within epsilon of a cluster leader, using a parallel spatial hash.
+ *
+ * In index order, every vertex which is not welded yet becomes a leader and takes all vertices
+ * within epsilon which are not welded yet, so no vertex moves farther than epsilon, even if
+ * the edges of the mesh are shorter than epsilon. The clusters are numbered in the order of
+ * their leaders, so the result does not depend on the number of threads. Vertices with
+ * non-finite coordinates are never welded.
+ *
+ * @param vertices 3 floats per vertex
+ * @param n number of vertices
+ * @param epsilon the welding distance, if not positive only equal positions are welded
+ * @param remap the output, the index of the welded vertex for each of the n vertices
+ * @return the number of welded vertices
+ */
+size_t weldVertices(const float* vertices, size_t n, float epsilon, uint32_t* remap);
+
+/**
+ * @brief Remaps the indices of n triangles and removes the triangles which became degenerate.
+ *
+ * @param faces 3 indices per triangle
+ * @param n number of triangles
+ * @param remap the new index of every vertex, e.g. from weldVertices
+ * @param out the remapped triangles, space for n triangles, must not overlap faces
+ * @param origins if not null, the index of the source triangle of every remapped triangle
+ * @return the number of remaining triangles
+ */
+size_t remapFaces(const uint32_t* faces, size_t n, const uint32_t* remap, uint32_t* out, uint32_t* origins);
+
+/**
+ * @brief Computes the minimum and maximum of the finite values in parallel
+ * @return false if there is no finite value
+ */
+bool minMax(const float* values, size_t n, float& min, float& max);
+
+/**
+ * @brief Maps values to colors of a lookup table: every value is normalized to [min, max],
+ *        clamped and replaced by the nearest table entry.
+ *
+ * @param values the values
+ * @param n number of values
+ * @param min value mapped to the first table entry
+ * @param max value mapped to the last table entry
+ * @param lut lut_size RGBA colors, followed by the RGBA color for non-finite values
+ * @param lut_size number of colors in the table
+ * @param dst the output, four floats per value
+ */
+void lookupColors(
+    const float* values,
+    size_t n,
+    float min,
+    float max,
+    const float* lut,
+    size_t lut_size,
+    float* dst);
+
+/**
+ * @brief XXH64 hash of a byte array
+ */
+uint64_t xxh64(const void* data, size_t bytes, uint64_t seed = 0);
+
+/**
+ * @brief Content hash of a large byte array: the XXH64 hashes of consecutive 1 MB blocks are
+ *        computed by the OpenMP threads and hashed again. The result does not depend on the
+ *        number of threads, so it is stable across runs and machines of the same endianness.
+ */
+uint64_t contentHash(const void* data, size_t bytes, uint64_t seed = 0);
+
+/**
+ * @brief Name of the instruction set the kernels dispatch to on this CPU, for logging
+ */
+const char* instructionSet();
+
+/**
+ * @brief Called by every thread of a parallel kernel before (begin = true) and after its share
+ *        of the work, with the trace context of the thread which started the kernel
+ */
+typedef void (*TraceHook)(void* context, const char* region, bool begin);
+
+/**
+ * @brief Sets the trace hook of all threads, null to disable it
+ */
+void setTraceHook(TraceHook hook);
+
+/**
+ * @brief Sets the trace context of the calling thread. The kernels only call the hook if the
+ *        thread which starts them has a context, otherwise tracing costs a thread local read.
+ * @return the previous context
+ */
+void* setTraceContext(void* context);
+
+} // namespace kernels
+} // namespace lvr_ros
+
+#endif /* LVR_ROS_KERNELS_H_ */
@@ -0,0 +1,207 @@
+/*
+ * UOS-ROS packages - Robot Operating System code by the University of Osnabrück
+ * Copyright (C) 2013 University of Osnabrück
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * mesh_cache.h
+ *
+ * UUID keyed cache of reconstructed meshes with a memory budget and LRU eviction.
+ *
+ */
+
+#ifndef LVR_ROS_MESH_CACHE_H_
+#define LVR_ROS_MESH_CACHE_H_
+
+#include <atomic>
+#include <memory>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <boost/shared_ptr.hpp>
+
+#include <mesh_msgs/MeshMaterialsStamped.h>
+#include <mesh_msgs/MeshTexture.h>
+#include <mesh_msgs/MeshVertexColorsStamped.h>
+
+#include "lvr_ros/serialization.h"
+
+namespace lvr_ros
+{
+
+/**
+ * @brief One reconstructed mesh. The finalized MeshBuffer is the cached artifact, the geometry
+ *        message streams from it and the attribute messages are built from it on first request.
+ *
+ * Every message is built at most once and is an immutable snapshot afterwards, services and
+ * publishers send it without copying. All methods are thread safe.
+ */
+class CachedMesh
+{
+public:
+    CachedMesh(const std::string& uuid, const std_msgs::Header& header, const lvr2::MeshBufferPtr& mesh_buffer);
+
+    CachedMesh(const CachedMesh&) = delete;
+    CachedMesh& operator=(const CachedMesh&) = delete;
+
+    const std::string& uuid() const;
+
+    const boost::shared_ptr<const MeshBufferGeometryStamped>& geometry() const;
+
+    /**
+     * @return the materials and texture coordinates, null if the conversion failed
+     */
+    boost::shared_ptr<const mesh_msgs::MeshMaterialsStamped> materials() const;
+
+    /**
+     * @return the vertex colors, null if the conversion failed
+     */
+    boost::shared_ptr<const mesh_msgs::MeshVertexColorsStamped> vertexColors() const;
+
+    /**
+     * @return the texture, null if the mesh has no texture with that index
+     */
+    boost::shared_ptr<const mesh_msgs::MeshTexture> texture(size_t index) const;
+
+    size_t numTextures() const;
+
+    /**
+     * @brief Estimates the memory held by the buffer and the messages built so far
+     */
+    size_t bytes() const;
+
+private:
+    const std::string mesh_uuid;
+    const std_msgs::Header header;
+    boost::shared_ptr<const MeshBufferGeometryStamped> geometry_stamped;
+
+    mutable std::once_flag materials_flag;
+    mutable boost::shared_ptr<const mesh_msgs::MeshMaterialsStamped> materials_stamped;
+
+    mutable std::once_flag vertex_colors_flag;
+    mutable boost::shared_ptr<const mesh_msgs::MeshVertexColorsStamped> vertex_colors_stamped;
+
+    // one flag and slot per texture of the buffer
+    std::unique_ptr<std::once_flag[]> texture_flags;
+    mutable std::vector<boost::shared_ptr<const mesh_msgs::MeshTexture>> textures;
+
+    size_t buffer_bytes;
+    mutable std::atomic<size_t> message_bytes;
+};
+
+typedef std::shared_ptr<const CachedMesh> CachedMeshConstPtr;
+
+/**
+ * @brief Keeps the most recently used meshes within a byte budget.
+ *
+ * Meshes are shared with the callers, so an evicted mesh stays valid for a service which is
+ * still sending it. The inserted mesh is never evicted by its own insert, even if it exceeds the
+ * budget on its own. The size of a mesh grows as its messages are built, it is reevaluated
+ * whenever the mesh is looked up or is the next candidate for eviction, and the total size is
+ * kept up to date with these changes instead of being summed up again.
+ *
+ * The index of the cached meshes is an immutable snapshot which is swapped atomically by
+ * insert, so lookups never wait for a lock and never block an insert. All methods are thread safe.
+ */
+class MeshCache
+{
+public:
+    struct Statistics
+    {
+        size_t hits = 0;
+        size_t misses = 0;
+        size_t evictions = 0;
+        size_t entries = 0;
+        size_t bytes = 0;
+    };
+
+    /**
+     * @param max_bytes the budget for the estimated size of all cached meshes
+     */
+    explicit MeshCache(size_t max_bytes);
+
+    /**
+     * @brief Inserts a mesh as the most recently used one, or replaces the mesh with the same
+     *        UUID, and evicts the least recently used meshes until the cache fits into the budget.
+     */
+    void insert(const CachedMeshConstPtr& mesh);
+
+    /**
+     * @brief Looks up a mesh and marks it as the most recently used one
+     * @return the mesh, or null if it is not cached
+     */
+    CachedMeshConstPtr get(const std::string& uuid);
+
+    Statistics statistics() const;
+
+private:
+    struct Entry
+    {
+        CachedMeshConstPtr mesh;
+        std::atomic<uint64_t> last_used;
+        // the bytes of the mesh counted in total_bytes, EVICTED once it has left the cache
+        std::atomic<size_t> accounted;
+    };
+
+    typedef std::unordered_map<std::string, std::shared_ptr<Entry>> Index;
+
+    // (last_used when queued, entry), the least recently used entry on top
+    typedef std::pair<uint64_t, std::shared_ptr<Entry>> LruItem;
+    typedef std::priority_queue<LruItem, std::vector<LruItem>, std::greater<LruItem>> LruQueue;
+
+    static constexpr size_t EVICTED = ~size_t(0);
+
+    /**
+     * @brief Adds the growth of the mesh of an entry since it was last counted to total_bytes,
+     *        unless the entry has been evicted meanwhile
+     */
+    void account(Entry& entry);
+
+    /**
+     * @brief Removes an entry from the total, a concurrent account() no longer counts it
+     */
+    void release(Entry& entry);
+
+    /**
+     * @brief Pops the least recently used entry of the index, requeues entries which have
+     *        been used since they were queued and drops entries which are no longer cached
+     * @return the entry, or null if the queue is empty
+     */
+    std::shared_ptr<Entry> popLeastRecentlyUsed(const Index& current);
+
+    // the current index, only accessed through std::atomic_load and std::atomic_store
+    std::shared_ptr<const Index> index;
+
+    // serializes the writers, guards the LRU queue
+    std::mutex insert_mutex;
+
+    // lazily ordered: the last_used of an item may be outdated, it is checked when it is popped
+    LruQueue lru;
+
+    const size_t max_bytes;
+    std::atomic<size_t> total_bytes;
+    std::atomic<uint64_t> clock;
+    std::atomic<size_t> hits;
+    std::atomic<size_t> misses;
+    std::atomic<size_t> evictions;
+};
+
+} // namespace lvr_ros
+
+#endif /* LVR_ROS_MESH_CACHE_H_ */
@@ -0,0 +1,114 @@
+/*
+ * UOS-ROS packages - Robot Operating System code by the University of Osnabrück
+ * Copyright (C) 2013 University of Osnabrück
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * mesh_store.h
+ *
+ * Persistent HDF5 store of reconstructed meshes, written in the background.
+ *
+ */
+
+#ifndef LVR_ROS_MESH_STORE_H_
+#define LVR_ROS_MESH_STORE_H_
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+#include <hdf5.h>
+
+#include "lvr_ros/mesh_cache.h"
+
+namespace lvr_ros
+{
+
+/**
+ * @brief Keeps the MeshBuffers of reconstructed meshes, with all attributes, textures, materials
+ *        and the header, in a HDF5 file so they survive a restart of the node.
+ *
+ * Every mesh is a group /meshes/<uuid> of chunked datasets named after the MeshBuffer channels.
+ * A mesh is written to /incomplete first and moved to /meshes once it is complete, so a crash never
+ * leaves a partial mesh behind.
+ *
+ * Meshes are written by a background thread, store() only queues them. The file is not scanned
+ * on startup: the index of the stored UUIDs is filled lazily by the lookups. The HDF5 library is
+ * not thread safe, all accesses to the file are serialized. All methods are thread safe.
+ */
+class MeshStore
+{
+public:
+    /**
+     * @brief Opens the store or creates it if the file does not exist
+     * @param path the HDF5 file
+     * @param compression gzip level of the datasets, 0 to store them uncompressed
+     */
+    MeshStore(const std::string& path, int compression);
+
+    /**
+     * @brief Writes all queued meshes and closes the file
+     */
+    ~MeshStore();
+
+    MeshStore(const MeshStore&) = delete;
+    MeshStore& operator=(const MeshStore&) = delete;
+
+    bool isOpen() const;
+
+    /**
+     * @brief Queues a mesh to be written in the background
+     */
+    void store(const CachedMeshConstPtr& mesh);
+
+    /**
+     * @brief Reads a mesh from the file, or returns it from the queue if it is not written yet
+     * @return the mesh, or null if it is not stored
+     */
+    CachedMeshConstPtr load(const std::string& uuid);
+
+    bool contains(const std::string& uuid);
+
+private:
+    void writeQueued();
+
+    // the following methods have to be called with the hdf5_mutex locked
+    bool exists(const std::string& uuid);
+    bool write(const CachedMesh& mesh);
+    CachedMeshConstPtr read(const std::string& uuid);
+
+    const std::string path;
+    const int compression;
+
+    std::mutex hdf5_mutex;
+    hid_t file;
+
+    // lazily built index, true if the mesh is in the file
+    std::unordered_map<std::string, bool> index;
+
+    std::mutex queue_mutex;
+    std::condition_variable condition;
+    std::deque<CachedMeshConstPtr> queue;
+    bool stopped;
+
+    std::thread writer;
+};
+
+} // namespace lvr_ros
+
+#endif /* LVR_ROS_MESH_STORE_H_ */
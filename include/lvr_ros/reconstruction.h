@@ -25,7 +25,13 @@
 #ifndef LVR_ROS_RECONSTRUCTION_H_
 #define LVR_ROS_RECONSTRUCTION_H_
 
-#include <actionlib/server/simple_action_server.h>
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+
+#include <actionlib/server/action_server.h>
+#include <diagnostic_msgs/DiagnosticStatus.h>
 #include <sensor_msgs/PointCloud2.h>
 #include <ros/ros.h>
 #include <ros/console.h>
@@ -40,6 +46,14 @@
 #include <mesh_msgs/MeshGeometryStamped.h>
 #include <mesh_msgs/MeshTexture.h>
 
+#include "lvr_ros/mesh_cache.h"
+#include "lvr_ros/mesh_store.h"
+#include "lvr_ros/reconstruction_progress.h"
+#include "lvr_ros/reconstruction_scheduler.h"
+#include "lvr_ros/reconstruction_timing.h"
+#include "lvr_ros/result_cache.h"
+#include "lvr_ros/serialization.h"
+#include "lvr_ros/trace_recorder.h"
 
 #include <lvr2/geometry/BaseVector.hpp>
 #include <lvr2/io/PointBuffer.hpp>
@@ -63,7 +77,25 @@ class Reconstruction
 public:
     Reconstruction();
 
+    /**
+     * Cancels the running reconstructions and waits for them to stop
+     */
+    ~Reconstruction();
+
 private:
+    typedef actionlib::ActionServer<lvr_ros::ReconstructAction> ActionServer;
+    typedef ActionServer::GoalHandle GoalHandle;
+
+    /**
+     * Queues a reconstruct goal. The goal stays pending while it waits in the queue and becomes
+     * active when a worker starts it.
+     */
+    void goalCallback(GoalHandle goal_handle);
+
+    /**
+     * Removes a waiting goal from the queue or cancels the running reconstruction of the goal
+     */
+    void cancelCallback(GoalHandle goal_handle);
 
     /**
      * Reconstruct action callback
@@ -76,41 +108,85 @@ private:
      * both versions.
      * Make sure to migrate to the new message format quickly before the old one gets discontinued eventually.
      */
-    void reconstruct(const lvr_ros::ReconstructGoalConstPtr& goal);
+    void reconstruct(GoalHandle goal_handle, const ReconstructionConfig& config, ReconstructionProgress& progress);
 
-    // Service callbacks
-    bool service_getGeometry(mesh_msgs::GetGeometry::Request& req, mesh_msgs::GetGeometry::Response& res);
-    bool service_getMaterials(mesh_msgs::GetMaterials::Request& req, mesh_msgs::GetMaterials::Response& res);
-    bool service_getTexture(mesh_msgs::GetTexture::Request& req, mesh_msgs::GetTexture::Response& res);
+    // Service callbacks, the responses share the cached messages instead of copying them
+    bool service_getGeometry(mesh_msgs::GetGeometry::Request& req, MeshBufferGetGeometryResponse& res);
+    bool service_getMaterials(mesh_msgs::GetMaterials::Request& req, SharedGetMaterialsResponse& res);
+    bool service_getTexture(mesh_msgs::GetTexture::Request& req, SharedGetTextureResponse& res);
 
    // bool service_getUUID(mesh_msgs::GetUUID::Request& req, mesh_msgs::GetUUID::Response& res);
 
-    bool service_getVertexColors(mesh_msgs::GetVertexColors::Request& req, mesh_msgs::GetVertexColors::Response& res);
+    bool service_getVertexColors(mesh_msgs::GetVertexColors::Request& req, SharedGetVertexColorsResponse& res);
 
-    // Subscriber callback
+    // Subscriber callback, queues the cloud
     void pointCloudCallback(const sensor_msgs::PointCloud2::ConstPtr& cloud);
 
+    // Reconstructs a cloud received on the topic and publishes the geometry and attributes of the mesh
+    void reconstructCloud(
+        const std::string& name,
+        const sensor_msgs::PointCloud2::ConstPtr& cloud,
+        const ReconstructionConfig& config,
+        ReconstructionProgress& progress
+    );
+
     /**
      * This method will generate
      *   - a TriangleMesh message
      *       - this message will be published in the callback or action function that is calling this method
      *   - a MeshGeometry message and all corresponding MeshAttribute messages
      *       - these messages will be cached and will be available via a service
+     *       - the MeshAttribute messages are built from the cached MeshBuffer on first request
      *
      * Please note: For future versions, it is not intended to keep both messages around. TriangleMesh will be
      * discontinued in favor of the new message structure. To ensure a smooth transition between both APIs, this
      * version of LVR_ROS will be able to generate both messages.
+     *
+     * The mesh is reconstructed by lvr_ros::reconstructMeshBuffer. The stages are reported to the
+     * progress, false is returned as soon as it is canceled. Every step, the input and the output
+     * size are measured with the timing. A mesh reused from the result cache keeps the header it
+     * was reconstructed with, the caller publishes it with the header of the cloud.
      */
-    bool createMeshMessageFromPointCloud(const sensor_msgs::PointCloud2& cloud, mesh_msgs::MeshGeometryStamped& mesh);
+    bool createMeshMessageFromPointCloud(
+        const sensor_msgs::PointCloud2& cloud,
+        CachedMeshConstPtr& mesh,
+        const ReconstructionConfig& config,
+        ReconstructionProgress& progress,
+        ReconstructionTiming& timing
+    );
 
-    bool createMeshBufferFromPointBuffer(PointBufferPtr& point_buffer, lvr2::MeshBufferPtr& mesh_buffer);
+    // Status of a finished job with the timing of its steps, its sizes and throughput
+    diagnostic_msgs::DiagnosticStatus diagnosticStatus(
+        const std::string& name,
+        const ReconstructionTiming& timing,
+        const ReconstructionProgress& progress,
+        bool success
+    ) const;
+
+    void publishDiagnostics(const diagnostic_msgs::DiagnosticStatus& status);
+
+    // Writes a trace to <directory>/trace_<name>_<time>.json, the working directory if empty
+    void writeTrace(const std::string& name, const std::string& directory, const TraceRecorder& trace);
+
+    // Looks up a mesh in the mesh cache or the mesh store, null if it is in neither
+    CachedMeshConstPtr getMesh(const std::string& uuid);
+
+    // Looks up the mesh of a result key in the mesh cache or the mesh store, null if there is none.
+    // A result whose mesh is in neither is removed from the result cache.
+    CachedMeshConstPtr findResult(uint64_t key);
+
+    // Forgets a job which has finished or has been discarded
+    void removeActiveJob(const std::string& name);
 
     // Utility
     float *getStatsCoeffs(std::string filename) const;
     void reconfigureCallback(lvr_ros::ReconstructionConfig& config, uint32_t level);
+
+    // Copy of the current config, every job runs with the config it was queued with
+    ReconstructionConfig getConfig();
+
     typedef dynamic_reconfigure::Server <lvr_ros::ReconstructionConfig> DynReconfigureServer;
     typedef boost::shared_ptr <DynReconfigureServer> DynReconfigureServerPtr;
-    typedef actionlib::SimpleActionServer<lvr_ros::ReconstructAction> ActionServer;
     DynReconfigureServerPtr reconfigure_server_ptr;
     DynReconfigureServer::CallbackType callback_type;
 
@@ -118,8 +194,15 @@ private:
     ros::NodeHandle node_handle;
     ros::Publisher mesh_publisher;          // Is used to publish old TriangleMesh
     ros::Publisher mesh_geometry_publisher; // Is used to publish new MeshGeometry
+    ros::Publisher mesh_materials_publisher;
+    ros::Publisher mesh_vertex_colors_publisher;
+    ros::Publisher diagnostics_publisher;
+    bool latch_topics;
+    // threads of the message conversions of a service call
+    size_t service_threads;
     ros::Subscriber cloud_subscriber;
     ReconstructionConfig config;
+    std::mutex config_mutex;
 
     // ActionServer and Services
     ActionServer as_;
@@ -129,15 +212,32 @@ private:
     ros::ServiceServer srv_get_uuid_;
     ros::ServiceServer srv_get_vertex_colors_;
 
+    // Goals and clouds which are queued or running, by job name
+    struct ActiveJob
+    {
+        ReconstructionScheduler::JobId id;
+        std::shared_ptr<ReconstructionProgress> progress;
+    };
+    std::map<std::string, ActiveJob> active_jobs;
+    std::recursive_mutex active_jobs_mutex;
+    std::atomic<uint64_t> num_clouds{0};
+
     // ROS message cache
-    // Reconstruction will write these messages to cache, services will send them
-    bool cache_initialized = false;
-    mesh_msgs::MeshGeometryStamped cache_mesh_geometry_stamped;
-    mesh_msgs::MeshMaterialsStamped cache_mesh_materials_stamped;
-    mesh_msgs::MeshVertexColorsStamped cache_mesh_vertex_colors_stamped;
-    std::string cache_uuid;
-    std::vector<mesh_msgs::MeshTexture> cache_textures;
+    // Reconstruction will write the messages of every mesh to the cache, services will send them
+    // The geometry stays in the MeshBuffer and is serialized from there on demand
+    std::unique_ptr<MeshCache> mesh_cache;
+
+    // Meshes by the hash of their cloud and config, null if disabled
+    std::unique_ptr<ResultCache> result_cache;
+
+    // Spans of the service calls while tracing is enabled, null otherwise
+    std::shared_ptr<TraceRecorder> service_trace;
+
+    // Persistent copy of the cached meshes, null if disabled
+    std::unique_ptr<MeshStore> mesh_store;
 
+    // Runs goals and topic clouds, declared last to stop its workers before the members they use
+    std::unique_ptr<ReconstructionScheduler> scheduler;
 };
 
 } // namespace lvr_ros
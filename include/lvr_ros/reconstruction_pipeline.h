@@ -0,0 +1,82 @@
+/*
+ * UOS-ROS packages - Robot Operating System code by the University of Osnabrück
+ * Copyright (C) 2013 University of Osnabrück
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * reconstruction_pipeline.h
+ *
+ * The lvr2 surface reconstruction from a PointBuffer to a MeshBuffer, independent of the node.
+ *
+ */
+
+#ifndef LVR_ROS_RECONSTRUCTION_PIPELINE_H_
+#define LVR_ROS_RECONSTRUCTION_PIPELINE_H_
+
+#include <string>
+
+#include <lvr2/io/MeshBuffer.hpp>
+#include <lvr2/io/PointBuffer.hpp>
+
+#include "lvr_ros/ReconstructionConfig.h"
+#include "lvr_ros/reconstruction_progress.h"
+#include "lvr_ros/reconstruction_timing.h"
+
+namespace lvr_ros
+{
+
+/**
+ * @brief Reconstructs a mesh from the points of a buffer: optional downsampling, normal estimation, signed distance
+ *        values, marching cubes, cleanup, planar clustering and finalization.
+ *
+ * Needs neither a ROS master nor a node, it is shared by the reconstruction node and the offline
+ * tools. Several reconstructions may run concurrently, only the mesh extraction is serialized.
+ * The reconstruction uses at most config.threads threads, and never more than the thread limit
+ * of the calling thread.
+ *
+ * @param point_buffer the points, their normals are estimated if they are missing or
+ *        config.recalcNormals is set. With config.downsample the mesh is reconstructed from
+ *        averaged points, the buffer of the caller is left as it is.
+ * @param mesh_buffer the reconstructed mesh
+ * @param progress receives every stage, returns false as soon as it is canceled
+ * @param timing receives the duration of every step
+ * @return false if the reconstruction failed or has been canceled
+ */
+bool reconstructMeshBuffer(
+    lvr2::PointBufferPtr& point_buffer,
+    lvr2::MeshBufferPtr& mesh_buffer,
+    const ReconstructionConfig& config,
+    ReconstructionProgress& progress,
+    ReconstructionTiming& timing
+);
+
+/**
+ * @brief Sets a parameter of a config from its text, e.g. "voxelsize" to "0.05", and clamps it
+ *        to the limits of the parameter
+ * @return false if the config has no such parameter or the value does not match its type
+ */
+bool setConfigValue(ReconstructionConfig& config, const std::string& name, const std::string& value);
+
+/**
+ * @brief Applies the parameters of a flat "name: value" YAML file, e.g. config/lvr_params.yaml,
+ *        to a config. Parameters which are not part of the config, like the node parameters of
+ *        the same file, are ignored, comments and quotes are stripped.
+ * @return false if the file can not be read or a value does not match the type of its parameter
+ */
+bool readConfigFile(const std::string& path, ReconstructionConfig& config);
+
+} // namespace lvr_ros
+
+#endif /* LVR_ROS_RECONSTRUCTION_PIPELINE_H_ */
@@ -0,0 +1,97 @@
+/*
+ * UOS-ROS packages - Robot Operating System code by the University of Osnabrück
+ * Copyright (C) 2013 University of Osnabrück
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * reconstruction_progress.h
+ *
+ * Stage progress and cooperative cancellation of a running reconstruction.
+ *
+ */
+
+#ifndef LVR_ROS_RECONSTRUCTION_PROGRESS_H_
+#define LVR_ROS_RECONSTRUCTION_PROGRESS_H_
+
+#include <atomic>
+#include <functional>
+
+namespace lvr_ros
+{
+
+/**
+ * @brief Tracks the stage of a running reconstruction and whether it has been canceled.
+ *
+ * The reconstruction reports every stage and every step within a stage. Each report is a
+ * cancellation checkpoint: it returns false once cancel() has been called, and the
+ * reconstruction then returns without running the remaining steps. The lvr2 algorithms of a
+ * step cannot be interrupted, so a canceled reconstruction stops after the current step.
+ */
+class ReconstructionProgress
+{
+public:
+    enum Stage
+    {
+        POINT_CONVERSION,  // PointCloud2 to PointBuffer
+        NORMALS,           // search tree and normal estimation
+        DISTANCE_VALUES,   // grid and signed distance values
+        MARCHING,          // mesh extraction
+        CLEANUP,           // dangling clusters, contours, holes
+        CLUSTERING,        // planar cluster growing
+        FINALIZE,          // vertex normals, colors, materials and textures
+        MESH_CONVERSION,   // MeshBuffer to mesh messages
+        NUM_STAGES
+    };
+
+    /**
+     * @brief Called with the current stage and the overall progress in [0, 1]
+     */
+    typedef std::function<void(Stage stage, float progress)> Callback;
+
+    ReconstructionProgress(Callback callback = Callback());
+
+    /**
+     * @brief Starts a stage
+     * @return false if the reconstruction has been canceled
+     */
+    bool enter(Stage stage);
+
+    /**
+     * @brief Reports the progress within the current stage
+     * @param fraction the finished part of the stage in [0, 1]
+     * @return false if the reconstruction has been canceled
+     */
+    bool update(float fraction);
+
+    /**
+     * @brief Requests the cancellation, may be called from any thread
+     */
+    void cancel();
+
+    bool isCanceled() const;
+
+    Stage stage() const;
+
+    static const char* stageName(Stage stage);
+
+private:
+    Callback callback;
+    std::atomic<bool> canceled;
+    std::atomic<int> current_stage;
+};
+
+} // namespace lvr_ros
+
+#endif /* LVR_ROS_RECONSTRUCTION_PROGRESS_H_ */
@@ -0,0 +1,165 @@
+/*
+ * UOS-ROS packages - Robot Operating System code by the University of Osnabrück
+ * Copyright (C) 2013 University of Osnabrück
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * reconstruction_scheduler.h
+ *
+ * Bounded priority queue of reconstruction jobs served by a pool of worker threads which
+ * share a global budget of CPU threads.
+ *
+ */
+
+#ifndef LVR_ROS_RECONSTRUCTION_SCHEDULER_H_
+#define LVR_ROS_RECONSTRUCTION_SCHEDULER_H_
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace lvr_ros
+{
+
+/**
+ * @brief A queued reconstruction, e.g. an action goal or a cloud received on the topic
+ */
+struct ReconstructionJob
+{
+    enum Priority
+    {
+        TOPIC = 0,  // clouds received on the point cloud topic
+        GOAL = 1    // action goals, always served before topic clouds
+    };
+
+    enum DiscardReason
+    {
+        QUEUE_FULL,   // the queue was full and the job could not replace another one
+        SUPERSEDED,   // replaced by a newer job while waiting
+        CANCELED,     // removed from the queue by ReconstructionScheduler::cancel
+        SHUTDOWN      // still queued when the scheduler was shut down
+    };
+
+    // name used in the log
+    std::string name;
+
+    Priority priority = TOPIC;
+
+    // whether a newer supersedable job of the same priority replaces this one while it waits,
+    // e.g. an older cloud of the topic. Supersedable jobs also make room for jobs of a higher
+    // priority if the queue is full.
+    bool supersedable = false;
+
+    // number of threads the job would like to use
+    size_t threads = 1;
+
+    // runs the job with the granted number of threads
+    std::function<void(size_t threads)> run;
+
+    // called instead of run if the job is not executed
+    std::function<void(DiscardReason reason)> discard;
+};
+
+/**
+ * @brief Runs reconstruction jobs concurrently on a fixed number of workers.
+ *
+ * Jobs are served by priority and in submission order within a priority. Every running job
+ * holds min(threads, thread budget) threads of the budget; the next job in the queue starts as
+ * soon as a worker is idle and enough threads are free, so a large job is not starved by a
+ * stream of small ones. The granted thread count is set as the OpenMP thread count of the
+ * worker, which is inherited by all parallel regions started by the job.
+ */
+class ReconstructionScheduler
+{
+public:
+    typedef uint64_t JobId;
+
+    /**
+     * @brief Starts the workers
+     * @param num_workers maximum number of concurrently running jobs
+     * @param thread_budget total number of threads of all running jobs
+     * @param max_queued maximum number of waiting jobs
+     */
+    ReconstructionScheduler(size_t num_workers, size_t thread_budget, size_t max_queued);
+
+    /**
+     * @brief Discards all waiting jobs and waits for the running ones
+     */
+    ~ReconstructionScheduler();
+
+    ReconstructionScheduler(const ReconstructionScheduler&) = delete;
+    ReconstructionScheduler& operator=(const ReconstructionScheduler&) = delete;
+
+    /**
+     * @brief Queues a job. A supersedable job replaces the waiting supersedable job of the same
+     *        priority. If the queue is full, the oldest supersedable job of a lower priority is
+     *        discarded to make room, otherwise the new job is discarded.
+     * @return the id of the job, 0 if it was discarded
+     */
+    JobId submit(ReconstructionJob job);
+
+    /**
+     * @brief Removes a waiting job from the queue and discards it
+     * @return false if the job is not waiting, e.g. because it is already running
+     */
+    bool cancel(JobId id);
+
+    /**
+     * @brief Discards all waiting jobs and waits for the running ones. No job is accepted afterwards.
+     */
+    void shutdown();
+
+    size_t numQueued() const;
+
+    size_t numRunning() const;
+
+    size_t threadBudget() const;
+
+private:
+
+    struct QueuedJob
+    {
+        JobId id;
+        ReconstructionJob job;
+    };
+
+    void work();
+
+    // number of threads of the budget granted to a job
+    size_t grantedThreads(const ReconstructionJob& job) const;
+
+    mutable std::mutex mutex;
+    std::condition_variable condition;
+
+    // waiting jobs ordered by priority and id
+    std::deque<QueuedJob> queue;
+    std::vector<std::thread> workers;
+
+    const size_t thread_budget;
+    const size_t max_queued;
+    size_t threads_in_use = 0;
+    size_t num_running = 0;
+    JobId next_id = 1;
+    bool stopped = false;
+};
+
+} // namespace lvr_ros
+
+#endif /* LVR_ROS_RECONSTRUCTION_SCHEDULER_H_ */
@@ -0,0 +1,150 @@
+/*
+ * UOS-ROS packages - Robot Operating System code by the University of Osnabrück
+ * Copyright (C) 2013 University of Osnabrück
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * reconstruction_timing.h
+ *
+ * Durations of the steps of a reconstruction, its input and output sizes and its throughput.
+ *
+ */
+
+#ifndef LVR_ROS_RECONSTRUCTION_TIMING_H_
+#define LVR_ROS_RECONSTRUCTION_TIMING_H_
+
+#include <chrono>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include <diagnostic_msgs/DiagnosticStatus.h>
+
+namespace lvr_ros
+{
+
+/**
+ * @brief Collects the wall clock time of every step of a single reconstruction.
+ *
+ * The steps are measured with scoped timers and kept in the order they have been started, a
+ * step which is measured several times accumulates its durations. The resident memory of the
+ * process is sampled at the end of every step, its growth since the construction of the timing is
+ * reported as the memory of the reconstruction. With concurrent reconstructions the memory of the
+ * others is included. The total time runs from the construction of the timing.
+ * A timing is filled by the thread running its reconstruction.
+ */
+class ReconstructionTiming
+{
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    /**
+     * @brief Measures a step from its construction until it is stopped or destroyed, the step is
+     *        also recorded by the active trace recorder of the thread
+     */
+    class Scope
+    {
+    public:
+        Scope(ReconstructionTiming& timing, const std::string& step);
+
+        ~Scope();
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+        void stop();
+
+    private:
+        ReconstructionTiming* timing;
+        std::string step;
+        Clock::time_point start;
+    };
+
+    struct Step
+    {
+        std::string name;
+        double seconds;
+        // resident memory of the process at the end of the step, in bytes
+        size_t resident_memory;
+    };
+
+    ReconstructionTiming();
+
+    /**
+     * @brief Adds the duration of a step
+     */
+    void add(const std::string& step, double seconds);
+
+    void setInputSize(size_t points);
+
+    void setOutputSize(size_t vertices, size_t faces);
+
+    /**
+     * @brief Marks the result as reused from a previous reconstruction
+     */
+    void setReused(bool reused);
+
+    /**
+     * @return the seconds since the timing was created
+     */
+    double totalSeconds() const;
+
+    const std::vector<Step>& steps() const;
+
+    /**
+     * @brief Writes the durations, sizes and throughput as key value pairs into a status
+     */
+    void toDiagnosticStatus(diagnostic_msgs::DiagnosticStatus& status) const;
+
+    /**
+     * @brief Writes the steps, sizes and throughput as a JSON object
+     */
+    void writeJson(std::ostream& out) const;
+
+    /**
+     * @return a single line with the total time, the throughput and the slowest steps
+     */
+    std::string summary() const;
+
+    /**
+     * @return the largest growth of the resident memory sampled at the end of the steps, relative
+     *         to the construction of the timing, in bytes
+     */
+    size_t memoryGrowth() const;
+
+    /**
+     * @return the current resident memory of the process in bytes
+     */
+    static size_t residentMemory();
+
+    /**
+     * @return the peak resident memory of the process since it started in bytes, the peak of a
+     *         single reconstruction only if it runs in a process of its own
+     */
+    static size_t peakMemory();
+
+private:
+    Clock::time_point start;
+    size_t start_memory;
+    std::vector<Step> durations;
+    size_t input_points;
+    size_t output_vertices;
+    size_t output_faces;
+    bool reused;
+};
+
+} // namespace lvr_ros
+
+#endif /* LVR_ROS_RECONSTRUCTION_TIMING_H_ */
@@ -0,0 +1,123 @@
+/*
+ * UOS-ROS packages - Robot Operating System code by the University of Osnabrück
+ * Copyright (C) 2013 University of Osnabrück
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * result_cache.h
+ *
+ * Index of reconstruction results by the content of the input cloud and the effective config.
+ *
+ */
+
+#ifndef LVR_ROS_RESULT_CACHE_H_
+#define LVR_ROS_RESULT_CACHE_H_
+
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include <sensor_msgs/PointCloud2.h>
+
+#include "lvr_ros/ReconstructionConfig.h"
+
+namespace lvr_ros
+{
+
+/**
+ * @brief Hash of the points of a cloud: the layout, the frame and the data, not the stamp
+ */
+uint64_t hashPointCloud(const sensor_msgs::PointCloud2& cloud);
+
+/**
+ * @brief Canonical hash of all parameters which change the reconstructed mesh, i.e. every
+ *        parameter except the thread count and the tracing. Independent of the order of the parameters.
+ */
+uint64_t hashConfig(const ReconstructionConfig& config);
+
+/**
+ * @brief Maps the hash of a cloud and a config to the UUID of the mesh reconstructed from them,
+ *        so the same request is answered without running the pipeline again.
+ *
+ * Only the index is kept here, the meshes themselves are resolved by their UUID through the
+ * MeshCache and the MeshStore. At most max_entries results are kept, the least recently used
+ * one is dropped first, and the owner erases a result as soon as its mesh can not be resolved.
+ * If a directory is given, the index is appended to <directory>/index and read again after a
+ * restart. The file is rewritten without the replaced and dropped lines when it is read and
+ * whenever it has grown to twice max_entries lines. All methods are thread safe.
+ */
+class ResultCache
+{
+public:
+    /**
+     * @param directory where the index is persisted, empty to keep the index in memory only
+     * @param max_entries the number of results which are kept at most
+     * @param available tells whether the mesh of a persisted result can still be resolved, the
+     *        other results are dropped when the index is read. All are kept if it is empty.
+     */
+    explicit ResultCache(
+        const std::string& directory = "",
+        size_t max_entries = 4096,
+        const std::function<bool(const std::string&)>& available = std::function<bool(const std::string&)>()
+    );
+
+    static uint64_t key(const sensor_msgs::PointCloud2& cloud, const ReconstructionConfig& config);
+
+    /**
+     * @return the UUID of the mesh reconstructed for the key, empty if there is none
+     */
+    std::string find(uint64_t key);
+
+    /**
+     * @brief Indexes a new mesh and appends it to the persisted index if a directory is set
+     */
+    void insert(uint64_t key, const std::string& uuid);
+
+    /**
+     * @brief Drops the result of the key if it still points to the given mesh
+     */
+    void erase(uint64_t key, const std::string& uuid);
+
+    bool persistent() const;
+
+private:
+    struct Result
+    {
+        std::string uuid;
+        std::list<uint64_t>::iterator position;
+    };
+
+    // the following methods have to be called with the mutex locked
+    void add(uint64_t key, const std::string& uuid);
+    bool readIndex(const std::function<bool(const std::string&)>& available);
+    bool writeIndex();
+
+    const std::string directory;
+    const size_t max_entries;
+
+    std::mutex mutex;
+    // the keys of the results, the most recently used first
+    std::list<uint64_t> order;
+    std::unordered_map<uint64_t, Result> results;
+    // the lines of the persisted index, including replaced and dropped results
+    size_t index_lines;
+};
+
+} // namespace lvr_ros
+
+#endif /* LVR_ROS_RESULT_CACHE_H_ */
@@ -0,0 +1,359 @@
+/*
+ * UOS-ROS packages - Robot Operating System code by the University of Osnabrück
+ * Copyright (C) 2013 University of Osnabrück
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * serialization.h
+ *
+ * Direct ROS wire serialization of lvr2::MeshBuffer geometry and of shared service responses.
+ *
+ */
+
+#ifndef LVR_ROS_SERIALIZATION_H_
+#define LVR_ROS_SERIALIZATION_H_
+
+#include <cstring>
+#include <string>
+
+#include <ros/serialization.h>
+#include <ros/message_traits.h>
+#include <ros/service_traits.h>
+
+#include <boost/make_shared.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include <std_msgs/Header.h>
+#include <mesh_msgs/MeshGeometryStamped.h>
+#include <mesh_msgs/GetGeometry.h>
+#include <mesh_msgs/GetMaterials.h>
+#include <mesh_msgs/GetTexture.h>
+#include <mesh_msgs/GetVertexColors.h>
+
+#include <lvr2/io/MeshBuffer.hpp>
+
+#include "lvr_ros/kernels.h"
+
+namespace lvr_ros {
+
+/**
+ * @brief A mesh_msgs::MeshGeometryStamped that references its geometry in a lvr2::MeshBuffer.
+ *
+ * The type is wire compatible with mesh_msgs::MeshGeometryStamped, i.e. it can be published on
+ * a topic advertised with that message type. Vertices, normals and faces are written straight
+ * from the buffer arrays into the outgoing bytes by the bulk kernels, so no geometry_msgs::Point
+ * arrays are staged.
+ * Subscribing with this type reads the geometry directly into a new MeshBuffer.
+ */
+struct MeshBufferGeometryStamped
+{
+    std_msgs::Header header;
+    std::string uuid;
+    lvr2::MeshBufferPtr mesh_buffer;
+
+    typedef boost::shared_ptr<MeshBufferGeometryStamped> Ptr;
+    typedef boost::shared_ptr<const MeshBufferGeometryStamped> ConstPtr;
+};
+
+/**
+ * @brief Response of the mesh_msgs/GetGeometry service streamed from a lvr2::MeshBuffer.
+ */
+struct MeshBufferGetGeometryResponse
+{
+    MeshBufferGeometryStamped mesh_geometry_stamped;
+};
+
+/**
+ * @brief Service response which consists of a single message and sends a shared immutable
+ *        instance of it, so a cached message is serialized without being copied first.
+ *
+ * Wire compatible with Response, whose only field is a Message. An empty pointer is sent as a
+ * default constructed Message.
+ */
+template<typename Response, typename Message>
+struct SharedMessageResponse
+{
+    boost::shared_ptr<const Message> message;
+};
+
+typedef SharedMessageResponse<mesh_msgs::GetMaterialsResponse, mesh_msgs::MeshMaterialsStamped>
+    SharedGetMaterialsResponse;
+typedef SharedMessageResponse<mesh_msgs::GetVertexColorsResponse, mesh_msgs::MeshVertexColorsStamped>
+    SharedGetVertexColorsResponse;
+typedef SharedMessageResponse<mesh_msgs::GetTextureResponse, mesh_msgs::MeshTexture>
+    SharedGetTextureResponse;
+
+namespace detail {
+
+template<typename Stream>
+inline void writeFloatsAsDoubles(Stream& stream, const float* src, size_t count)
+{
+    kernels::floatToDouble(src, stream.advance(static_cast<uint32_t>(count * sizeof(double))), count);
+}
+
+template<typename Stream>
+inline void readDoublesAsFloats(Stream& stream, float* dst, size_t count)
+{
+    kernels::doubleToFloat(stream.advance(static_cast<uint32_t>(count * sizeof(double))), dst, count);
+}
+
+} // namespace detail
+
+} // namespace lvr_ros
+
+namespace ros {
+namespace message_traits {
+
+template<> struct IsMessage<lvr_ros::MeshBufferGeometryStamped> : TrueType {};
+template<> struct IsMessage<const lvr_ros::MeshBufferGeometryStamped> : TrueType {};
+template<> struct HasHeader<lvr_ros::MeshBufferGeometryStamped> : TrueType {};
+template<> struct HasHeader<const lvr_ros::MeshBufferGeometryStamped> : TrueType {};
+
+template<>
+struct MD5Sum<lvr_ros::MeshBufferGeometryStamped>
+{
+    static const char* value() { return MD5Sum<mesh_msgs::MeshGeometryStamped>::value(); }
+    static const char* value(const lvr_ros::MeshBufferGeometryStamped&) { return value(); }
+};
+
+template<>
+struct DataType<lvr_ros::MeshBufferGeometryStamped>
+{
+    static const char* value() { return DataType<mesh_msgs::MeshGeometryStamped>::value(); }
+    static const char* value(const lvr_ros::MeshBufferGeometryStamped&) { return value(); }
+};
+
+template<>
+struct Definition<lvr_ros::MeshBufferGeometryStamped>
+{
+    static const char* value() { return Definition<mesh_msgs::MeshGeometryStamped>::value(); }
+    static const char* value(const lvr_ros::MeshBufferGeometryStamped&) { return value(); }
+};
+
+template<> struct IsMessage<lvr_ros::MeshBufferGetGeometryResponse> : TrueType {};
+template<> struct IsMessage<const lvr_ros::MeshBufferGetGeometryResponse> : TrueType {};
+
+template<>
+struct MD5Sum<lvr_ros::MeshBufferGetGeometryResponse>
+{
+    static const char* value() { return MD5Sum<mesh_msgs::GetGeometryResponse>::value(); }
+    static const char* value(const lvr_ros::MeshBufferGetGeometryResponse&) { return value(); }
+};
+
+template<>
+struct DataType<lvr_ros::MeshBufferGetGeometryResponse>
+{
+    static const char* value() { return DataType<mesh_msgs::GetGeometryResponse>::value(); }
+    static const char* value(const lvr_ros::MeshBufferGetGeometryResponse&) { return value(); }
+};
+
+template<>
+struct Definition<lvr_ros::MeshBufferGetGeometryResponse>
+{
+    static const char* value() { return Definition<mesh_msgs::GetGeometryResponse>::value(); }
+    static const char* value(const lvr_ros::MeshBufferGetGeometryResponse&) { return value(); }
+};
+
+template<typename R, typename M> struct IsMessage<lvr_ros::SharedMessageResponse<R, M> > : TrueType {};
+template<typename R, typename M> struct IsMessage<const lvr_ros::SharedMessageResponse<R, M> > : TrueType {};
+
+template<typename R, typename M>
+struct MD5Sum<lvr_ros::SharedMessageResponse<R, M> >
+{
+    static const char* value() { return MD5Sum<R>::value(); }
+    static const char* value(const lvr_ros::SharedMessageResponse<R, M>&) { return value(); }
+};
+
+template<typename R, typename M>
+struct DataType<lvr_ros::SharedMessageResponse<R, M> >
+{
+    static const char* value() { return DataType<R>::value(); }
+    static const char* value(const lvr_ros::SharedMessageResponse<R, M>&) { return value(); }
+};
+
+template<typename R, typename M>
+struct Definition<lvr_ros::SharedMessageResponse<R, M> >
+{
+    static const char* value() { return Definition<R>::value(); }
+    static const char* value(const lvr_ros::SharedMessageResponse<R, M>&) { return value(); }
+};
+
+} // namespace message_traits
+
+namespace service_traits {
+
+template<>
+struct MD5Sum<lvr_ros::MeshBufferGetGeometryResponse>
+{
+    static const char* value() { return MD5Sum<mesh_msgs::GetGeometryResponse>::value(); }
+    static const char* value(const lvr_ros::MeshBufferGetGeometryResponse&) { return value(); }
+};
+
+template<>
+struct DataType<lvr_ros::MeshBufferGetGeometryResponse>
+{
+    static const char* value() { return DataType<mesh_msgs::GetGeometryResponse>::value(); }
+    static const char* value(const lvr_ros::MeshBufferGetGeometryResponse&) { return value(); }
+};
+
+template<typename R, typename M>
+struct MD5Sum<lvr_ros::SharedMessageResponse<R, M> >
+{
+    static const char* value() { return MD5Sum<R>::value(); }
+    static const char* value(const lvr_ros::SharedMessageResponse<R, M>&) { return value(); }
+};
+
+template<typename R, typename M>
+struct DataType<lvr_ros::SharedMessageResponse<R, M> >
+{
+    static const char* value() { return DataType<R>::value(); }
+    static const char* value(const lvr_ros::SharedMessageResponse<R, M>&) { return value(); }
+};
+
+} // namespace service_traits
+
+namespace serialization {
+
+/**
+ * Writes the mesh_msgs/MeshGeometryStamped wire format:
+ *   Header header, string uuid, Point[] vertices, Point[] vertex_normals, MeshTriangleIndices[] faces
+ */
+template<>
+struct Serializer<lvr_ros::MeshBufferGeometryStamped>
+{
+    template<typename Stream>
+    inline static void write(Stream& stream, const lvr_ros::MeshBufferGeometryStamped& m)
+    {
+        stream.next(m.header);
+        stream.next(m.uuid);
+
+        const uint32_t n_vertices = m.mesh_buffer ? m.mesh_buffer->numVertices() : 0;
+        const uint32_t n_faces = m.mesh_buffer ? m.mesh_buffer->numFaces() : 0;
+        const bool has_normals = n_vertices > 0 && m.mesh_buffer->hasVertexNormals();
+
+        stream.next(n_vertices);
+        if (n_vertices > 0)
+        {
+            lvr_ros::detail::writeFloatsAsDoubles(stream, m.mesh_buffer->getVertices().get(), n_vertices * 3);
+        }
+
+        const uint32_t n_normals = has_normals ? n_vertices : 0;
+        stream.next(n_normals);
+        if (has_normals)
+        {
+            lvr_ros::detail::writeFloatsAsDoubles(stream, m.mesh_buffer->getVertexNormals().get(), n_normals * 3);
+        }
+
+        stream.next(n_faces);
+        if (n_faces > 0)
+        {
+            const uint32_t face_bytes = n_faces * 3 * sizeof(uint32_t);
+            std::memcpy(stream.advance(face_bytes), m.mesh_buffer->getFaceIndices().get(), face_bytes);
+        }
+    }
+
+    template<typename Stream>
+    inline static void read(Stream& stream, lvr_ros::MeshBufferGeometryStamped& m)
+    {
+        stream.next(m.header);
+        stream.next(m.uuid);
+        m.mesh_buffer = lvr2::MeshBufferPtr(new lvr2::MeshBuffer);
+
+        uint32_t n_vertices;
+        stream.next(n_vertices);
+        lvr2::floatArr vertices(new float[n_vertices * 3]);
+        lvr_ros::detail::readDoublesAsFloats(stream, vertices.get(), n_vertices * 3);
+        m.mesh_buffer->setVertices(vertices, n_vertices);
+
+        uint32_t n_normals;
+        stream.next(n_normals);
+        if (n_normals > 0)
+        {
+            lvr2::floatArr normals(new float[n_normals * 3]);
+            lvr_ros::detail::readDoublesAsFloats(stream, normals.get(), n_normals * 3);
+            if (n_normals == n_vertices)
+            {
+                m.mesh_buffer->setVertexNormals(normals);
+            }
+        }
+
+        uint32_t n_faces;
+        stream.next(n_faces);
+        const uint32_t face_bytes = n_faces * 3 * sizeof(uint32_t);
+        lvr2::indexArray faces(new unsigned int[n_faces * 3]);
+        std::memcpy(faces.get(), stream.advance(face_bytes), face_bytes);
+        m.mesh_buffer->setFaceIndices(faces, n_faces);
+    }
+
+    inline static uint32_t serializedLength(const lvr_ros::MeshBufferGeometryStamped& m)
+    {
+        const uint32_t n_vertices = m.mesh_buffer ? m.mesh_buffer->numVertices() : 0;
+        const uint32_t n_faces = m.mesh_buffer ? m.mesh_buffer->numFaces() : 0;
+        const uint32_t n_normals = (n_vertices > 0 && m.mesh_buffer->hasVertexNormals()) ? n_vertices : 0;
+
+        uint32_t size = serializationLength(m.header) + serializationLength(m.uuid);
+        size += 4 + n_vertices * 3 * sizeof(double);
+        size += 4 + n_normals * 3 * sizeof(double);
+        size += 4 + n_faces * 3 * sizeof(uint32_t);
+        return size;
+    }
+};
+
+template<>
+struct Serializer<lvr_ros::MeshBufferGetGeometryResponse>
+{
+    template<typename Stream, typename T>
+    inline static void allInOne(Stream& stream, T m)
+    {
+        stream.next(m.mesh_geometry_stamped);
+    }
+
+    ROS_DECLARE_ALLINONE_SERIALIZER
+};
+
+template<typename R, typename M>
+struct Serializer<lvr_ros::SharedMessageResponse<R, M> >
+{
+    template<typename Stream>
+    inline static void write(Stream& stream, const lvr_ros::SharedMessageResponse<R, M>& m)
+    {
+        if (m.message)
+        {
+            stream.next(*m.message);
+        }
+        else
+        {
+            stream.next(M());
+        }
+    }
+
+    template<typename Stream>
+    inline static void read(Stream& stream, lvr_ros::SharedMessageResponse<R, M>& m)
+    {
+        boost::shared_ptr<M> message = boost::make_shared<M>();
+        stream.next(*message);
+        m.message = message;
+    }
+
+    inline static uint32_t serializedLength(const lvr_ros::SharedMessageResponse<R, M>& m)
+    {
+        return m.message ? serializationLength(*m.message) : serializationLength(M());
+    }
+};
+
+} // namespace serialization
+} // namespace ros
+
+#endif /* LVR_ROS_SERIALIZATION_H_ */
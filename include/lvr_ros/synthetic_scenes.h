@@ -0,0 +1,96 @@
+/*
+ * UOS-ROS packages - Robot Operating System code by the University of Osnabrück
+ * Copyright (C) 2013 University of Osnabrück
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * synthetic_scenes.h
+ *
+ * Deterministic synthetic point clouds to benchmark the reconstruction without sensor data.
+ *
+ */
+
+#ifndef LVR_ROS_SYNTHETIC_SCENES_H_
+#define LVR_ROS_SYNTHETIC_SCENES_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include <sensor_msgs/PointCloud2.h>
+
+namespace lvr_ros
+{
+
+struct SyntheticScene
+{
+    enum Type
+    {
+        // the floor, ceiling and walls of a closed box shaped room
+        ROOM,
+        // the floor, ceiling and walls of a long corridor with open ends
+        CORRIDOR,
+        // the surface of a sphere
+        SPHERE,
+        // a rough height field
+        TERRAIN,
+        // an organized cloud of a depth camera in the middle of a room with a ball in front of it,
+        // the returns beyond the range of the camera are NaN
+        DEPTH_GRID
+    };
+
+    Type type = ROOM;
+
+    // number of points, the depth grid rounds it to a 4:3 image
+    size_t points = 100000;
+
+    // edge length of the scene in meters
+    double size = 10.0;
+
+    // standard deviation of the gaussian noise in meters, along the rays of the depth grid
+    double noise = 0.005;
+
+    uint64_t seed = 1;
+};
+
+/**
+ * @brief Parses the name of a scene type, e.g. "room" or "depth_grid"
+ * @return false if the name is unknown
+ */
+bool parseSyntheticSceneType(const std::string& name, SyntheticScene::Type& type);
+
+const char* syntheticSceneTypeName(SyntheticScene::Type type);
+
+/**
+ * @return the sampled surface area of a scene in square meters, to derive the number of points
+ *         from a density, 0 for the depth grid whose density depends on the distance
+ */
+double syntheticSceneArea(const SyntheticScene& scene);
+
+/**
+ * @brief Generates the points of a scene as FLOAT32 x, y and z fields.
+ *
+ * Every point is drawn from its own random sequence seeded by the seed and its index, so a
+ * scene does not depend on the number of OpenMP threads.
+ */
+void generateSyntheticScene(
+    const SyntheticScene& scene,
+    sensor_msgs::PointCloud2& cloud,
+    const std::string& frame = "map"
+);
+
+} // namespace lvr_ros
+
+#endif /* LVR_ROS_SYNTHETIC_SCENES_H_ */
@@ -0,0 +1,67 @@
+/*
+ * UOS-ROS packages - Robot Operating System code by the University of Osnabrück
+ * Copyright (C) 2013 University of Osnabrück
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * thread_budget.h
+ *
+ * Limits the OpenMP threads of the parallel regions started by a thread, i.e. of lvr2, of the
+ * message conversions and of the kernels.
+ *
+ */
+
+#ifndef LVR_ROS_THREAD_BUDGET_H_
+#define LVR_ROS_THREAD_BUDGET_H_
+
+#include <cstddef>
+
+namespace lvr_ros
+{
+
+/**
+ * @brief Sets the number of threads of the parallel regions the calling thread starts from now
+ *        on, through lvr2::OpenMPConfig. Every thread has its own limit, threads which never set
+ *        it use all cores.
+ */
+void setThreadLimit(size_t threads);
+
+/**
+ * @return the number of threads of the next parallel region started by the calling thread
+ */
+size_t threadLimit();
+
+/**
+ * @brief Lowers the thread limit of the calling thread for its lifetime, a higher limit than
+ *        the current one is ignored, e.g. the config of a job can not exceed the threads
+ *        granted to the job by the scheduler.
+ */
+class ScopedThreadLimit
+{
+public:
+    explicit ScopedThreadLimit(size_t threads);
+
+    ~ScopedThreadLimit();
+
+    ScopedThreadLimit(const ScopedThreadLimit&) = delete;
+    ScopedThreadLimit& operator=(const ScopedThreadLimit&) = delete;
+
+private:
+    size_t previous;
+};
+
+} // namespace lvr_ros
+
+#endif /* LVR_ROS_THREAD_BUDGET_H_ */
@@ -0,0 +1,141 @@
+/*
+ * UOS-ROS packages - Robot Operating System code by the University of Osnabrück
+ * Copyright (C) 2013 University of Osnabrück
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * trace_recorder.h
+ *
+ * Per thread timeline of a reconstruction in the Chrome trace event format.
+ *
+ */
+
+#ifndef LVR_ROS_TRACE_RECORDER_H_
+#define LVR_ROS_TRACE_RECORDER_H_
+
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace lvr_ros
+{
+
+/**
+ * @brief Records spans of the threads working on a reconstruction and writes them as a Chrome
+ *        trace, which can be opened in chrome://tracing or the Perfetto UI.
+ *
+ * A recorder is activated on a thread, every span started on that thread is then recorded by
+ * it. The parallel kernels started on an activated thread report the share of every OpenMP
+ * thread as a span as well. Without an active recorder a span only reads a thread local pointer,
+ * so the instrumentation stays in place when tracing is disabled. All methods are thread safe.
+ */
+class TraceRecorder
+{
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    /**
+     * @brief Makes a recorder the active one of the calling thread until it is destroyed
+     */
+    class Activation
+    {
+    public:
+        /**
+         * @param recorder the recorder, null to keep tracing disabled
+         * @param thread_name name of the calling thread in the trace
+         */
+        Activation(TraceRecorder* recorder, const std::string& thread_name);
+
+        ~Activation();
+
+        Activation(const Activation&) = delete;
+        Activation& operator=(const Activation&) = delete;
+
+    private:
+        TraceRecorder* previous;
+    };
+
+    /**
+     * @brief Records a span of the calling thread from its construction until it is stopped or
+     *        destroyed, if a recorder is active on the thread
+     */
+    class Span
+    {
+    public:
+        Span(const char* name, const char* category);
+
+        ~Span();
+
+        Span(const Span&) = delete;
+        Span& operator=(const Span&) = delete;
+
+        void stop();
+
+    private:
+        TraceRecorder* recorder;
+        const char* name;
+        const char* category;
+        Clock::time_point start;
+    };
+
+    /**
+     * @param name name of the traced process, e.g. the job
+     */
+    explicit TraceRecorder(const std::string& name);
+
+    /**
+     * @return the active recorder of the calling thread, null if there is none
+     */
+    static TraceRecorder* current();
+
+    /**
+     * @brief Records a span of the calling thread
+     */
+    void record(const std::string& name, const char* category, Clock::time_point start, Clock::time_point end);
+
+    /**
+     * @brief Writes the trace as JSON
+     * @return false if the file can not be written
+     */
+    bool write(const std::string& path) const;
+
+    size_t numEvents() const;
+
+private:
+    struct Event
+    {
+        std::string name;
+        const char* category;
+        int thread;
+        int64_t start_us;
+        int64_t duration_us;
+    };
+
+    // names the calling thread in the trace, the first name of a thread is kept
+    void nameThread(int thread, const std::string& name);
+
+    const std::string name;
+    const Clock::time_point origin;
+
+    mutable std::mutex mutex;
+    std::vector<Event> events;
+    std::map<int, std::string> thread_names;
+};
+
+} // namespace lvr_ros
+
+#endif /* LVR_ROS_TRACE_RECORDER_H_ */
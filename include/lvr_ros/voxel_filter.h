@@ -0,0 +1,51 @@
+/*
+ * UOS-ROS packages - Robot Operating System code by the University of Osnabrück
+ * Copyright (C) 2013 University of Osnabrück
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * voxel_filter.h
+ *
+ * Voxel grid downsampling of point buffers before the surface reconstruction.
+ *
+ */
+
+#ifndef LVR_ROS_VOXEL_FILTER_H_
+#define LVR_ROS_VOXEL_FILTER_H_
+
+#include <lvr2/io/PointBuffer.hpp>
+
+namespace lvr_ros
+{
+
+/**
+ * @brief Replaces the points within every cell of a voxel grid by a single point, their average.
+ *
+ * All channels of the buffer, e.g. normals, colors and intensities, are averaged the same way,
+ * integer channels are rounded and the averaged normals are normalized again. Points with
+ * non-finite coordinates are dropped. The cells are sorted in parallel, so the result does not
+ * depend on the number of threads. If the cloud spans more than 2^21 cells along an axis, the
+ * leaf size is enlarged to fit.
+ *
+ * @param input the points and their channels
+ * @param leaf_size the edge length of the cells
+ * @param output the averaged points, one per occupied cell
+ * @return false if the leaf size is not positive or the input has no finite points
+ */
+bool voxelDownsample(const lvr2::PointBufferPtr& input, double leaf_size, lvr2::PointBufferPtr& output);
+
+} // namespace lvr_ros
+
+#endif /* LVR_ROS_VOXEL_FILTER_H_ */
@@ -43,7 +43,10 @@
  */
 
 #include "lvr_ros/colors.h"
+#include "lvr_ros/kernels.h"
 #include <math.h>
+#include <algorithm>
+#include <vector>
 #include <std_msgs/ColorRGBA.h>
 
 namespace lvr_ros
@@ -77,4 +80,92 @@ void getRainbowColor(float value, float &r, float &g, float &b)
   else if (i >= 5) r = 1, g = n, b = 0;
 }
 
+static float clamp01(float value)
+{
+  return std::max(0.0f, std::min(1.0f, value));
+}
+
+// matplotlib's viridis sampled at 0, 0.1, ..., 1
+static const float VIRIDIS[11][3] = {
+  {0.267f, 0.005f, 0.329f}, {0.283f, 0.141f, 0.458f}, {0.254f, 0.265f, 0.530f},
+  {0.207f, 0.372f, 0.553f}, {0.164f, 0.471f, 0.558f}, {0.128f, 0.567f, 0.551f},
+  {0.135f, 0.659f, 0.518f}, {0.267f, 0.749f, 0.441f}, {0.478f, 0.821f, 0.318f},
+  {0.741f, 0.873f, 0.150f}, {0.993f, 0.906f, 0.144f}
+};
+
+void getColorMapColor(ColorMap map, float value, float &r, float &g, float &b)
+{
+  value = clamp01(value);
+  switch(map)
+  {
+    case ColorMap::JET:
+      r = clamp01(1.5f - fabs(4.0f * value - 3.0f));
+      g = clamp01(1.5f - fabs(4.0f * value - 2.0f));
+      b = clamp01(1.5f - fabs(4.0f * value - 1.0f));
+      break;
+    case ColorMap::HOT:
+      r = clamp01(3.0f * value);
+      g = clamp01(3.0f * value - 1.0f);
+      b = clamp01(3.0f * value - 2.0f);
+      break;
+    case ColorMap::GRAY:
+      r = g = b = value;
+      break;
+    case ColorMap::VIRIDIS:
+    {
+      const float x = value * 10.0f;
+      const int i = std::min(9, static_cast<int>(x));
+      const float f = x - i;
+      r = VIRIDIS[i][0] + f * (VIRIDIS[i + 1][0] - VIRIDIS[i][0]);
+      g = VIRIDIS[i][1] + f * (VIRIDIS[i + 1][1] - VIRIDIS[i][1]);
+      b = VIRIDIS[i][2] + f * (VIRIDIS[i + 1][2] - VIRIDIS[i][2]);
+      break;
+    }
+    case ColorMap::RAINBOW:
+    default:
+      getRainbowColor(value, r, g, b);
+      break;
+  }
+}
+
+static std::vector<float> createColorMapLUT(ColorMap map)
+{
+  std::vector<float> lut((COLOR_MAP_LUT_SIZE + 1) * 4, 0.0f);
+  for(size_t i = 0; i < COLOR_MAP_LUT_SIZE; i++)
+  {
+    float* rgba = &lut[i * 4];
+    getColorMapColor(map, i / static_cast<float>(COLOR_MAP_LUT_SIZE - 1), rgba[0], rgba[1], rgba[2]);
+    rgba[3] = 1.0f;
+  }
+  // the last entry stays transparent black for non-finite values
+  return lut;
+}
+
+const float* getColorMapLUT(ColorMap map)
+{
+  static const std::vector<float> luts[] = {
+    createColorMapLUT(ColorMap::RAINBOW),
+    createColorMapLUT(ColorMap::JET),
+    createColorMapLUT(ColorMap::HOT),
+    createColorMapLUT(ColorMap::GRAY),
+    createColorMapLUT(ColorMap::VIRIDIS)
+  };
+  return luts[static_cast<int>(map)].data();
+}
+
+void getColorMapColors(
+    const float* values,
+    size_t n,
+    ColorMap map,
+    float min,
+    float max,
+    std_msgs::ColorRGBA* colors)
+{
+  static_assert(sizeof(std_msgs::ColorRGBA) == 4 * sizeof(float),
+                "std_msgs::ColorRGBA is expected to be four packed floats");
+  if(n == 0)
+    return;
+  kernels::lookupColors(values, n, min, max, getColorMapLUT(map), COLOR_MAP_LUT_SIZE, &colors->r);
+}
+
 } /* namespace lvr_ros */
\ No newline at end of file
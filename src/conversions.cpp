@@ -29,11 +29,54 @@
 
 #include "lvr_ros/conversions.h"
 #include "lvr_ros/colors.h"
+#include "lvr_ros/kernels.h"
+#include <algorithm>
 #include <cmath>
 #include <lvr2/geometry/ColorVertex.hpp>
 
 namespace lvr_ros {
 
+    // The bulk kernels treat the message arrays as plain interleaved arrays
+    static_assert(sizeof(geometry_msgs::Point) == 3 * sizeof(double),
+                  "geometry_msgs::Point is expected to be three packed doubles");
+    static_assert(sizeof(mesh_msgs::MeshTriangleIndices) == 3 * sizeof(uint32_t),
+                  "mesh_msgs::MeshTriangleIndices is expected to be three packed uint32");
+    static_assert(sizeof(std_msgs::ColorRGBA) == 4 * sizeof(float),
+                  "std_msgs::ColorRGBA is expected to be four packed floats");
+
+    static inline void copyFloatsToPoints(const float *src, std::vector<geometry_msgs::Point> &dst, size_t n) {
+        dst.resize(n);
+        if (n > 0) {
+            kernels::floatToDouble(src, &dst[0].x, n * 3);
+        }
+    }
+
+    static inline lvr2::floatArr copyPointsToFloats(const std::vector<geometry_msgs::Point> &src) {
+        lvr2::floatArr dst(new float[src.size() * 3]);
+        if (!src.empty()) {
+            kernels::doubleToFloat(&src[0].x, dst.get(), src.size() * 3);
+        }
+        return dst;
+    }
+
+    static inline void copyIndicesToFaces(
+            const unsigned int *src,
+            std::vector<mesh_msgs::MeshTriangleIndices> &dst,
+            size_t n) {
+        dst.resize(n);
+        if (n > 0) {
+            kernels::copyIndices(src, dst[0].vertex_indices.data(), n * 3);
+        }
+    }
+
+    static inline lvr2::indexArray copyFacesToIndices(const std::vector<mesh_msgs::MeshTriangleIndices> &src) {
+        lvr2::indexArray dst(new unsigned int[src.size() * 3]);
+        if (!src.empty()) {
+            kernels::copyIndices(src[0].vertex_indices.data(), dst.get(), src.size() * 3);
+        }
+        return dst;
+    }
+
     bool fromMeshBufferToMeshGeometryMessage(
             const lvr2::MeshBufferPtr &buffer,
             mesh_msgs::MeshGeometry &mesh_geometry
@@ -44,37 +87,18 @@ namespace lvr_ros {
         ROS_DEBUG_STREAM("Copy vertices from MeshBuffer to MeshGeometry.");
 
         // Copy vertices
-        mesh_geometry.vertices.resize(n_vertices);
-        auto buffer_vertices = buffer->getVertices();
-        for (unsigned int i = 0; i < n_vertices; i++) {
-
-            mesh_geometry.vertices[i].x = buffer_vertices[i * 3];
-            mesh_geometry.vertices[i].y = buffer_vertices[i * 3 + 1];
-            mesh_geometry.vertices[i].z = buffer_vertices[i * 3 + 2];
-        }
+        copyFloatsToPoints(buffer->getVertices().get(), mesh_geometry.vertices, n_vertices);
 
         ROS_DEBUG_STREAM("Copy faces from MeshBuffer to MeshGeometry.");
 
         // Copy faces
-        auto buffer_faces = buffer->getFaceIndices();
-        mesh_geometry.faces.resize(n_faces);
-        for (unsigned int i = 0; i < n_faces; i++) {
-            mesh_geometry.faces[i].vertex_indices[0] = buffer_faces[i * 3];
-            mesh_geometry.faces[i].vertex_indices[1] = buffer_faces[i * 3 + 1];
-            mesh_geometry.faces[i].vertex_indices[2] = buffer_faces[i * 3 + 2];
-        }
+        copyIndicesToFaces(buffer->getFaceIndices().get(), mesh_geometry.faces, n_faces);
 
         // Copy vertex normals
-        auto buffer_vertexnormals = buffer->getVertexNormals();
         if (buffer->hasVertexNormals()) {
             ROS_DEBUG_STREAM("Copy normals from MeshBuffer to MeshGeometry.");
 
-            mesh_geometry.vertex_normals.resize(n_vertices);
-            for (unsigned int i = 0; i < n_vertices; i++) {
-                mesh_geometry.vertex_normals[i].x = buffer_vertexnormals[i * 3];
-                mesh_geometry.vertex_normals[i].y = buffer_vertexnormals[i * 3 + 1];
-                mesh_geometry.vertex_normals[i].z = buffer_vertexnormals[i * 3 + 2];
-            }
+            copyFloatsToPoints(buffer->getVertexNormals().get(), mesh_geometry.vertex_normals, n_vertices);
         } else {
             ROS_DEBUG_STREAM("No vertex normals given!");
         }
@@ -91,182 +115,159 @@ namespace lvr_ros {
             mesh_msgs::MeshVertexColors &mesh_vertex_colors,
             boost::optional<std::vector < mesh_msgs::MeshTexture> &> texture_cache,
             std::string mesh_uuid) {
-    size_t n_vertices = buffer->numVertices();
-    size_t n_faces = buffer->numFaces();
-
-    // copy vertices, faces and normals
-    fromMeshBufferToMeshGeometryMessage(buffer, mesh_geometry
-    );
-
-    //size_t n_clusters = buffer->; TODO Clusters?
-    // Copy clusters
-    /*auto buffer_clusters = buffer->get;
-    mesh_materials.clusters.resize(n_clusters);
-    for (unsigned int i = 0; i < n_clusters; i++)
-    {
-        int n = buffer_clusters[i].size();
-        mesh_materials.clusters[i].face_indices.resize(n);
-        for (unsigned int j = 0; j < n; j++)
-        {
-            mesh_materials.clusters[i].face_indices[j] = buffer_clusters[i][j];
-        }
+        // copy vertices, faces and normals
+        fromMeshBufferToMeshGeometryMessage(buffer, mesh_geometry);
+
+        return fromMeshBufferToMeshAttributeMessages(
+                buffer,
+                mesh_materials,
+                mesh_vertex_colors,
+                texture_cache,
+                mesh_uuid);
     }
-    buffer_clusters.clear();
-    */
 
-    size_t n_materials = buffer->getMaterials().size();
-    size_t n_textures = buffer->getTextures().size();
-
-    // Copy materials
-    auto buffer_materials = buffer->getMaterials();
-    mesh_materials.materials.
-    resize(n_materials);
-    for (
-    unsigned int i = 0;
-    i<n_materials;
-    i++) {
-    const lvr2::Material &m = buffer_materials[i];
-    if (m.m_color) {
-    mesh_materials.materials[i].color.
-    r = m.m_color.get()[0] / 255.0;
-    mesh_materials.materials[i].color.
-    g = m.m_color.get()[1] / 255.0;
-    mesh_materials.materials[i].color.
-    b = m.m_color.get()[2] / 255.0;
-    mesh_materials.materials[i].color.
-    a = 1.0;
-    }
-    else
-    {
-    mesh_materials.materials[i].color.
-    r = 1.0;
-    mesh_materials.materials[i].color.
-    g = 1.0;
-    mesh_materials.materials[i].color.
-    b = 1.0;
-    mesh_materials.materials[i].color.
-    a = 1.0;
-    }
-    if (m.m_texture)
-    {
-    mesh_materials.materials[i].
-    has_texture = true;
-    mesh_materials.materials[i].
-    texture_index = (int) m.m_texture.get().idx();
-    }
-    else
-    {
-    mesh_materials.materials[i].
-    has_texture = false;
-    mesh_materials.materials[i].
-    texture_index = 0;
-    }
-    }
-    buffer_materials.
+    bool fromMeshBufferToMeshAttributeMessages(
+            const lvr2::MeshBufferPtr &buffer,
+            mesh_msgs::MeshMaterials &mesh_materials,
+            mesh_msgs::MeshVertexColors &mesh_vertex_colors,
+            boost::optional<std::vector < mesh_msgs::MeshTexture> &> texture_cache,
+            std::string mesh_uuid) {
+        if (!fromMeshBufferToMeshMaterialsMessage(buffer, mesh_materials)
+                || !fromMeshBufferToMeshVertexColorsMessage(buffer, mesh_vertex_colors)) {
+            return false;
+        }
 
-    clear();
+        // If texture cache is available, cache textures in given vector
+        if (texture_cache) {
+            size_t n_textures = buffer->getTextures().size();
+            texture_cache.get().resize(n_textures);
+            for (unsigned int i = 0; i < n_textures; i++) {
+                if (!fromMeshBufferToMeshTextureMessage(buffer, i, mesh_uuid, texture_cache.get().at(i))) {
+                    return false;
+                }
+            }
+        }
 
-    // Copy cluster material indices TODO Cluster Materials?
-    /*
-    auto buffer_cluster_materials = buffer->getClusterMaterialIndices();
-    mesh_materials.materials.resize(n_clusters);
-    for (unsigned int i = 0; i < n_clusters; i++)
-    {
-        mesh_materials.cluster_materials[i] = buffer_cluster_materials[i];
+        return true;
     }
-    buffer_cluster_materials.clear();
-    */
 
-    // Copy vertex tex coords
-    auto buffer_texcoords = buffer->getTextureCoordinates();
-    {
-    mesh_materials.vertex_tex_coords.
-    resize(n_vertices);
+    bool fromMeshBufferToMeshMaterialsMessage(
+            const lvr2::MeshBufferPtr &buffer,
+            mesh_msgs::MeshMaterials &mesh_materials) {
+        size_t n_vertices = buffer->numVertices();
 
-    for (
-    unsigned int i = 0;
-    i<n_vertices;
-    i++)
-    {
-    mesh_materials.vertex_tex_coords[i].
-    u = buffer_texcoords[i * 3];
-    mesh_materials.vertex_tex_coords[i].
-    v = buffer_texcoords[i * 3 + 1];
-    }
-    }
+        //size_t n_clusters = buffer->; TODO Clusters?
+        // Copy clusters
+        /*auto buffer_clusters = buffer->get;
+        mesh_materials.clusters.resize(n_clusters);
+        for (unsigned int i = 0; i < n_clusters; i++)
+        {
+            int n = buffer_clusters[i].size();
+            mesh_materials.clusters[i].face_indices.resize(n);
+            for (unsigned int j = 0; j < n; j++)
+            {
+                mesh_materials.clusters[i].face_indices[j] = buffer_clusters[i][j];
+            }
+        }
+        buffer_clusters.clear();
+        */
 
-    // Copy vertex colors
-    if (buffer->
+        // Copy materials
+        const auto &buffer_materials = buffer->getMaterials();
+        size_t n_materials = buffer_materials.size();
+        mesh_materials.materials.resize(n_materials);
+        for (unsigned int i = 0; i < n_materials; i++) {
+            const lvr2::Material &m = buffer_materials[i];
+            if (m.m_color) {
+                mesh_materials.materials[i].color.r = m.m_color.get()[0] / 255.0;
+                mesh_materials.materials[i].color.g = m.m_color.get()[1] / 255.0;
+                mesh_materials.materials[i].color.b = m.m_color.get()[2] / 255.0;
+                mesh_materials.materials[i].color.a = 1.0;
+            } else {
+                mesh_materials.materials[i].color.r = 1.0;
+                mesh_materials.materials[i].color.g = 1.0;
+                mesh_materials.materials[i].color.b = 1.0;
+                mesh_materials.materials[i].color.a = 1.0;
+            }
+            if (m.m_texture) {
+                mesh_materials.materials[i].has_texture = true;
+                mesh_materials.materials[i].texture_index = (int) m.m_texture.get().idx();
+            } else {
+                mesh_materials.materials[i].has_texture = false;
+                mesh_materials.materials[i].texture_index = 0;
+            }
+        }
 
-    hasVertexColors()
+        // Copy cluster material indices TODO Cluster Materials?
+        /*
+        auto buffer_cluster_materials = buffer->getClusterMaterialIndices();
+        mesh_materials.materials.resize(n_clusters);
+        for (unsigned int i = 0; i < n_clusters; i++)
+        {
+            mesh_materials.cluster_materials[i] = buffer_cluster_materials[i];
+        }
+        buffer_cluster_materials.clear();
+        */
 
-    )
-    {
-    size_t color_channels = 3;
-    auto buffer_vertex_colors = buffer->getVertexColors(color_channels);
-    mesh_vertex_colors.vertex_colors.
-    resize(n_vertices);
-    for (
-    size_t i = 0;
-    i<n_vertices;
-    i++)
-    {
-    mesh_vertex_colors.vertex_colors[i].
-    r = buffer_vertex_colors[i * 3 + 0] / 255.0;
-    mesh_vertex_colors.vertex_colors[i].
-    g = buffer_vertex_colors[i * 3 + 1] / 255.0;
-    mesh_vertex_colors.vertex_colors[i].
-    b = buffer_vertex_colors[i * 3 + 2] / 255.0;
-    mesh_vertex_colors.vertex_colors[i].
-    a = 1.0;
-    }
-    }
+        // Copy vertex tex coords, two per vertex
+        auto buffer_texcoords = buffer->getTextureCoordinates();
+        if (buffer_texcoords) {
+            mesh_materials.vertex_tex_coords.resize(n_vertices);
 
-    // If texture cache is available, cache textures in given vector
-    if (texture_cache)
-    {
-    auto buffer_textures = buffer->getTextures();
-    texture_cache.
+            for (unsigned int i = 0; i < n_vertices; i++) {
+                mesh_materials.vertex_tex_coords[i].u = buffer_texcoords[i * 2];
+                mesh_materials.vertex_tex_coords[i].v = buffer_texcoords[i * 2 + 1];
+            }
+        }
 
-    get()
+        return true;
+    }
 
-    .
-    resize(n_textures);
-    for (
-    unsigned int i = 0;
-    i<n_textures;
-    i++)
-    {
-    sensor_msgs::Image image;
-    sensor_msgs::fillImage(
-            image,
-    "rgb8",
-    buffer_textures[i].m_height,
-    buffer_textures[i].m_width,
-    buffer_textures[i].m_width * 3, // step size
-    buffer_textures[i].m_data
-    );
-    mesh_msgs::MeshTexture texture;
-    texture.
-    uuid = mesh_uuid;
-    texture.
-    texture_index = i;
-    texture.
-    image = image;
-    texture_cache.
+    bool fromMeshBufferToMeshVertexColorsMessage(
+            const lvr2::MeshBufferPtr &buffer,
+            mesh_msgs::MeshVertexColors &mesh_vertex_colors) {
+        size_t n_vertices = buffer->numVertices();
 
-    get()
+        // Copy vertex colors
+        if (buffer->hasVertexColors()) {
+            size_t color_channels = 3;
+            auto buffer_vertex_colors = buffer->getVertexColors(color_channels);
+            mesh_vertex_colors.vertex_colors.resize(n_vertices);
+            if (n_vertices > 0) {
+                kernels::rgbToRGBAFloat(
+                        buffer_vertex_colors.get(),
+                        color_channels,
+                        &mesh_vertex_colors.vertex_colors[0].r,
+                        n_vertices);
+            }
+        }
 
-    .
-    at(i) = texture;
+        return true;
     }
-    buffer_textures.
-
-    clear();
 
-    }
+    bool fromMeshBufferToMeshTextureMessage(
+            const lvr2::MeshBufferPtr &buffer,
+            size_t texture_index,
+            const std::string &mesh_uuid,
+            mesh_msgs::MeshTexture &texture) {
+        const auto &buffer_textures = buffer->getTextures();
+        if (texture_index >= buffer_textures.size()) {
+            ROS_ERROR_STREAM("The mesh has no texture with index " << texture_index << "!");
+            return false;
+        }
 
-    return true;
+        const lvr2::Texture &buffer_texture = buffer_textures[texture_index];
+        sensor_msgs::fillImage(
+                texture.image,
+                "rgb8",
+                buffer_texture.m_height,
+                buffer_texture.m_width,
+                buffer_texture.m_width * 3, // step size
+                buffer_texture.m_data
+        );
+        texture.uuid = mesh_uuid;
+        texture.texture_index = texture_index;
+        return true;
     }
 
     bool fromMeshBufferToTriangleMesh(
@@ -284,38 +285,16 @@ namespace lvr_ros {
         ROS_DEBUG_STREAM("number vertices: " << numVertices);
         ROS_DEBUG_STREAM("number triangles: " << numFaces);
 
-        auto vertices = buffer.getVertices();
-        auto faces = buffer.getFaceIndices();
-
-        mesh.vertices.resize(numVertices);
-        mesh.faces.resize(numFaces);
-
         // copy vertices
-        for (size_t i = 0; i < numVertices; i++) {
-            mesh.vertices[i].x = vertices[i * 3 + 0];
-            mesh.vertices[i].y = vertices[i * 3 + 1];
-            mesh.vertices[i].z = vertices[i * 3 + 2];
-        }
+        copyFloatsToPoints(buffer.getVertices().get(), mesh.vertices, numVertices);
 
         // copy triangles
-        for (size_t i = 0; i < numFaces; i++) {
-            mesh.faces[i].vertex_indices[0] = faces[i * 3 + 0];
-            mesh.faces[i].vertex_indices[1] = faces[i * 3 + 1];
-            mesh.faces[i].vertex_indices[2] = faces[i * 3 + 2];
-
-        }
+        copyIndicesToFaces(buffer.getFaceIndices().get(), mesh.faces, numFaces);
 
         // copy normals if available
         if (buffer.hasVertexNormals()) {
-            mesh.vertex_normals.resize(numVertices);
-            auto normals = buffer.getVertexNormals();
-
             // copy point normals
-            for (size_t i = 0; i < numVertices; i++) {
-                mesh.vertex_normals[i].x = normals[i * 3 + 0];
-                mesh.vertex_normals[i].y = normals[i * 3 + 1];
-                mesh.vertex_normals[i].z = normals[i * 3 + 2];
-            }
+            copyFloatsToPoints(buffer.getVertexNormals().get(), mesh.vertex_normals, numVertices);
         }
         /*
               optional:
@@ -333,34 +312,34 @@ namespace lvr_ros {
     bool fromMeshGeometryToMeshBuffer(
             const mesh_msgs::MeshGeometryConstPtr &mesh_geometry_ptr,
             lvr2::MeshBuffer &buffer) {
-        fromMeshGeometryToMeshBuffer(*mesh_geometry_ptr, buffer);
+        return fromMeshGeometryToMeshBuffer(*mesh_geometry_ptr, buffer);
     }
 
     bool fromMeshGeometryToMeshBuffer(
             const mesh_msgs::MeshGeometryConstPtr &mesh_geometry_ptr,
             lvr2::MeshBufferPtr &buffer_ptr) {
         if (!buffer_ptr) buffer_ptr = lvr2::MeshBufferPtr(new lvr2::MeshBuffer);
-        fromMeshGeometryToMeshBuffer(*mesh_geometry_ptr, *buffer_ptr);
+        return fromMeshGeometryToMeshBuffer(*mesh_geometry_ptr, *buffer_ptr);
     }
 
     bool fromMeshGeometryToMeshBuffer(
             const mesh_msgs::MeshGeometryPtr &mesh_geometry_ptr,
             lvr2::MeshBufferPtr &buffer_ptr) {
         if (!buffer_ptr) buffer_ptr = lvr2::MeshBufferPtr(new lvr2::MeshBuffer);
-        fromMeshGeometryToMeshBuffer(*mesh_geometry_ptr, *buffer_ptr);
+        return fromMeshGeometryToMeshBuffer(*mesh_geometry_ptr, *buffer_ptr);
     }
 
     bool fromMeshGeometryToMeshBuffer(
             const mesh_msgs::MeshGeometryPtr &mesh_geometry_ptr,
             lvr2::MeshBuffer &buffer) {
-        fromMeshGeometryToMeshBuffer(*mesh_geometry_ptr, buffer);
+        return fromMeshGeometryToMeshBuffer(*mesh_geometry_ptr, buffer);
     }
 
     bool fromMeshGeometryToMeshBuffer(
             const mesh_msgs::MeshGeometry &mesh_geometry,
             lvr2::MeshBufferPtr &buffer_ptr) {
         if (!buffer_ptr) buffer_ptr = lvr2::MeshBufferPtr(new lvr2::MeshBuffer);
-        fromMeshGeometryToMeshBuffer(mesh_geometry, *buffer_ptr);
+        return fromMeshGeometryToMeshBuffer(mesh_geometry, *buffer_ptr);
     }
 
     bool fromMeshGeometryToMeshBuffer(
@@ -368,34 +347,15 @@ namespace lvr_ros {
             lvr2::MeshBuffer &buffer) {
 
         const size_t numVertices = mesh_geometry.vertices.size();
-        lvr2::floatArr vertices(new float[numVertices * 3]);
-        const auto &mg_vertices = mesh_geometry.vertices;
-        for (size_t i; i < numVertices; i++) {
-            vertices[i * 3 + 0] = static_cast<float>(mg_vertices[i].x);
-            vertices[i * 3 + 1] = static_cast<float>(mg_vertices[i].y);
-            vertices[i * 3 + 2] = static_cast<float>(mg_vertices[i].z);
-        }
-        buffer.setVertices(vertices, numVertices);
+        buffer.setVertices(copyPointsToFloats(mesh_geometry.vertices), numVertices);
 
         const size_t numFaces = mesh_geometry.faces.size();
-        lvr2::indexArray faces(new unsigned int[numVertices * 3]);
-        const auto &mg_faces = mesh_geometry.faces;
-        for (size_t i; i < numFaces; i++) {
-            faces[i * 3 + 0] = mg_faces[i].vertex_indices[0];
-            faces[i * 3 + 1] = mg_faces[i].vertex_indices[1];
-            faces[i * 3 + 2] = mg_faces[i].vertex_indices[2];
-        }
-        buffer.setFaceIndices(faces, numFaces);
+        buffer.setFaceIndices(copyFacesToIndices(mesh_geometry.faces), numFaces);
 
         const size_t numNormals = mesh_geometry.vertex_normals.size();
-        lvr2::floatArr normals(new float[numNormals * 3]);
-        const auto &mg_normals = mesh_geometry.vertex_normals;
-        for (size_t i; i < numNormals; i++) {
-            normals[i * 3 + 0] = static_cast<float>(mg_normals[i].x);
-            normals[i * 3 + 1] = static_cast<float>(mg_normals[i].y);
-            normals[i * 3 + 2] = static_cast<float>(mg_normals[i].z);
+        if (numNormals > 0 && numNormals == numVertices) {
+            buffer.setVertexNormals(copyPointsToFloats(mesh_geometry.vertex_normals));
         }
-        buffer.setVertexNormals(normals);
 
         return true;
     }
@@ -404,34 +364,15 @@ namespace lvr_ros {
             const mesh_msgs::MeshGeometry &mesh,
             lvr2::MeshBuffer &buffer) {
         const size_t numVertices = mesh.vertices.size();
-        lvr2::floatArr vertices(new float[numVertices * 3]);
-        const auto &mg_vertices = mesh.vertices;
-        for (size_t i; i < numVertices; i++) {
-            vertices[i * 3 + 0] = static_cast<float>(mg_vertices[i].x);
-            vertices[i * 3 + 1] = static_cast<float>(mg_vertices[i].y);
-            vertices[i * 3 + 2] = static_cast<float>(mg_vertices[i].z);
-        }
-        buffer.setVertices(vertices, numVertices);
+        buffer.setVertices(copyPointsToFloats(mesh.vertices), numVertices);
 
         const size_t numFaces = mesh.faces.size();
-        lvr2::indexArray faces(new unsigned int[numVertices * 3]);
-        const auto &mg_faces = mesh.faces;
-        for (size_t i; i < numFaces; i++) {
-            faces[i * 3 + 0] = mg_faces[i].vertex_indices[0];
-            faces[i * 3 + 1] = mg_faces[i].vertex_indices[1];
-            faces[i * 3 + 2] = mg_faces[i].vertex_indices[2];
-        }
-        buffer.setFaceIndices(faces, numFaces);
+        buffer.setFaceIndices(copyFacesToIndices(mesh.faces), numFaces);
 
         const size_t numNormals = mesh.vertex_normals.size();
-        lvr2::floatArr normals(new float[numNormals * 3]);
-        const auto &mg_normals = mesh.vertex_normals;
-        for (size_t i; i < numNormals; i++) {
-            normals[i * 3 + 0] = static_cast<float>(mg_normals[i].x);
-            normals[i * 3 + 1] = static_cast<float>(mg_normals[i].y);
-            normals[i * 3 + 2] = static_cast<float>(mg_normals[i].z);
+        if (numNormals > 0 && numNormals == numVertices) {
+            buffer.setVertexNormals(copyPointsToFloats(mesh.vertex_normals));
         }
-        buffer.setVertexNormals(normals);
 
         return true;
     }
@@ -448,6 +389,21 @@ namespace lvr_ros {
         }
     }
 
+    bool readPointBuffer(lvr2::PointBufferPtr &buffer, string path) {
+        lvr2::ModelPtr model = lvr2::ModelFactory::readModel(path);
+        if (!model || !model->m_pointCloud || model->m_pointCloud->numPoints() == 0) {
+            return false;
+        }
+        buffer = model->m_pointCloud;
+        return true;
+    }
+
+    bool writePointBuffer(lvr2::PointBufferPtr &buffer, string path) {
+        lvr2::ModelPtr model(new lvr2::Model(buffer));
+        lvr2::ModelFactory::saveModel(model, path);
+        return true;
+    }
+
     bool writeMeshBuffer(lvr2::MeshBufferPtr &buffer, string path) {
         lvr2::ModelPtr model(new lvr2::Model(buffer));
         lvr2::ModelFactory::saveModel(model, path);
@@ -474,71 +430,177 @@ namespace lvr_ros {
         return false;
     }
 
-    void removeDuplicates(lvr2::MeshBuffer &buffer) {
-        lvr2::floatArr old_vertexBuffer;
-        lvr2::uintArr old_indexBuffer;
-        std::vector<float> new_vertexBuffer;
-        std::vector<unsigned int> new_indexBuffer;
-
-        size_t old_numVertices, old_numIndices;
-        size_t new_numVertices, new_numIndices;
-
-        old_vertexBuffer = buffer.getVertices();
-        old_indexBuffer = buffer.getFaceIndices();
-
-
-        std::map<lvr2::floatArr, unsigned int> vertexMap;
-        size_t pos;
-        int index;
-        int newsizeVer = buffer.numVertices();
-
-        for (int i = 0; i < old_numIndices; i++) {
-            for (int j = 0; j < 3; j++) {
-                index = old_indexBuffer[3 * i + j];
-
-                lvr2::floatArr vertex(new float[3]);
-                vertex[0] = old_vertexBuffer[3 * index];
-                vertex[1] = old_vertexBuffer[3 * index + 1];
-                vertex[2] = old_vertexBuffer[3 * index + 2];
+    size_t weldVertices(lvr2::MeshBuffer &buffer, float epsilon) {
+        const size_t num_vertices = buffer.numVertices();
+        const size_t num_faces = buffer.numFaces();
+        if (num_vertices == 0) {
+            return 0;
+        }
 
+        lvr2::floatArr vertices = buffer.getVertices();
+        std::vector<uint32_t> remap(num_vertices);
+        const size_t num_welded = kernels::weldVertices(vertices.get(), num_vertices, epsilon, remap.data());
+        if (num_welded == num_vertices) {
+            return 0;
+        }
 
-                if (vertexMap.find(vertex) != vertexMap.end()) {
-                    pos = vertexMap[vertex];
-                } else {
-                    pos = new_vertexBuffer.size() / 3;
-                    new_vertexBuffer.push_back(vertex[0]);
-                    new_vertexBuffer.push_back(vertex[1]);
-                    new_vertexBuffer.push_back(vertex[2]);
+        // the welded vertex keeps the position and texture coordinate of its first vertex,
+        // normals and colors are averaged
+        lvr2::floatArr normals = buffer.hasVertexNormals() ? buffer.getVertexNormals() : lvr2::floatArr();
+        size_t color_width = 0;
+        lvr2::ucharArr colors = buffer.hasVertexColors() ? buffer.getVertexColors(color_width) : lvr2::ucharArr();
+        const size_t color_channels = colors ? color_width : 0;
+        lvr2::floatArr tex_coords = buffer.getTextureCoordinates();
+
+        lvr2::floatArr new_vertices(new float[num_welded * 3]);
+        lvr2::floatArr new_normals(normals ? new float[num_welded * 3]() : nullptr);
+        lvr2::ucharArr new_colors(colors ? new uint8_t[num_welded * color_width] : nullptr);
+        lvr2::floatArr new_tex_coords(tex_coords ? new float[num_welded * 2] : nullptr);
+        std::vector<uint32_t> color_sums(num_welded * color_channels, 0);
+        std::vector<uint32_t> cluster_sizes(num_welded, 0);
+
+        for (size_t i = 0; i < num_vertices; i++) {
+            const size_t k = remap[i];
+            if (cluster_sizes[k]++ == 0) {
+                std::copy(vertices.get() + i * 3, vertices.get() + i * 3 + 3, new_vertices.get() + k * 3);
+                if (tex_coords) {
+                    new_tex_coords[k * 2] = tex_coords[i * 2];
+                    new_tex_coords[k * 2 + 1] = tex_coords[i * 2 + 1];
+                }
+            }
+            if (normals) {
+                for (int c = 0; c < 3; c++) {
+                    new_normals[k * 3 + c] += normals[i * 3 + c];
+                }
+            }
+            for (size_t c = 0; c < color_channels; c++) {
+                color_sums[k * color_channels + c] += colors[i * color_channels + c];
+            }
+        }
 
-                    vertexMap.insert(pair<lvr2::floatArr, unsigned int>(vertex, pos));
+        #pragma omp parallel for schedule(static)
+        for (size_t k = 0; k < num_welded; k++) {
+            if (normals) {
+                float *n = new_normals.get() + k * 3;
+                const float length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+                if (length > 0) {
+                    n[0] /= length;
+                    n[1] /= length;
+                    n[2] /= length;
                 }
+            }
+            for (size_t c = 0; c < color_channels; c++) {
+                new_colors[k * color_channels + c] = static_cast<uint8_t>(
+                        (color_sums[k * color_channels + c] + cluster_sizes[k] / 2) / cluster_sizes[k]);
+            }
+        }
 
-                new_indexBuffer.push_back(pos);
+        // remap the faces and drop the collapsed ones, per face data follows the remaining faces
+        lvr2::indexArray faces = buffer.getFaceIndices();
+        lvr2::indexArray new_faces(new unsigned int[num_faces * 3]);
+        std::vector<uint32_t> origins(num_faces);
+        const size_t num_new_faces = num_faces > 0
+                ? kernels::remapFaces(faces.get(), num_faces, remap.data(), new_faces.get(), origins.data())
+                : 0;
+
+        lvr2::indexArray face_materials = buffer.getFaceMaterialIndices();
+        lvr2::floatArr face_normals = buffer.hasFaceNormals() ? buffer.getFaceNormals() : lvr2::floatArr();
+        size_t face_color_width = 0;
+        lvr2::ucharArr face_colors = buffer.hasFaceColors() ? buffer.getFaceColors(face_color_width) : lvr2::ucharArr();
+        lvr2::indexArray new_face_materials(face_materials ? new unsigned int[num_new_faces] : nullptr);
+        lvr2::floatArr new_face_normals(face_normals ? new float[num_new_faces * 3] : nullptr);
+        lvr2::ucharArr new_face_colors(face_colors ? new uint8_t[num_new_faces * face_color_width] : nullptr);
+
+        #pragma omp parallel for schedule(static)
+        for (size_t f = 0; f < num_new_faces; f++) {
+            const size_t origin = origins[f];
+            if (face_materials) {
+                new_face_materials[f] = face_materials[origin];
             }
+            if (face_normals) {
+                std::copy(face_normals.get() + origin * 3, face_normals.get() + origin * 3 + 3,
+                          new_face_normals.get() + f * 3);
+            }
+            if (face_colors) {
+                std::copy(face_colors.get() + origin * face_color_width,
+                          face_colors.get() + (origin + 1) * face_color_width,
+                          new_face_colors.get() + f * face_color_width);
+            }
+        }
+
+        buffer.setVertices(new_vertices, num_welded);
+        if (new_normals) {
+            buffer.setVertexNormals(new_normals);
+        }
+        if (new_colors) {
+            buffer.setVertexColors(new_colors, color_width);
         }
-        //Error
-        lvr2::floatArr new_Vert(new float(new_vertexBuffer.size()));
-        for (int i = 0; i < new_vertexBuffer.size(); i++) {
-            new_Vert[i] = new_vertexBuffer[i];
+        if (new_tex_coords) {
+            buffer.setTextureCoordinates(new_tex_coords);
         }
-        lvr2::indexArray new_Ind(new unsigned int(new_indexBuffer.size()));
-        for (int i = 0; i < new_vertexBuffer.size(); i++) {
-            new_Ind[i] = new_indexBuffer[i];
+        buffer.setFaceIndices(new_faces, num_new_faces);
+        if (new_face_materials) {
+            buffer.setFaceMaterialIndices(new_face_materials);
         }
+        if (new_face_normals) {
+            buffer.setFaceNormals(new_face_normals);
+        }
+        if (new_face_colors) {
+            buffer.setFaceColors(new_face_colors, face_color_width);
+        }
+        return num_vertices - num_welded;
+    }
 
+    size_t weldVertices(mesh_msgs::MeshGeometry &mesh_geometry, float epsilon) {
+        const size_t num_vertices = mesh_geometry.vertices.size();
+        if (num_vertices == 0) {
+            return 0;
+        }
 
-        buffer.setVertices(new_Vert, new_vertexBuffer.size());
-        buffer.setFaceIndices(new_Ind, new_indexBuffer.size());
-    }
+        // the spatial hash works on float positions, the welded vertices keep their double positions
+        std::vector<float> positions(num_vertices * 3);
+        kernels::doubleToFloat(&mesh_geometry.vertices[0].x, positions.data(), num_vertices * 3);
+        std::vector<uint32_t> remap(num_vertices);
+        const size_t num_welded = kernels::weldVertices(positions.data(), num_vertices, epsilon, remap.data());
+        if (num_welded == num_vertices) {
+            return 0;
+        }
 
+        const bool has_normals = mesh_geometry.vertex_normals.size() == num_vertices;
+        std::vector<geometry_msgs::Point> vertices(num_welded);
+        std::vector<geometry_msgs::Point> normals(has_normals ? num_welded : 0);
+        std::vector<bool> assigned(num_welded, false);
+        for (size_t i = 0; i < num_vertices; i++) {
+            const size_t k = remap[i];
+            if (!assigned[k]) {
+                vertices[k] = mesh_geometry.vertices[i];
+                assigned[k] = true;
+            }
+            if (has_normals) {
+                normals[k].x += mesh_geometry.vertex_normals[i].x;
+                normals[k].y += mesh_geometry.vertex_normals[i].y;
+                normals[k].z += mesh_geometry.vertex_normals[i].z;
+            }
+        }
+        for (auto &normal: normals) {
+            const double length = std::sqrt(normal.x * normal.x + normal.y * normal.y + normal.z * normal.z);
+            if (length > 0) {
+                normal.x /= length;
+                normal.y /= length;
+                normal.z /= length;
+            }
+        }
 
-    void removeDuplicates(mesh_msgs::MeshGeometry &mesh) {
-        lvr2::MeshBuffer buffer;
-        fromTriangleMeshToMeshBuffer(mesh, buffer);
-        removeDuplicates(buffer);
+        std::vector<mesh_msgs::MeshTriangleIndices> faces(mesh_geometry.faces.size());
+        const size_t num_faces = faces.empty() ? 0 : kernels::remapFaces(
+                mesh_geometry.faces[0].vertex_indices.data(), faces.size(), remap.data(),
+                faces[0].vertex_indices.data(), nullptr);
+        faces.resize(num_faces);
 
-        lvr2::MeshBufferPtr buffer_ptr;
-        fromMeshBufferToTriangleMesh(buffer_ptr, mesh);
+        mesh_geometry.vertices.swap(vertices);
+        mesh_geometry.vertex_normals.swap(normals);
+        mesh_geometry.faces.swap(faces);
+        return num_vertices - num_welded;
     }
 
     /*
@@ -584,171 +646,231 @@ namespace lvr_ros {
     }
      */
 
-    void intensityToVertexRainbowColors(
+    void intensityToVertexColors(
             const std::vector<float> &intensity,
             mesh_msgs::MeshVertexColors &mesh,
+            ColorMap color_map,
             float min,
             float max
     ) {
-        float range = max - min;
-
-        float r, g, b;
-        float a = 1;
+        mesh.vertex_colors.resize(intensity.size());
+        getColorMapColors(intensity.data(), intensity.size(), color_map, min, max, mesh.vertex_colors.data());
+    }
 
-        for (size_t i = 0; i < intensity.size(); i++) {
-            float norm = (intensity[i] - min) / range;
-            getRainbowColor(norm, r, g, b);
-            std_msgs::ColorRGBA color;
-            color.a = a;
-            color.r = r;
-            color.g = g;
-            color.b = b;
-            mesh.vertex_colors.push_back(color);
-        }
+    void intensityToVertexColors(
+            const std::vector<float> &intensity,
+            mesh_msgs::MeshVertexColors &mesh,
+            ColorMap color_map
+    ) {
+        float min = 0, max = 0;
+        kernels::minMax(intensity.data(), intensity.size(), min, max);
+        intensityToVertexColors(intensity, mesh, color_map, min, max);
     }
 
-    /*
     void intensityToVertexRainbowColors(
-        const lvr2::DenseVertexMap<float>& intensity,
-        mesh_msgs::MeshVertexColors& mesh,
-        float min,
-        float max
-    )
-    {
-        float range = max - min;
-
-        float r, g, b;
-        float a = 1;
-
-        for (auto intensity_val: intensity)
-        {
-            float norm = (intensity[intensity_val] - min) / range;
-            getRainbowColor(norm, r, g, b);
-            std_msgs::ColorRGBA color;
-            color.a = a;
-            color.r = r;
-            color.g = g;
-            color.b = b;
-            mesh.triangle_colors.push_back(color);
-        }
+            const std::vector<float> &intensity,
+            mesh_msgs::MeshVertexColors &mesh,
+            float min,
+            float max
+    ) {
+        intensityToVertexColors(intensity, mesh, ColorMap::RAINBOW, min, max);
     }
-    */
+
     void intensityToVertexRainbowColors(const std::vector<float> &intensity, mesh_msgs::MeshVertexColors &mesh) {
-        float min = std::numeric_limits<float>::max();
-        float max = std::numeric_limits<float>::min();
+        intensityToVertexColors(intensity, mesh, ColorMap::RAINBOW);
+    }
 
-        for (size_t i = 0; i < intensity.size(); i++) {
-            if (!std::isfinite(intensity[i])) continue;
-            if (min > intensity[i]) min = intensity[i];
-            if (max < intensity[i]) max = intensity[i];
+    static std::vector<float> denseVertexMapValues(const lvr2::DenseVertexMap<float> &map) {
+        std::vector<float> values;
+        values.reserve(map.numValues());
+        for (auto vH: map) {
+            values.push_back(map[vH]);
         }
-        intensityToVertexRainbowColors(intensity, mesh, min, max);
+        return values;
     }
 
-    static inline bool hasCloudChannel(const sensor_msgs::PointCloud2 &cloud, const std::string &field_name) {
-        // Get the index we need
-        for (size_t d = 0; d < cloud.fields.size(); ++d)
-            if (cloud.fields[d].name == field_name)
-                return true;
-        return false;
+    void intensityToVertexRainbowColors(
+            const lvr2::DenseVertexMap<float> &intensity,
+            mesh_msgs::MeshVertexColors &mesh,
+            float min,
+            float max
+    ) {
+        intensityToVertexColors(denseVertexMapValues(intensity), mesh, ColorMap::RAINBOW, min, max);
     }
 
-    bool fromPointCloud2ToPointBuffer(const sensor_msgs::PointCloud2 &cloud, lvr2::PointBuffer &buffer) {
-        size_t size = cloud.height * cloud.width;
-
-        typedef sensor_msgs::PointCloud2ConstIterator<float> CloudIterFloat;
-        typedef sensor_msgs::PointCloud2ConstIterator <uint8_t> CloudIterUInt8;
-
+    void intensityToVertexRainbowColors(
+            const lvr2::DenseVertexMap<float> &intensity,
+            mesh_msgs::MeshVertexColors &mesh
+    ) {
+        intensityToVertexColors(denseVertexMapValues(intensity), mesh, ColorMap::RAINBOW);
+    }
 
-        lvr2::floatArr pointData(new float[size * 3]);
+    /**
+     * Whether bytes bytes at the offset of a field lie within a point of the cloud
+     */
+    static bool fieldFits(const sensor_msgs::PointCloud2 &cloud, const sensor_msgs::PointField &field, size_t bytes) {
+        return static_cast<size_t>(field.offset) + bytes <= cloud.point_step;
+    }
 
-        // copy point data
-        CloudIterFloat iter_x(cloud, "x");
-        CloudIterFloat iter_y(cloud, "y");
-        CloudIterFloat iter_z(cloud, "z");
+    /**
+     * Resolves the offsets of all fields fromPointCloud2ToPointBuffer reads in one pass over the
+     * field descriptions. Returns false if the cloud has no FLOAT32 x, y and z fields within its
+     * point step, optional fields which do not fit into the point step are ignored.
+     */
+    static bool planCloudGather(const sensor_msgs::PointCloud2 &cloud, kernels::CloudGatherLayout &layout) {
+        const sensor_msgs::PointField *xyz[3] = {nullptr, nullptr, nullptr};
+        const sensor_msgs::PointField *normal[3] = {nullptr, nullptr, nullptr};
+        const sensor_msgs::PointField *rgb = nullptr;
+        const sensor_msgs::PointField *intensity = nullptr;
+
+        for (const auto &field: cloud.fields) {
+            if (field.name == "x") xyz[0] = &field;
+            else if (field.name == "y") xyz[1] = &field;
+            else if (field.name == "z") xyz[2] = &field;
+            else if (field.name == "normal_x") normal[0] = &field;
+            else if (field.name == "normal_y") normal[1] = &field;
+            else if (field.name == "normal_z") normal[2] = &field;
+            else if (field.name == "rgb" || field.name == "rgba") rgb = &field;
+            else if (field.name == "intensities" || (field.name == "intensity" && !intensity)) intensity = &field;
+        }
 
-        //iterate over the pointcloud2
-        int index, i;
-        for (i = 0, index = 0;
-             iter_x != iter_x.end();
-             ++iter_x, ++iter_y, ++iter_z,
-                     index++) {
+        for (int k = 0; k < 3; k++) {
+            if (!xyz[k] || xyz[k]->datatype != sensor_msgs::PointField::FLOAT32) {
+                ROS_ERROR_STREAM("The point cloud needs FLOAT32 fields x, y and z!");
+                return false;
+            }
+            if (!fieldFits(cloud, *xyz[k], sizeof(float))) {
+                ROS_ERROR_STREAM("The field \"" << xyz[k]->name << "\" at offset " << xyz[k]->offset
+                                                 << " exceeds the point step of " << cloud.point_step << "!");
+                return false;
+            }
+            layout.xyz[k] = xyz[k]->offset;
+        }
 
-            // copy point
-            pointData[i] = *iter_x;
-            pointData[i + 1] = *iter_y;
-            pointData[i + 2] = *iter_z;
+        bool normals_valid = true;
+        for (int k = 0; k < 3; k++) {
+            normals_valid = normals_valid && normal[k] && normal[k]->datatype == sensor_msgs::PointField::FLOAT32;
+        }
+        if (normals_valid && !(fieldFits(cloud, *normal[0], sizeof(float))
+                               && fieldFits(cloud, *normal[1], sizeof(float))
+                               && fieldFits(cloud, *normal[2], sizeof(float)))) {
+            ROS_WARN_STREAM("The normal fields exceed the point step of " << cloud.point_step << ", ignore normals!");
+            normals_valid = false;
+        }
+        for (int k = 0; k < 3; k++) {
+            layout.normal[k] = normals_valid ? static_cast<int32_t>(normal[k]->offset) : -1;
+        }
 
-            i += 3;
+        // packed rgb(a) as FLOAT32 or UINT32, or at least three UINT8 values
+        layout.rgb = -1;
+        if (rgb) {
+            const bool packed = rgb->datatype == sensor_msgs::PointField::FLOAT32
+                                || rgb->datatype == sensor_msgs::PointField::UINT32;
+            if (packed || (rgb->datatype == sensor_msgs::PointField::UINT8 && rgb->count >= 3)) {
+                if (fieldFits(cloud, *rgb, packed ? 4 : 3)) {
+                    layout.rgb = rgb->offset;
+                } else {
+                    ROS_WARN_STREAM("The field \"" << rgb->name << "\" exceeds the point step of "
+                                                    << cloud.point_step << ", ignore colors!");
+                }
+            } else {
+                ROS_WARN_STREAM("Unsupported datatype of field \"" << rgb->name << "\", ignore colors!");
+            }
+        }
 
+        layout.intensity = -1;
+        if (intensity) {
+            if (intensity->datatype != sensor_msgs::PointField::FLOAT32) {
+                ROS_WARN_STREAM("Unsupported datatype of field \"" << intensity->name << "\", ignore intensities!");
+            } else if (!fieldFits(cloud, *intensity, sizeof(float))) {
+                ROS_WARN_STREAM("The field \"" << intensity->name << "\" exceeds the point step of "
+                                                << cloud.point_step << ", ignore intensities!");
+            } else {
+                layout.intensity = intensity->offset;
+            }
         }
-        buffer.setPointArray(pointData, size);
 
-        // copy point normals if available
-        bool normalsAvailable =
-                hasCloudChannel(cloud, "normal_x")
-                && hasCloudChannel(cloud, "normal_y")
-                && hasCloudChannel(cloud, "normal_z");
+        layout.width = cloud.width;
+        layout.height = cloud.height;
+        layout.point_step = cloud.point_step;
+        layout.row_step = cloud.row_step ? cloud.row_step : cloud.width * cloud.point_step;
+        return true;
+    }
 
-        if (normalsAvailable) {
-            CloudIterFloat iter_n_x(cloud, "normal_x");
-            CloudIterFloat iter_n_y(cloud, "normal_y");
-            CloudIterFloat iter_n_z(cloud, "normal_z");
-            lvr2::floatArr normalsData(new float[size * 3]);
-            int index, i;
+    bool fromPointCloud2ToPointBuffer(const sensor_msgs::PointCloud2 &cloud, lvr2::PointBuffer &buffer) {
+        lvr2::BoundingBox<Vec> bounding_box;
+        return fromPointCloud2ToPointBuffer(cloud, buffer, bounding_box);
+    }
 
-            //iterate over the pointcloud2
-            for (i = 0, index = 0;
-                 iter_n_x != iter_n_x.end();
-                 ++iter_n_x, ++iter_n_y, ++iter_n_z,
-                         index++) {
+    bool fromPointCloud2ToPointBuffer(
+            const sensor_msgs::PointCloud2 &cloud,
+            lvr2::PointBuffer &buffer,
+            lvr2::BoundingBox<Vec> &bounding_box,
+            bool drop_non_finite,
+            size_t *num_dropped) {
+        size_t size = cloud.height * cloud.width;
 
-                // copy normal
-                normalsData[i] = *iter_n_x;
-                normalsData[i + 1] = *iter_n_y;
-                normalsData[i + 2] = *iter_n_z;
+        kernels::CloudGatherLayout layout;
+        if (!planCloudGather(cloud, layout)) {
+            return false;
+        }
 
-                i += 3;
-            }
-            buffer.setNormalArray(normalsData, size);
+        if (size > 0 && cloud.data.size() < (cloud.height - 1) * layout.row_step + cloud.width * cloud.point_step) {
+            ROS_ERROR_STREAM("The point cloud data is smaller than its dimensions imply!");
+            return false;
         }
 
-        // copy color data if available
-        if (hasCloudChannel(cloud, "rgb")) {
-            CloudIterUInt8 iter_rgb(cloud, "rgb");
-            lvr2::ucharArr colorData(new uint8_t[size * 3]);
-            int index, i;
+        // count the finite points first, so that all channels are gathered compacted
+        kernels::CloudCompaction compaction;
+        size_t dropped = 0;
+        if (drop_non_finite) {
+            kernels::planCloudCompaction(cloud.data.data(), layout, compaction);
+            dropped = size - compaction.num_finite;
+            size = compaction.num_finite;
+        }
+        if (num_dropped) {
+            *num_dropped = dropped;
+        }
 
-            //iterate over the pointcloud2
-            for (i = 0, index = 0; iter_rgb != iter_rgb.end();
-                 ++iter_rgb, index++) {
+        lvr2::floatArr pointData(new float[size * 3]);
+        lvr2::floatArr normalsData;
+        lvr2::ucharArr colorData;
+        lvr2::floatArr intensityData;
+
+        kernels::CloudGatherOutput output;
+        output.points = pointData.get();
+        if (layout.normal[0] >= 0) {
+            normalsData = lvr2::floatArr(new float[size * 3]);
+            output.normals = normalsData.get();
+        }
+        if (layout.rgb >= 0) {
+            colorData = lvr2::ucharArr(new uint8_t[size * 3]);
+            output.colors = colorData.get();
+        }
+        if (layout.intensity >= 0) {
+            intensityData = lvr2::floatArr(new float[size]);
+            output.intensities = intensityData.get();
+        }
 
-                // copy color rgb
-                colorData[i] = iter_rgb[0];
-                colorData[i + 1] = iter_rgb[1];
-                colorData[i + 2] = iter_rgb[2];
+        // copy all channels and compute the bounding box in a single pass
+        kernels::gatherCloud(cloud.data.data(), layout, output, drop_non_finite ? &compaction : nullptr);
 
-                i += 3;
-            }
+        buffer.setPointArray(pointData, size);
+        if (normalsData) {
+            buffer.setNormalArray(normalsData, size);
+        }
+        if (colorData) {
             buffer.setColorArray(colorData, size);
         }
-
-        // copy intensity if available
-        if (hasCloudChannel(cloud, "intensities")) {
-            CloudIterFloat iter_int(cloud, "intensities");
-            lvr2::floatArr intensityData(new float[size]);
-            int index, i;
-
-            //iterate over the pointcloud2
-            for (i = 0, index = 0; iter_int != iter_int.end();
-                 ++iter_int, index++) {
-
-                // copy intensity
-                intensityData[i] = *iter_int;
-                i++;
-            }
+        if (intensityData) {
             buffer.addFloatChannel(intensityData, "intensity", size, 1);
         }
+
+        bounding_box = lvr2::BoundingBox<Vec>();
+        if (output.bb_min[0] <= output.bb_max[0]) {
+            bounding_box.expand(Vec(output.bb_min[0], output.bb_min[1], output.bb_min[2]));
+            bounding_box.expand(Vec(output.bb_max[0], output.bb_max[1], output.bb_max[2]));
+        }
         return true;
     }
 
@@ -757,38 +879,14 @@ namespace lvr_ros {
             const lvr2::MeshBufferPtr &buffer
     ) {
         // copy vertices
-        lvr2::floatArr vertices(new float[mesh_geometry.vertices.size() * 3]);
-        int i = 0;
-        for (auto vertex: mesh_geometry.vertices) {
-            vertices[i] = static_cast<float>(vertex.x);
-            vertices[i + 1] = static_cast<float>(vertex.y);
-            vertices[i + 2] = static_cast<float>(vertex.z);
-            i += 3;
-        }
-        buffer->setVertices(vertices, mesh_geometry.vertices.size());
+        buffer->setVertices(copyPointsToFloats(mesh_geometry.vertices), mesh_geometry.vertices.size());
 
         // copy faces
-        lvr2::indexArray faces(new unsigned int[mesh_geometry.faces.size() * 3]);
-        i = 0;
-        for (auto face: mesh_geometry.faces) {
-            faces[i] = face.vertex_indices[0];
-            faces[i + 1] = face.vertex_indices[1];
-            faces[i + 2] = face.vertex_indices[2];
-            i += 3;
-        }
-        buffer->setFaceIndices(faces, mesh_geometry.faces.size() * 3);
+        buffer->setFaceIndices(copyFacesToIndices(mesh_geometry.faces), mesh_geometry.faces.size());
 
         if (mesh_geometry.vertex_normals.size() == mesh_geometry.vertices.size()) {
             // copy normals
-            lvr2::floatArr normals(new float[mesh_geometry.vertex_normals.size() * 3]);
-            i = 0;
-            for (auto normal: mesh_geometry.vertex_normals) {
-                normals[i] = static_cast<float>(normal.x);
-                normals[i + 1] = static_cast<float>(normal.y);
-                normals[i + 2] = static_cast<float>(normal.z);
-                i += 3;
-            }
-            buffer->setVertexNormals(normals);
+            buffer->setVertexNormals(copyPointsToFloats(mesh_geometry.vertex_normals));
         } else {
             ROS_ERROR_STREAM("Number of normals (" << mesh_geometry.vertex_normals.size()
                                                    << ") must be equal to number of vertices ("
@@ -798,184 +896,281 @@ namespace lvr_ros {
         return true;
     }
 
-    void
-    PointBufferToPointCloud2(const lvr2::PointBufferPtr &buffer, std::string frame, sensor_msgs::PointCloud2Ptr &cloud) {
-        // the offset will be updated by addPointField
-        cloud->header.stamp = ros::Time::now();
-        cloud->header.frame_id = frame;
-
-        ros::Rate r(60);
-
-        int type;
-        std::map <std::string, lvr2::Channel<float>> floatChannels;
-        type = buffer->getAllChannelsOfType<float>(floatChannels);
-
-        size_t size = 0;
-        // xyz needs to be at the start.
-        int offset = 4 * sizeof(float);
-        // LVR mb needs a float64buffer especially for time information.
-        for (auto channelPair: floatChannels) {
-            // http://pointclouds.org/documentation/tutorials/adding_custom_ptype.php
-            // For the padding reasons.
-            if (channelPair.first == "points") {
-                size = channelPair.second.numElements();
-                int p_offset = 0;
-                p_offset = addPointField(*cloud, "x", 1, sensor_msgs::PointField::FLOAT32, p_offset);
-                p_offset = addPointField(*cloud, "y", 1, sensor_msgs::PointField::FLOAT32, p_offset);
-                p_offset = addPointField(*cloud, "z", 1, sensor_msgs::PointField::FLOAT32, p_offset);
-                p_offset += sizeof(float);
-                cloud->point_step = offset;
-            } else {
-                // type in lvr2 starts at 0, in ros at 1
-                offset = addPointField(*cloud, channelPair.first, channelPair.second.width(), type + 1, offset);
-                int padding = (sizeof(float) * 4) - ((channelPair.second.width() * sizeof(float)) % (4 * sizeof(float)));
-                offset += padding;
-                cloud->point_step = offset;
-            }
+    /**
+     * PointField datatype of a lvr2 channel type. The lvr2 channel types are ordered like the
+     * PointField datatypes, i.e. the type index returned by getAllChannelsOfType is datatype - 1.
+     */
+    template<typename T>
+    struct PointFieldDatatype;
+
+    template<> struct PointFieldDatatype<char> { static const uint8_t value = sensor_msgs::PointField::INT8; };
+    template<> struct PointFieldDatatype<unsigned char> { static const uint8_t value = sensor_msgs::PointField::UINT8; };
+    template<> struct PointFieldDatatype<short> { static const uint8_t value = sensor_msgs::PointField::INT16; };
+    template<> struct PointFieldDatatype<unsigned short> { static const uint8_t value = sensor_msgs::PointField::UINT16; };
+    template<> struct PointFieldDatatype<int> { static const uint8_t value = sensor_msgs::PointField::INT32; };
+    template<> struct PointFieldDatatype<unsigned int> { static const uint8_t value = sensor_msgs::PointField::UINT32; };
+    template<> struct PointFieldDatatype<float> { static const uint8_t value = sensor_msgs::PointField::FLOAT32; };
+    template<> struct PointFieldDatatype<double> { static const uint8_t value = sensor_msgs::PointField::FLOAT64; };
+
+    /**
+     * Calls visitor(T()) with the lvr2 channel type T of a PointField datatype.
+     * Returns false for unknown datatypes.
+     */
+    template<typename Visitor>
+    static bool visitPointFieldType(uint8_t datatype, Visitor &&visitor) {
+        switch (datatype) {
+            case sensor_msgs::PointField::INT8: visitor(char()); return true;
+            case sensor_msgs::PointField::UINT8: visitor((unsigned char) 0); return true;
+            case sensor_msgs::PointField::INT16: visitor(short()); return true;
+            case sensor_msgs::PointField::UINT16: visitor((unsigned short) 0); return true;
+            case sensor_msgs::PointField::INT32: visitor(int()); return true;
+            case sensor_msgs::PointField::UINT32: visitor((unsigned int) 0); return true;
+            case sensor_msgs::PointField::FLOAT32: visitor(float()); return true;
+            case sensor_msgs::PointField::FLOAT64: visitor(double()); return true;
+            default: return false;
         }
+    }
 
-        std::map <std::string, lvr2::Channel<unsigned char>> uCharChannels;
-        type = buffer->getAllChannelsOfType<unsigned char>(uCharChannels);
+    /**
+     * Bytes of a single value of a PointField datatype, 0 for unknown datatypes
+     */
+    static size_t pointFieldSize(uint8_t datatype) {
+        size_t value_size = 0;
+        visitPointFieldType(datatype, [&](auto tag) { value_size = sizeof(tag); });
+        return value_size;
+    }
 
-        for (auto channelPair: uCharChannels) {
-            offset = addPointField(*cloud, channelPair.first, channelPair.second.width(), type + 1, offset);
+    /**
+     * A channel of a PointBuffer written as PointField
+     */
+    struct ChannelField {
+        std::string name;
+        uint8_t datatype;
+        size_t count;
+        size_t value_size;  // bytes per value
+        size_t bytes;       // bytes per point
+        const uint8_t *data;
+        size_t offset;      // offset within the point
+    };
+
+    template<typename T>
+    static void collectChannelFields(lvr2::PointBuffer &buffer, size_t size, std::vector<ChannelField> &fields) {
+        std::map<std::string, lvr2::Channel<T>> channels;
+        buffer.getAllChannelsOfType<T>(channels);
+        for (auto &channel: channels) {
+            if (channel.first == "points") {
+                continue;
+            }
+            if (channel.second.numElements() != size) {
+                ROS_WARN_STREAM("Channel \"" << channel.first << "\" has " << channel.second.numElements()
+                                             << " instead of " << size << " elements, ignore it!");
+                continue;
+            }
+            const size_t width = channel.second.width();
+            fields.push_back({channel.first, PointFieldDatatype<T>::value, width, sizeof(T), width * sizeof(T),
+                              reinterpret_cast<const uint8_t *>(channel.second.dataPtr().get()), 0});
+        }
+    }
 
-            // Is this useful?!
-            int padding = (sizeof(float) * 4) - ((channelPair.second.width() * sizeof(float)) % (4 * sizeof(float)));
-            offset += padding;
-            cloud->point_step = offset;
+    /**
+     * Plans the PointCloud2 layout of the channels: xyz at the start, the channels ordered by
+     * decreasing value size behind it, so that a tight layout needs little to no padding.
+     * With align, every field starts at a multiple of its value size and the point step is a
+     * multiple of the largest value size. Returns the point step.
+     */
+    static size_t planPointFieldLayout(std::vector<ChannelField> &fields, bool align) {
+        std::stable_sort(fields.begin(), fields.end(), [](const ChannelField &a, const ChannelField &b) {
+            return a.value_size > b.value_size;
+        });
+
+        size_t offset = 3 * sizeof(float);
+        size_t max_value_size = sizeof(float);
+        for (auto &field: fields) {
+            if (align) {
+                offset = (offset + field.value_size - 1) / field.value_size * field.value_size;
+                max_value_size = std::max(max_value_size, field.value_size);
+            }
+            field.offset = offset;
+            offset += field.bytes;
         }
+        if (align) {
+            offset = (offset + max_value_size - 1) / max_value_size * max_value_size;
+        }
+        return offset;
+    }
 
-        // reserve size
-        sensor_msgs::PointCloud2Modifier mod(*cloud);
-        cloud->data.resize(size * cloud->point_step);
+    void
+    PointBufferToPointCloud2(
+            const lvr2::PointBufferPtr &buffer,
+            std::string frame,
+            sensor_msgs::PointCloud2Ptr &cloud,
+            bool align_fields) {
+        cloud->header.stamp = ros::Time::now();
+        cloud->header.frame_id = frame;
+        cloud->fields.clear();
+
+        const size_t size = buffer->numPoints();
+        lvr2::floatArr points = buffer->getPointArray();
+
+        // channels of all types, xyz is written from the point array
+        std::vector<ChannelField> fields;
+        collectChannelFields<float>(*buffer, size, fields);
+        collectChannelFields<unsigned char>(*buffer, size, fields);
+        collectChannelFields<double>(*buffer, size, fields);
+        collectChannelFields<char>(*buffer, size, fields);
+        collectChannelFields<short>(*buffer, size, fields);
+        collectChannelFields<unsigned short>(*buffer, size, fields);
+        collectChannelFields<int>(*buffer, size, fields);
+        collectChannelFields<unsigned int>(*buffer, size, fields);
+
+        cloud->point_step = planPointFieldLayout(fields, align_fields);
+        addPointField(*cloud, "x", 1, sensor_msgs::PointField::FLOAT32, 0);
+        addPointField(*cloud, "y", 1, sensor_msgs::PointField::FLOAT32, sizeof(float));
+        addPointField(*cloud, "z", 1, sensor_msgs::PointField::FLOAT32, 2 * sizeof(float));
+        for (const auto &field: fields) {
+            addPointField(*cloud, field.name, field.count, field.datatype, field.offset);
+        }
 
         cloud->height = 1;
         cloud->width = size;
+        cloud->row_step = size * cloud->point_step;
+        cloud->is_dense = false;
+        cloud->data.resize(size * cloud->point_step);
 
+        // fill the points block by block from all channels
+        std::vector<kernels::InterleaveField> interleave_fields;
+        interleave_fields.reserve(fields.size() + 1);
+        if (points) {
+            kernels::InterleaveField xyz;
+            xyz.src = reinterpret_cast<const uint8_t *>(points.get());
+            xyz.bytes = 3 * sizeof(float);
+            xyz.offset = 0;
+            interleave_fields.push_back(xyz);
+        }
+        for (const auto &field: fields) {
+            kernels::InterleaveField interleave_field;
+            interleave_field.src = field.data;
+            interleave_field.bytes = field.bytes;
+            interleave_field.offset = field.offset;
+            interleave_fields.push_back(interleave_field);
+        }
+        kernels::interleave(interleave_fields.data(), interleave_fields.size(), cloud->data.data(),
+                            cloud->point_step, size);
+    }
 
-        ROS_INFO("Starting conversion.");
-        for (auto field: cloud->fields) {
-            // Points is a special case...
-            if (field.name == "x" || field.name == "y" || field.name == "z") {
-                auto channel = floatChannels.at("points");
-                //auto iter_x  = floatIters.at("x");
-                //auto iter_y  = floatIters.at("y");
-                //auto iter_z  = floatIters.at("z");
-    #pragma omp parallel for
-                for (size_t i = 0; i < size; ++i) {
-                    unsigned char *ptr = &(cloud->data[cloud->point_step * i]);
-                    *(reinterpret_cast<float *>(ptr)) = channel[i][0];
-                    *((reinterpret_cast<float *>(ptr)) + 1) = channel[i][1];
-                    *((reinterpret_cast<float *>(ptr)) + 2) = channel[i][2];
-                    //*iter_x = channel[i][0];
-                    //*iter_y = channel[i][1];
-                    //*iter_z = channel[i][2];
-                }
+    /**
+     * Copies one field of all points of a cloud to a dense array, row by row if the rows are padded.
+     */
+    static void copyFieldToArray(const sensor_msgs::PointCloud2 &cloud, size_t offset, size_t bytes,
+                                 size_t dst_step, uint8_t *dst) {
+        const size_t row_step = cloud.row_step ? cloud.row_step : cloud.width * cloud.point_step;
+        if (row_step == cloud.width * cloud.point_step) {
+            kernels::copyStrided(cloud.data.data() + offset, cloud.point_step, dst, dst_step, bytes,
+                                 cloud.width * cloud.height);
+            return;
+        }
+        for (size_t row = 0; row < cloud.height; row++) {
+            kernels::copyStrided(cloud.data.data() + row * row_step + offset, cloud.point_step,
+                                 dst + row * cloud.width * dst_step, dst_step, bytes, cloud.width);
+        }
+    }
 
-            } else {
-                if (field.datatype == sensor_msgs::PointField::FLOAT32) {
-                    auto channel = floatChannels.at(field.name);
-                    //auto iter = floatIters.at(field.name);
-    #pragma omp parallel for
-                    for (size_t i = 0; i < size; ++i) {
-                        unsigned char *ptr = &(cloud->data[cloud->point_step * i]) + field.offset;
-                        for (size_t j = 0; j < field.count; ++j) {
-                            *((reinterpret_cast<float *>(ptr)) + j) = channel[i][j];
-                            //iter[j]  = channel[i][j];
-                        }
-                    }
-                } else if (field.datatype == sensor_msgs::PointField::FLOAT32) {
-                    auto channel = uCharChannels.at(field.name);
-                    //auto iter = uCharIters.at(field.name);
-    #pragma omp parallel for
-                    for (size_t i = 0; i < size; ++i) {
-                        unsigned char *ptr = &(cloud->data[cloud->point_step * i]) + field.offset;
-                        for (size_t j = 0; j < field.count; ++j) {
-                            //iter[j] = channel[i][j];
-                            *(ptr + j) = channel[i][j];
-                        }
-                    }
-                }
+    /**
+     * Converts one numeric field of all points of a cloud to every third float of a point array.
+     */
+    static bool copyFieldToPointArray(const sensor_msgs::PointCloud2 &cloud, const sensor_msgs::PointField &field,
+                                      size_t size, float *dst) {
+        return visitPointFieldType(field.datatype, [&](auto tag) {
+            typedef decltype(tag) T;
+            std::vector<T> values(size);
+            copyFieldToArray(cloud, field.offset, sizeof(T), sizeof(T), reinterpret_cast<uint8_t *>(values.data()));
+            for (size_t i = 0; i < size; i++) {
+                dst[i * 3] = static_cast<float>(values[i]);
             }
-        }
-        ROS_INFO("DONE");
+        });
     }
 
-    void PointCloud2ToPointBuffer(const sensor_msgs::PointCloud2Ptr &cloud, lvr2::PointBufferPtr &buffer) {
+    bool PointCloud2ToPointBuffer(const sensor_msgs::PointCloud2Ptr &cloud, lvr2::PointBufferPtr &buffer) {
         buffer = lvr2::PointBufferPtr(new lvr2::PointBuffer());
 
-        for (auto field: cloud->fields) {
-            std::cout << field.name << std::endl;
-            if (field.datatype == sensor_msgs::PointField::FLOAT32) {
-                if (field.name == "x" || field.name == "y" || field.name == "z") {
-                    if (!buffer->hasFloatChannel("points")) {
-                        buffer->addEmptyChannel<float>("points", cloud->width * cloud->height, 3);
-                        std::cout << cloud->width * cloud->height << std::endl;
-                    }
-                } else {
-                    std::cout << "Add channel " << field.name << " with size " << cloud->width * cloud->height << std::endl;
-                    buffer->addEmptyChannel<float>(field.name, cloud->width * cloud->height, field.count);
-                }
-
-            }
+        const size_t size = cloud->width * cloud->height;
+        const size_t row_step = cloud->row_step ? cloud->row_step : cloud->width * cloud->point_step;
+        if (size > 0 && cloud->data.size() < (cloud->height - 1) * row_step + cloud->width * cloud->point_step) {
+            ROS_ERROR_STREAM("The point cloud data is smaller than its dimensions imply!");
+            return false;
         }
 
-        for (auto field: cloud->fields) {
+        const sensor_msgs::PointField *xyz[3] = {nullptr, nullptr, nullptr};
+        for (const auto &field: cloud->fields) {
             // Points is a special case...
-            if (field.name == "x" || field.name == "y" || field.name == "z") {
-                auto channel = buffer->getChannel<float>("points");
-                if (channel) {
-                    std::cout << "already init" << std::endl;
-                    continue;
-                }
+            if (field.name == "x") xyz[0] = &field;
+            else if (field.name == "y") xyz[1] = &field;
+            else if (field.name == "z") xyz[2] = &field;
+        }
 
-                lvr2::floatArr points(new float[cloud->width * cloud->height * 3]);
-                buffer->setPointArray(points, cloud->width * cloud->height);
-                channel = buffer->getChannel<float>("points");
+        if (!xyz[0] || !xyz[1] || !xyz[2] || !xyz[0]->count || !xyz[1]->count || !xyz[2]->count) {
+            ROS_ERROR_STREAM("The point cloud needs the fields x, y and z!");
+            return false;
+        }
+        for (int k = 0; k < 3; k++) {
+            const size_t value_size = pointFieldSize(xyz[k]->datatype);
+            if (value_size == 0) {
+                ROS_ERROR_STREAM("Unknown datatype " << (int) xyz[k]->datatype << " of field \""
+                                                     << xyz[k]->name << "\"!");
+                return false;
+            }
+            if (!fieldFits(*cloud, *xyz[k], value_size)) {
+                ROS_ERROR_STREAM("The field \"" << xyz[k]->name << "\" at offset " << xyz[k]->offset
+                                                 << " exceeds the point step of " << cloud->point_step << "!");
+                return false;
+            }
+        }
 
-    #pragma omp parallel for
-                for (size_t i = 0; i < (cloud->width * cloud->height); ++i) {
-                    unsigned char *ptr = &(cloud->data[cloud->point_step * i]);
-                    (*channel)[i][0] = *(reinterpret_cast<float *>(ptr));
-                    (*channel)[i][1] = *((reinterpret_cast<float *>(ptr)) + 1);
-                    (*channel)[i][2] = *((reinterpret_cast<float *>(ptr)) + 2);
-                }
+        lvr2::floatArr points(new float[size * 3]);
+        uint8_t *dst = reinterpret_cast<uint8_t *>(points.get());
+        const bool all_float = xyz[0]->datatype == sensor_msgs::PointField::FLOAT32
+                               && xyz[1]->datatype == sensor_msgs::PointField::FLOAT32
+                               && xyz[2]->datatype == sensor_msgs::PointField::FLOAT32;
+        if (all_float && xyz[1]->offset == xyz[0]->offset + 4 && xyz[2]->offset == xyz[0]->offset + 8) {
+            copyFieldToArray(*cloud, xyz[0]->offset, 3 * sizeof(float), 3 * sizeof(float), dst);
+        } else if (all_float) {
+            for (int k = 0; k < 3; k++) {
+                copyFieldToArray(*cloud, xyz[k]->offset, sizeof(float), 3 * sizeof(float), dst + k * sizeof(float));
+            }
+        } else {
+            // other numeric coordinates, e.g. FLOAT64 or scaled integers, are converted to float
+            for (int k = 0; k < 3; k++) {
+                copyFieldToPointArray(*cloud, *xyz[k], size, points.get() + k);
+            }
+        }
+        buffer->setPointArray(points, size);
 
-            } else {
-                if (field.datatype == sensor_msgs::PointField::FLOAT32) {
-                    auto channel = buffer->getChannel<float>(field.name);
-
-                    if (!channel) {
-                        ROS_INFO("Channel %s missing", field.name.c_str());
-                        continue;
-                    }
-
-    #pragma omp parallel for
-                    for (size_t i = 0; i < (cloud->width * cloud->height); ++i) {
-                        unsigned char *ptr = &(cloud->data[cloud->point_step * i]) + field.offset;
-                        for (size_t j = 0; j < field.count; ++j) {
-                            (*channel)[i][j] = *((reinterpret_cast<float *>(ptr)) + j);
-                        }
-                    }
-                } else if (field.datatype == sensor_msgs::PointField::UINT8) {
-                    auto channel = buffer->getChannel<unsigned char>(field.name);
-
-                    if (!channel) {
-                        ROS_INFO("Channel %s missing", field.name.c_str());
-                        continue;
-                    }
-
-    #pragma omp parallel for
-                    for (size_t i = 0; i < (cloud->width * cloud->height); ++i) {
-                        unsigned char *ptr = &(cloud->data[cloud->point_step * i]) + field.offset;
-                        for (size_t j = 0; j < field.count; ++j) {
-                            (*channel)[i][j] = *(ptr + j);
-                        }
-                    }
-                }
+        for (const auto &field: cloud->fields) {
+            if (field.name == "x" || field.name == "y" || field.name == "z" || field.count == 0) {
+                continue;
             }
+            const size_t value_size = pointFieldSize(field.datatype);
+            if (value_size == 0) {
+                ROS_WARN_STREAM("Unknown datatype " << (int) field.datatype << " of field \""
+                                                    << field.name << "\", ignore it!");
+                continue;
+            }
+            if (!fieldFits(*cloud, field, field.count * value_size)) {
+                ROS_WARN_STREAM("The field \"" << field.name << "\" exceeds the point step of "
+                                                << cloud->point_step << ", ignore it!");
+                continue;
+            }
+
+            // every field is written into a channel of the matching type
+            visitPointFieldType(field.datatype, [&](auto tag) {
+                typedef decltype(tag) T;
+                boost::shared_array<T> data(new T[size * field.count]);
+                copyFieldToArray(*cloud, field.offset, field.count * sizeof(T), field.count * sizeof(T),
+                                 reinterpret_cast<uint8_t *>(data.get()));
+                buffer->addChannel<T>(data, field.name, size, field.count);
+            });
         }
+        return true;
     }
 
 } // end namespace
@@ -0,0 +1,460 @@
+/*
+ * UOS-ROS packages - Robot Operating System code by the University of Osnabrück
+ * Copyright (C) 2013 University of Osnabrück
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * hdf5_to_msg.cpp
+ *
+ */
+
+#include "lvr_ros/hdf5_to_msg.h"
+#include "lvr_ros/conversions.h"
+#include "lvr_ros/hdf5_utils.h"
+#include "lvr_ros/serialization.h"
+
+#include <algorithm>
+#include <set>
+
+#include <mesh_msgs/MeshGeometryStamped.h>
+#include <sensor_msgs/PointCloud2.h>
+
+namespace lvr_ros
+{
+
+namespace
+{
+
+// A dataset with one row per point, published as a field of the cloud
+struct Channel
+{
+    std::string name;
+    hid_t dataset;
+    hsize_t width;
+};
+
+std::string parentGroup(const std::string& path)
+{
+    const size_t slash = path.rfind('/');
+    return slash == std::string::npos || slash == 0 ? "/" : path.substr(0, slash);
+}
+
+std::string baseName(const std::string& path)
+{
+    const size_t slash = path.rfind('/');
+    return slash == std::string::npos ? path : path.substr(slash + 1);
+}
+
+herr_t collectLink(hid_t, const char* name, const H5L_info_t*, void* data)
+{
+    static_cast<std::set<std::string>*>(data)->insert(std::string("/") + name);
+    return 0;
+}
+
+herr_t collectDataset(hid_t group, const char* name, const H5L_info_t*, void* data)
+{
+    H5O_info_t info;
+    if (H5Oget_info_by_name(group, name, &info, H5P_DEFAULT) >= 0 && info.type == H5O_TYPE_DATASET)
+    {
+        static_cast<std::vector<std::string>*>(data)->push_back(name);
+    }
+    return 0;
+}
+
+/**
+ * Reads the first rows of a dataset in chunks of chunk_size rows
+ */
+template<typename T>
+bool readChunked(hid_t dataset, hsize_t rows, hsize_t width, size_t chunk_size, T* dst)
+{
+    for (hsize_t first = 0; first < rows; first += chunk_size)
+    {
+        const hsize_t count = std::min<hsize_t>(chunk_size, rows - first);
+        if (!hdf5::readRows(dataset, first, count, width, dst + first * width))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Opens a dataset of the given width
+ * @param rows the number of rows of the dataset
+ * @return the dataset, negative if it does not exist or has another width
+ */
+hid_t openRows(hid_t group, const std::string& name, hsize_t width, hsize_t& rows)
+{
+    if (!hdf5::linkExists(group, name))
+    {
+        return -1;
+    }
+    hid_t dataset = H5Dopen2(group, name.c_str(), H5P_DEFAULT);
+    if (dataset < 0)
+    {
+        return -1;
+    }
+    const std::vector<hsize_t> dims = hdf5::datasetDims(dataset);
+    if (dims.size() != 2 || dims[1] != width)
+    {
+        H5Dclose(dataset);
+        return -1;
+    }
+    rows = dims[0];
+    return dataset;
+}
+
+} // namespace
+
+Hdf5ToMsg::Hdf5ToMsg()
+    : file(-1)
+{
+    ros::NodeHandle nh("~");
+
+    int chunk;
+    nh.param("inputFile", input_file, std::string());
+    nh.param("rate", rate, 1.0);
+    nh.param("chunkSize", chunk, 1000000);
+    nh.param("frameId", frame_id, std::string("map"));
+    nh.param("loop", loop, false);
+    nh.param("waitForSubscribers", wait_for_subscribers, true);
+    nh.param("acknowledge", acknowledge, true);
+    std::string action_name;
+    nh.param("reconstructionAction", action_name, std::string("reconstruction"));
+    chunk_size = static_cast<size_t>(std::max(1, chunk));
+
+    // The clouds are sent to the reconstruction action, which acknowledges every chunk with its
+    // result, or published to the input topic of the reconstruction
+    if (acknowledge)
+    {
+        reconstruction_client.reset(new ReconstructionClient(node_handle, action_name, true));
+    }
+    else
+    {
+        cloud_publisher = node_handle.advertise<sensor_msgs::PointCloud2>("pointcloud", 1);
+    }
+    mesh_publisher = nh.advertise<mesh_msgs::MeshGeometryStamped>("mesh_geometry", 1);
+
+    // missing optional datasets are expected, report the errors ourselves
+    H5Eset_auto2(H5E_DEFAULT, nullptr, nullptr);
+}
+
+Hdf5ToMsg::~Hdf5ToMsg()
+{
+    if (file >= 0)
+    {
+        H5Fclose(file);
+    }
+}
+
+bool Hdf5ToMsg::run()
+{
+    if (input_file.empty())
+    {
+        ROS_ERROR_STREAM("No input file given, set the parameter \"inputFile\"!");
+        return false;
+    }
+    file = H5Fopen(input_file.c_str(), H5F_ACC_RDONLY, H5P_DEFAULT);
+    if (file < 0)
+    {
+        ROS_ERROR_STREAM("Could not open the HDF5 file " << input_file << "!");
+        return false;
+    }
+    if (!findSources())
+    {
+        ROS_ERROR_STREAM("Could not find any point cloud or mesh in " << input_file << "!");
+        return false;
+    }
+    ROS_INFO_STREAM("Found " << cloud_groups.size() << " point clouds and " << mesh_groups.size()
+        << " meshes in " << input_file << ".");
+
+    if (wait_for_subscribers)
+    {
+        ROS_INFO_STREAM("Waiting for subscribers...");
+        while (ros::ok() && mesh_publisher.getNumSubscribers() == 0
+            && (acknowledge ? !reconstruction_client->isServerConnected() : cloud_publisher.getNumSubscribers() == 0))
+        {
+            ros::Duration(0.1).sleep();
+        }
+    }
+
+    do
+    {
+        for (const auto& group : cloud_groups)
+        {
+            if (!ros::ok() || !publishCloud(group))
+            {
+                return !ros::ok();
+            }
+        }
+        for (const auto& group : mesh_groups)
+        {
+            if (!ros::ok() || !publishMesh(group))
+            {
+                return !ros::ok();
+            }
+        }
+    } while (loop && ros::ok());
+
+    return true;
+}
+
+bool Hdf5ToMsg::findSources()
+{
+    std::set<std::string> links;
+    if (H5Lvisit(file, H5_INDEX_NAME, H5_ITER_INC, collectLink, &links) < 0)
+    {
+        return false;
+    }
+
+    for (const auto& link : links)
+    {
+        const std::string name = baseName(link);
+        const std::string group = parentGroup(link);
+        if (name == "points")
+        {
+            cloud_groups.push_back(group);
+        }
+        else if (name == "vertices"
+            && (links.count(group + "/faces") || links.count(group + "/face_indices")))
+        {
+            mesh_groups.push_back(group);
+        }
+    }
+    return !cloud_groups.empty() || !mesh_groups.empty();
+}
+
+bool Hdf5ToMsg::publishCloud(const std::string& group_name)
+{
+    hid_t group = H5Gopen2(file, group_name.c_str(), H5P_DEFAULT);
+    if (group < 0)
+    {
+        ROS_ERROR_STREAM("Could not open the group " << group_name << "!");
+        return false;
+    }
+
+    hsize_t num_points = 0;
+    hid_t points = openRows(group, "points", 3, num_points);
+    if (points < 0)
+    {
+        ROS_ERROR_STREAM("The points of " << group_name << " are no N x 3 dataset!");
+        H5Gclose(group);
+        return false;
+    }
+
+    // every other dataset with one row per point is a channel
+    std::vector<std::string> names;
+    H5Literate(group, H5_INDEX_NAME, H5_ITER_INC, nullptr, collectDataset, &names);
+    std::vector<Channel> channels;
+    for (const auto& name : names)
+    {
+        if (name == "points")
+        {
+            continue;
+        }
+        hid_t dataset = H5Dopen2(group, name.c_str(), H5P_DEFAULT);
+        const std::vector<hsize_t> dims = hdf5::datasetDims(dataset);
+        if (dataset >= 0 && !dims.empty() && dims.size() <= 2 && dims[0] == num_points)
+        {
+            channels.push_back({name, dataset, dims.size() == 2 ? dims[1] : 1});
+        }
+        else if (dataset >= 0)
+        {
+            H5Dclose(dataset);
+        }
+    }
+
+    ROS_INFO_STREAM("Publishing the " << num_points << " points of " << group_name << " in chunks of "
+        << chunk_size << " points.");
+
+    ros::Rate publish_rate(rate);
+    bool success = true;
+    for (hsize_t first = 0; success && first < num_points && ros::ok(); first += chunk_size)
+    {
+        const hsize_t count = std::min<hsize_t>(chunk_size, num_points - first);
+
+        // only the points of the current chunk are held in memory
+        lvr2::PointBufferPtr buffer(new lvr2::PointBuffer);
+        lvr2::floatArr point_data(new float[count * 3]);
+        success = hdf5::readRows(points, first, count, 3, point_data.get());
+        buffer->setPointArray(point_data, count);
+
+        for (const auto& channel : channels)
+        {
+            bool read = false;
+            const bool supported = hdf5::visitNativeType(channel.dataset, [&](auto zero)
+            {
+                using T = decltype(zero);
+                boost::shared_array<T> data(new T[count * channel.width]);
+                read = hdf5::readRows(channel.dataset, first, count, channel.width, data.get());
+                if (read)
+                {
+                    buffer->addChannel<T>(data, channel.name, count, channel.width);
+                }
+            });
+            if (supported && !read)
+            {
+                ROS_ERROR_STREAM("Could not read the channel " << channel.name << " of " << group_name << "!");
+                success = false;
+            }
+        }
+        if (!success)
+        {
+            ROS_ERROR_STREAM("Could not read the points " << first << " to " << first + count << " of "
+                << group_name << "!");
+            break;
+        }
+
+        sensor_msgs::PointCloud2Ptr cloud(new sensor_msgs::PointCloud2);
+        PointBufferToPointCloud2(buffer, frame_id, cloud);
+        cloud->header.stamp = ros::Time::now();
+        if (!sendCloud(cloud))
+        {
+            break;
+        }
+        publish_rate.sleep();
+    }
+
+    for (const auto& channel : channels)
+    {
+        H5Dclose(channel.dataset);
+    }
+    H5Dclose(points);
+    H5Gclose(group);
+    return success;
+}
+
+bool Hdf5ToMsg::sendCloud(const sensor_msgs::PointCloud2Ptr& cloud)
+{
+    if (!acknowledge)
+    {
+        cloud_publisher.publish(cloud);
+        return true;
+    }
+
+    // a chunk is never dropped, wait for the reconstruction node if it is not running
+    while (ros::ok() && !reconstruction_client->waitForServer(ros::Duration(1.0)))
+    {
+        ROS_WARN_STREAM_THROTTLE(10.0, "Waiting for the reconstruction action server...");
+    }
+
+    lvr_ros::ReconstructGoal goal;
+    goal.cloud.header = cloud->header;
+    goal.cloud.height = cloud->height;
+    goal.cloud.width = cloud->width;
+    goal.cloud.fields = cloud->fields;
+    goal.cloud.is_bigendian = cloud->is_bigendian;
+    goal.cloud.point_step = cloud->point_step;
+    goal.cloud.row_step = cloud->row_step;
+    goal.cloud.is_dense = cloud->is_dense;
+    goal.cloud.data.swap(cloud->data);
+    reconstruction_client->sendGoal(goal);
+    reconstruction_client->waitForResult();
+    if (!ros::ok())
+    {
+        return false;
+    }
+
+    const actionlib::SimpleClientGoalState state = reconstruction_client->getState();
+    if (state != actionlib::SimpleClientGoalState::SUCCEEDED)
+    {
+        // e.g. a chunk with too few points, the following chunks are still sent
+        ROS_WARN_STREAM("The reconstruction of a chunk of " << goal.cloud.width * goal.cloud.height
+            << " points did not succeed: " << state.toString() << ".");
+        return true;
+    }
+    const lvr_ros::ReconstructResultConstPtr result = reconstruction_client->getResult();
+    ROS_INFO_STREAM("Reconstructed a chunk of " << goal.cloud.width * goal.cloud.height << " points as mesh "
+        << result->mesh.uuid << ".");
+    mesh_publisher.publish(result->mesh);
+    return true;
+}
+
+bool Hdf5ToMsg::publishMesh(const std::string& group_name)
+{
+    hid_t group = H5Gopen2(file, group_name.c_str(), H5P_DEFAULT);
+    if (group < 0)
+    {
+        ROS_ERROR_STREAM("Could not open the group " << group_name << "!");
+        return false;
+    }
+
+    hsize_t num_vertices = 0, num_faces = 0, num_normals = 0;
+    hid_t vertices = openRows(group, "vertices", 3, num_vertices);
+    hid_t faces = openRows(group, "faces", 3, num_faces);
+    if (faces < 0)
+    {
+        faces = openRows(group, "face_indices", 3, num_faces);
+    }
+    hid_t normals = openRows(group, "vertex_normals", 3, num_normals);
+
+    // the datasets are read chunk by chunk directly into the arrays of the MeshBuffer
+    bool success = vertices >= 0 && faces >= 0;
+    lvr2::MeshBufferPtr buffer(new lvr2::MeshBuffer);
+    if (success)
+    {
+        lvr2::floatArr vertex_data(new float[num_vertices * 3]);
+        lvr2::indexArray face_data(new unsigned int[num_faces * 3]);
+        success = readChunked(vertices, num_vertices, 3, chunk_size, vertex_data.get())
+            && readChunked(faces, num_faces, 3, chunk_size, face_data.get());
+        buffer->setVertices(vertex_data, num_vertices);
+        buffer->setFaceIndices(face_data, num_faces);
+    }
+    if (success && normals >= 0 && num_normals == num_vertices)
+    {
+        lvr2::floatArr normal_data(new float[num_vertices * 3]);
+        if (readChunked(normals, num_vertices, 3, chunk_size, normal_data.get()))
+        {
+            buffer->setVertexNormals(normal_data);
+        }
+    }
+
+    for (hid_t dataset : {vertices, faces, normals})
+    {
+        if (dataset >= 0)
+        {
+            H5Dclose(dataset);
+        }
+    }
+    H5Gclose(group);
+
+    if (!success)
+    {
+        ROS_ERROR_STREAM("Could not read the mesh " << group_name << "!");
+        return false;
+    }
+
+    ROS_INFO_STREAM("Publishing the mesh " << group_name << " with " << num_vertices << " vertices and "
+        << num_faces << " faces.");
+
+    MeshBufferGeometryStamped::Ptr mesh(new MeshBufferGeometryStamped);
+    mesh->header.frame_id = frame_id;
+    mesh->header.stamp = ros::Time::now();
+    mesh->uuid = baseName(group_name);
+    mesh->mesh_buffer = buffer;
+    mesh_publisher.publish(mesh);
+
+    ros::Rate(rate).sleep();
+    return true;
+}
+
+} // namespace lvr_ros
+
+int main(int argc, char** args)
+{
+    ros::init(argc, args, "hdf5_to_msg");
+    lvr_ros::Hdf5ToMsg hdf5_to_msg;
+    return hdf5_to_msg.run() ? 0 : 1;
+}
@@ -0,0 +1,1282 @@
+/*
+ * UOS-ROS packages - Robot Operating System code by the University of Osnabrück
+ * Copyright (C) 2013 University of Osnabrück
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * kernels.cpp
+ *
+ */
+
+#include "lvr_ros/kernels.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <vector>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#if defined(__x86_64__) || defined(__i386__)
+#define LVR_ROS_KERNELS_X86
+#include <immintrin.h>
+#endif
+
+namespace lvr_ros {
+namespace kernels {
+
+namespace {
+
+// Arrays below this number of values are converted by the calling thread only,
+// spawning the OpenMP team costs more than it saves.
+const size_t PARALLEL_THRESHOLD = 1 << 16;
+
+enum class Isa { SCALAR, SSE2, AVX };
+
+std::atomic<TraceHook> trace_hook(nullptr);
+thread_local void* trace_context = nullptr;
+
+/**
+ * Reports the share of the current thread in a parallel region to the trace hook, the context
+ * has to be read on the thread which starts the region
+ */
+class TraceRegion
+{
+public:
+    TraceRegion(void* context, const char* region)
+        : context(context),
+          region(region),
+          hook(context ? trace_hook.load(std::memory_order_relaxed) : nullptr)
+    {
+        if (hook)
+        {
+            hook(context, region, true);
+        }
+    }
+
+    ~TraceRegion()
+    {
+        if (hook)
+        {
+            hook(context, region, false);
+        }
+    }
+
+private:
+    void* context;
+    const char* region;
+    TraceHook hook;
+};
+
+Isa detectIsa()
+{
+#ifdef LVR_ROS_KERNELS_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx"))
+    {
+        return Isa::AVX;
+    }
+    if (__builtin_cpu_supports("sse2"))
+    {
+        return Isa::SSE2;
+    }
+#endif
+    return Isa::SCALAR;
+}
+
+Isa isa()
+{
+    static const Isa detected = detectIsa();
+    return detected;
+}
+
+/**
+ * Splits [0, n) into one contiguous chunk per OpenMP thread and calls kernel(begin, end)
+ * for each chunk. Small arrays and calls from inside a parallel region run serially.
+ * The region is named for the trace hook.
+ */
+template<typename Kernel>
+void forEachChunk(const char* region, size_t n, Kernel kernel)
+{
+    void* const context = trace_context;
+#ifdef _OPENMP
+    if (n >= PARALLEL_THRESHOLD && omp_get_max_threads() > 1 && !omp_in_parallel())
+    {
+        #pragma omp parallel
+        {
+            TraceRegion trace(context, region);
+            const size_t threads = omp_get_num_threads();
+            const size_t thread = omp_get_thread_num();
+            // chunks are a multiple of 16 values, so only the last chunk has a scalar tail
+            const size_t chunk = ((n + threads - 1) / threads + 15) & ~size_t(15);
+            const size_t begin = std::min(n, thread * chunk);
+            const size_t end = std::min(n, begin + chunk);
+            if (begin < end)
+            {
+                kernel(begin, end);
+            }
+        }
+        return;
+    }
+#endif
+    TraceRegion trace(context, region);
+    kernel(0, n);
+}
+
+/* float -> double */
+
+void floatToDoubleScalar(const float* src, uint8_t* dst, size_t n)
+{
+    for (size_t i = 0; i < n; i++)
+    {
+        const double value = src[i];
+        std::memcpy(dst + i * sizeof(double), &value, sizeof(double));
+    }
+}
+
+#ifdef LVR_ROS_KERNELS_X86
+__attribute__((target("sse2")))
+void floatToDoubleSSE2(const float* src, uint8_t* dst, size_t n)
+{
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4)
+    {
+        const __m128 values = _mm_loadu_ps(src + i);
+        _mm_storeu_pd(reinterpret_cast<double*>(dst + i * sizeof(double)), _mm_cvtps_pd(values));
+        _mm_storeu_pd(reinterpret_cast<double*>(dst + (i + 2) * sizeof(double)),
+                      _mm_cvtps_pd(_mm_movehl_ps(values, values)));
+    }
+    floatToDoubleScalar(src + i, dst + i * sizeof(double), n - i);
+}
+
+__attribute__((target("avx")))
+void floatToDoubleAVX(const float* src, uint8_t* dst, size_t n)
+{
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        const __m128 lo = _mm_loadu_ps(src + i);
+        const __m128 hi = _mm_loadu_ps(src + i + 4);
+        _mm256_storeu_pd(reinterpret_cast<double*>(dst + i * sizeof(double)), _mm256_cvtps_pd(lo));
+        _mm256_storeu_pd(reinterpret_cast<double*>(dst + (i + 4) * sizeof(double)), _mm256_cvtps_pd(hi));
+    }
+    floatToDoubleScalar(src + i, dst + i * sizeof(double), n - i);
+}
+#endif
+
+/* double -> float */
+
+void doubleToFloatScalar(const uint8_t* src, float* dst, size_t n)
+{
+    for (size_t i = 0; i < n; i++)
+    {
+        double value;
+        std::memcpy(&value, src + i * sizeof(double), sizeof(double));
+        dst[i] = static_cast<float>(value);
+    }
+}
+
+#ifdef LVR_ROS_KERNELS_X86
+__attribute__((target("sse2")))
+void doubleToFloatSSE2(const uint8_t* src, float* dst, size_t n)
+{
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4)
+    {
+        const __m128 lo = _mm_cvtpd_ps(_mm_loadu_pd(reinterpret_cast<const double*>(src + i * sizeof(double))));
+        const __m128 hi = _mm_cvtpd_ps(_mm_loadu_pd(reinterpret_cast<const double*>(src + (i + 2) * sizeof(double))));
+        _mm_storeu_ps(dst + i, _mm_movelh_ps(lo, hi));
+    }
+    doubleToFloatScalar(src + i * sizeof(double), dst + i, n - i);
+}
+
+__attribute__((target("avx")))
+void doubleToFloatAVX(const uint8_t* src, float* dst, size_t n)
+{
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        const __m256d lo = _mm256_loadu_pd(reinterpret_cast<const double*>(src + i * sizeof(double)));
+        const __m256d hi = _mm256_loadu_pd(reinterpret_cast<const double*>(src + (i + 4) * sizeof(double)));
+        _mm_storeu_ps(dst + i, _mm256_cvtpd_ps(lo));
+        _mm_storeu_ps(dst + i + 4, _mm256_cvtpd_ps(hi));
+    }
+    doubleToFloatScalar(src + i * sizeof(double), dst + i, n - i);
+}
+#endif
+
+/* strided copies */
+
+typedef void (*CopyStridedFn)(const uint8_t* src, size_t src_step, uint8_t* dst, size_t dst_step, size_t bytes, size_t n);
+
+template<size_t BYTES>
+void copyStridedFixed(const uint8_t* src, size_t src_step, uint8_t* dst, size_t dst_step, size_t, size_t n)
+{
+    for (size_t i = 0; i < n; i++, src += src_step, dst += dst_step)
+    {
+        std::memcpy(dst, src, BYTES);
+    }
+}
+
+void copyStridedAny(const uint8_t* src, size_t src_step, uint8_t* dst, size_t dst_step, size_t bytes, size_t n)
+{
+    for (size_t i = 0; i < n; i++, src += src_step, dst += dst_step)
+    {
+        std::memcpy(dst, src, bytes);
+    }
+}
+
+CopyStridedFn selectCopyStrided(size_t bytes)
+{
+    switch (bytes)
+    {
+        case 1: return &copyStridedFixed<1>;
+        case 2: return &copyStridedFixed<2>;
+        case 3: return &copyStridedFixed<3>;
+        case 4: return &copyStridedFixed<4>;
+        case 6: return &copyStridedFixed<6>;
+        case 8: return &copyStridedFixed<8>;
+        case 12: return &copyStridedFixed<12>;
+        case 16: return &copyStridedFixed<16>;
+        case 24: return &copyStridedFixed<24>;
+        case 32: return &copyStridedFixed<32>;
+        default: return &copyStridedAny;
+    }
+}
+
+// Bytes of output written per block by interleave, small enough to stay in the L1/L2 cache
+const size_t INTERLEAVE_BLOCK_BYTES = 1 << 15;
+
+/* PointCloud2 gathering */
+
+// Points per block when distributing a cloud over the threads
+const size_t GATHER_BLOCK_SIZE = 1 << 14;
+
+inline float loadFloat(const uint8_t* ptr)
+{
+    float value;
+    std::memcpy(&value, ptr, sizeof(float));
+    return value;
+}
+
+inline uint32_t loadBits(const uint8_t* ptr)
+{
+    uint32_t bits;
+    std::memcpy(&bits, ptr, sizeof(uint32_t));
+    return bits;
+}
+
+// A float is finite if its exponent bits are not all set. Branch free, so the counting
+// loop vectorizes.
+inline uint32_t isFiniteBits(uint32_t bits)
+{
+    return (bits & 0x7f800000u) != 0x7f800000u;
+}
+
+/**
+ * Splits the points of one gather block at row boundaries, rows may be padded,
+ * and calls fn(src, n) for each row segment in order.
+ */
+template<typename Fn>
+void forEachBlockSegment(const uint8_t* data, const CloudGatherLayout& layout, size_t block, Fn fn)
+{
+    const size_t n = layout.width * layout.height;
+    size_t i = block * GATHER_BLOCK_SIZE;
+    const size_t end = std::min(n, i + GATHER_BLOCK_SIZE);
+    while (i < end)
+    {
+        const size_t row = i / layout.width;
+        const size_t col = i % layout.width;
+        const size_t len = std::min(end - i, layout.width - col);
+        fn(data + row * layout.row_step + col * layout.point_step, len);
+        i += len;
+    }
+}
+
+size_t countFiniteSegment(const uint8_t* src, size_t n, const CloudGatherLayout& layout)
+{
+    const size_t step = layout.point_step;
+    const uint32_t ox = layout.xyz[0], oy = layout.xyz[1], oz = layout.xyz[2];
+    size_t count = 0;
+    for (size_t i = 0; i < n; i++, src += step)
+    {
+        count += isFiniteBits(loadBits(src + ox)) & isFiniteBits(loadBits(src + oy)) & isFiniteBits(loadBits(src + oz));
+    }
+    return count;
+}
+
+typedef size_t (*GatherSegmentFn)(
+    const uint8_t* src,
+    size_t n,
+    size_t first,
+    const CloudGatherLayout& layout,
+    const CloudGatherOutput& out,
+    float* bb_min,
+    float* bb_max
+);
+
+/**
+ * Gathers n consecutive points of one row, writing to the outputs starting at point index first.
+ * With COMPACT, points with non-finite coordinates are skipped. Returns the number of points written.
+ */
+template<bool COMPACT, bool PACKED_XYZ, bool NORMALS, bool COLORS, bool INTENSITY>
+size_t gatherSegment(
+    const uint8_t* src,
+    size_t n,
+    size_t first,
+    const CloudGatherLayout& layout,
+    const CloudGatherOutput& out,
+    float* bb_min,
+    float* bb_max)
+{
+    const size_t step = layout.point_step;
+    float* points = out.points + first * 3;
+    float* normals = NORMALS ? out.normals + first * 3 : nullptr;
+    uint8_t* colors = COLORS ? out.colors + first * 3 : nullptr;
+    float* intensities = INTENSITY ? out.intensities + first : nullptr;
+
+    float min_x = bb_min[0], min_y = bb_min[1], min_z = bb_min[2];
+    float max_x = bb_max[0], max_y = bb_max[1], max_z = bb_max[2];
+
+    size_t j = 0;
+    for (size_t i = 0; i < n; i++, src += step)
+    {
+        float p[3];
+        if (PACKED_XYZ)
+        {
+            std::memcpy(p, src, 3 * sizeof(float));
+        }
+        else
+        {
+            p[0] = loadFloat(src + layout.xyz[0]);
+            p[1] = loadFloat(src + layout.xyz[1]);
+            p[2] = loadFloat(src + layout.xyz[2]);
+        }
+
+        if (std::isfinite(p[0]) && std::isfinite(p[1]) && std::isfinite(p[2]))
+        {
+            min_x = std::min(min_x, p[0]); max_x = std::max(max_x, p[0]);
+            min_y = std::min(min_y, p[1]); max_y = std::max(max_y, p[1]);
+            min_z = std::min(min_z, p[2]); max_z = std::max(max_z, p[2]);
+        }
+        else if (COMPACT)
+        {
+            continue;
+        }
+
+        std::memcpy(points + j * 3, p, 3 * sizeof(float));
+        if (NORMALS)
+        {
+            normals[j * 3] = loadFloat(src + layout.normal[0]);
+            normals[j * 3 + 1] = loadFloat(src + layout.normal[1]);
+            normals[j * 3 + 2] = loadFloat(src + layout.normal[2]);
+        }
+        if (COLORS)
+        {
+            std::memcpy(colors + j * 3, src + layout.rgb, 3);
+        }
+        if (INTENSITY)
+        {
+            intensities[j] = loadFloat(src + layout.intensity);
+        }
+        j++;
+    }
+
+    bb_min[0] = min_x; bb_min[1] = min_y; bb_min[2] = min_z;
+    bb_max[0] = max_x; bb_max[1] = max_y; bb_max[2] = max_z;
+    return j;
+}
+
+template<bool COMPACT, bool PACKED_XYZ, bool NORMALS, bool COLORS>
+GatherSegmentFn selectGatherSegment(bool intensity)
+{
+    return intensity
+        ? &gatherSegment<COMPACT, PACKED_XYZ, NORMALS, COLORS, true>
+        : &gatherSegment<COMPACT, PACKED_XYZ, NORMALS, COLORS, false>;
+}
+
+template<bool COMPACT, bool PACKED_XYZ, bool NORMALS>
+GatherSegmentFn selectGatherSegment(bool colors, bool intensity)
+{
+    return colors
+        ? selectGatherSegment<COMPACT, PACKED_XYZ, NORMALS, true>(intensity)
+        : selectGatherSegment<COMPACT, PACKED_XYZ, NORMALS, false>(intensity);
+}
+
+template<bool COMPACT, bool PACKED_XYZ>
+GatherSegmentFn selectGatherSegment(bool normals, bool colors, bool intensity)
+{
+    return normals
+        ? selectGatherSegment<COMPACT, PACKED_XYZ, true>(colors, intensity)
+        : selectGatherSegment<COMPACT, PACKED_XYZ, false>(colors, intensity);
+}
+
+template<bool COMPACT>
+GatherSegmentFn selectGatherSegment(bool packed, bool normals, bool colors, bool intensity)
+{
+    return packed
+        ? selectGatherSegment<COMPACT, true>(normals, colors, intensity)
+        : selectGatherSegment<COMPACT, false>(normals, colors, intensity);
+}
+
+GatherSegmentFn selectGatherSegment(const CloudGatherLayout& layout, bool compact)
+{
+    const bool packed = layout.xyz[0] == 0 && layout.xyz[1] == 4 && layout.xyz[2] == 8;
+    const bool normals = layout.normal[0] >= 0 && layout.normal[1] >= 0 && layout.normal[2] >= 0;
+    const bool colors = layout.rgb >= 0;
+    const bool intensity = layout.intensity >= 0;
+    return compact
+        ? selectGatherSegment<true>(packed, normals, colors, intensity)
+        : selectGatherSegment<false>(packed, normals, colors, intensity);
+}
+
+/* vertex welding */
+
+/**
+ * Number of chunks a parallel pass over n values is split into, 1 for small arrays and
+ * calls from inside a parallel region.
+ */
+size_t parallelChunks(size_t n)
+{
+#ifdef _OPENMP
+    if (n >= PARALLEL_THRESHOLD && !omp_in_parallel())
+    {
+        return static_cast<size_t>(std::max(1, omp_get_max_threads()));
+    }
+#endif
+    return 1;
+}
+
+/**
+ * In place exclusive prefix sum, in parallel for large arrays. Returns the total.
+ */
+template<typename T>
+T exclusiveScan(T* values, size_t n)
+{
+    const size_t chunks = parallelChunks(n);
+    const size_t chunk = (n + chunks - 1) / chunks;
+    std::vector<T> sums(chunks + 1, 0);
+
+    #pragma omp parallel for schedule(static) if(chunks > 1)
+    for (size_t c = 0; c < chunks; c++)
+    {
+        T sum = 0;
+        for (size_t i = c * chunk; i < std::min(n, (c + 1) * chunk); i++)
+        {
+            sum += values[i];
+        }
+        sums[c + 1] = sum;
+    }
+
+    for (size_t c = 0; c < chunks; c++)
+    {
+        sums[c + 1] += sums[c];
+    }
+
+    #pragma omp parallel for schedule(static) if(chunks > 1)
+    for (size_t c = 0; c < chunks; c++)
+    {
+        T running = sums[c];
+        for (size_t i = c * chunk; i < std::min(n, (c + 1) * chunk); i++)
+        {
+            const T value = values[i];
+            values[i] = running;
+            running += value;
+        }
+    }
+    return sums[chunks];
+}
+
+/**
+ * Sorts the chunks of the values in parallel and merges them pairwise.
+ */
+template<typename T>
+void parallelSort(std::vector<T>& values)
+{
+    size_t parts = 1;
+    while (parts * 2 <= parallelChunks(values.size()))
+    {
+        parts *= 2;
+    }
+
+    std::vector<size_t> bounds(parts + 1);
+    for (size_t p = 0; p <= parts; p++)
+    {
+        bounds[p] = values.size() * p / parts;
+    }
+
+    #pragma omp parallel for schedule(static) if(parts > 1)
+    for (size_t p = 0; p < parts; p++)
+    {
+        std::sort(values.begin() + bounds[p], values.begin() + bounds[p + 1]);
+    }
+
+    for (size_t width = 1; width < parts; width *= 2)
+    {
+        #pragma omp parallel for schedule(static)
+        for (size_t p = 0; p < parts; p += 2 * width)
+        {
+            std::inplace_merge(
+                values.begin() + bounds[p],
+                values.begin() + bounds[p + width],
+                values.begin() + bounds[std::min(parts, p + 2 * width)]);
+        }
+    }
+}
+
+inline uint64_t mixHash(uint64_t h)
+{
+    // finalizer of MurmurHash3
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+inline uint64_t cellHash(int64_t x, int64_t y, int64_t z)
+{
+    return mixHash(static_cast<uint64_t>(x) * 73856093ULL
+        ^ mixHash(static_cast<uint64_t>(y) * 19349663ULL
+        ^ mixHash(static_cast<uint64_t>(z) * 83492791ULL)));
+}
+
+inline int64_t cellCoordinate(float value, double inv_cell_size)
+{
+    const double cell = std::floor(value * inv_cell_size);
+    const double limit = 4611686018427387904.0; // 2^62
+    return static_cast<int64_t>(std::max(-limit, std::min(limit, cell)));
+}
+
+/**
+ * Sorted spatial hash over the vertices: vertices of cells with equal hash are consecutive in
+ * entries, bucket b spans entries [starts[b], starts[b + 1]). The buckets are found by an open
+ * addressing table over the cell hashes.
+ */
+struct SpatialHash
+{
+    static constexpr uint32_t EMPTY = ~uint32_t(0);
+
+    std::vector<std::pair<uint64_t, uint32_t>> entries;  // (cell hash, vertex)
+    std::vector<size_t> starts;
+    std::vector<std::pair<uint64_t, uint32_t>> table;    // (cell hash, bucket)
+    size_t mask = 0;
+
+    void build()
+    {
+        const size_t n = entries.size();
+        for (size_t e = 0; e < n; e++)
+        {
+            if (e == 0 || entries[e].first != entries[e - 1].first)
+            {
+                starts.push_back(e);
+            }
+        }
+        const size_t num_buckets = starts.size();
+        starts.push_back(n);
+
+        size_t size = 16;
+        while (size < num_buckets * 2)
+        {
+            size *= 2;
+        }
+        mask = size - 1;
+        table.assign(size, std::make_pair(uint64_t(0), EMPTY));
+        for (size_t b = 0; b < num_buckets; b++)
+        {
+            const uint64_t key = entries[starts[b]].first;
+            size_t slot = key & mask;
+            while (table[slot].second != EMPTY)
+            {
+                slot = (slot + 1) & mask;
+            }
+            table[slot] = std::make_pair(key, static_cast<uint32_t>(b));
+        }
+    }
+
+    // returns the bucket of a key or EMPTY
+    uint32_t find(uint64_t key) const
+    {
+        size_t slot = key & mask;
+        while (table[slot].second != EMPTY && table[slot].first != key)
+        {
+            slot = (slot + 1) & mask;
+        }
+        return table[slot].second;
+    }
+};
+
+} // namespace
+
+size_t weldVertices(const float* vertices, size_t n, float epsilon, uint32_t* remap)
+{
+    if (n == 0)
+    {
+        return 0;
+    }
+
+    // cells of twice the size of epsilon, so the vertices within epsilon lie in the own cell
+    // or in the adjacent cells towards the nearer side on every axis, i.e. in 8 cells.
+    // Without epsilon only bitwise equal positions are welded, keyed by their bits.
+    const bool exact = !(epsilon > 0.0f);
+    const double inv_cell_size = exact ? 0.0 : 0.5 / epsilon;
+    const float epsilon_sq = exact ? 0.0f : epsilon * epsilon;
+
+    auto isFinite = [&](size_t i)
+    {
+        const float* v = vertices + i * 3;
+        return std::isfinite(v[0]) && std::isfinite(v[1]) && std::isfinite(v[2]);
+    };
+
+    auto exactKey = [&](size_t i)
+    {
+        uint32_t bits[3];
+        for (int k = 0; k < 3; k++)
+        {
+            const float value = vertices[i * 3 + k] + 0.0f; // -0 -> +0
+            std::memcpy(&bits[k], &value, sizeof(float));
+        }
+        return cellHash(bits[0], bits[1], bits[2]);
+    };
+
+    SpatialHash hash;
+    hash.entries.resize(n);
+    #pragma omp parallel for schedule(static) if(parallelChunks(n) > 1)
+    for (size_t i = 0; i < n; i++)
+    {
+        uint64_t key = 0;
+        if (!isFinite(i))
+        {
+            key = mixHash(i); // never welded, just keep it out of the way
+        }
+        else if (exact)
+        {
+            key = exactKey(i);
+        }
+        else
+        {
+            const float* v = vertices + i * 3;
+            key = cellHash(
+                cellCoordinate(v[0], inv_cell_size),
+                cellCoordinate(v[1], inv_cell_size),
+                cellCoordinate(v[2], inv_cell_size));
+        }
+        hash.entries[i] = std::make_pair(key, static_cast<uint32_t>(i));
+    }
+    parallelSort(hash.entries);
+    hash.build();
+
+    // calls fn(j) for every other vertex j that is welded to vertex i
+    auto forEachNeighbor = [&](size_t i, auto fn)
+    {
+        if (!isFinite(i))
+        {
+            return;
+        }
+        const float* v = vertices + i * 3;
+
+        uint64_t visited[8];
+        size_t num_visited = 0;
+        auto visitBucket = [&](uint64_t key)
+        {
+            // adjacent cells may share a hash, visit every bucket once
+            if (std::find(visited, visited + num_visited, key) != visited + num_visited)
+            {
+                return;
+            }
+            visited[num_visited++] = key;
+
+            const uint32_t bucket = hash.find(key);
+            if (bucket == SpatialHash::EMPTY)
+            {
+                return;
+            }
+            for (size_t e = hash.starts[bucket]; e < hash.starts[bucket + 1]; e++)
+            {
+                const size_t j = hash.entries[e].second;
+                if (j == i)
+                {
+                    continue;
+                }
+                const float* w = vertices + j * 3;
+                const float dx = v[0] - w[0], dy = v[1] - w[1], dz = v[2] - w[2];
+                if (exact ? (dx == 0.0f && dy == 0.0f && dz == 0.0f) : dx * dx + dy * dy + dz * dz <= epsilon_sq)
+                {
+                    fn(j);
+                }
+            }
+        };
+
+        if (exact)
+        {
+            visitBucket(exactKey(i));
+            return;
+        }
+        int64_t cell[3], side[3];
+        for (int k = 0; k < 3; k++)
+        {
+            const double u = v[k] * inv_cell_size;
+            cell[k] = cellCoordinate(v[k], inv_cell_size);
+            side[k] = (u - std::floor(u)) < 0.5 ? -1 : 1;
+        }
+        for (int corner = 0; corner < 8; corner++)
+        {
+            visitBucket(cellHash(
+                cell[0] + ((corner & 1) ? side[0] : 0),
+                cell[1] + ((corner & 2) ? side[1] : 0),
+                cell[2] + ((corner & 4) ? side[2] : 0)));
+        }
+    };
+
+    // neighbor lists in CSR form: count, scan, fill
+    std::vector<size_t> offsets(n + 1, 0);
+    #pragma omp parallel for schedule(dynamic, 4096) if(parallelChunks(n) > 1)
+    for (size_t i = 0; i < n; i++)
+    {
+        size_t count = 0;
+        forEachNeighbor(i, [&](size_t) { count++; });
+        offsets[i] = count;
+    }
+    const size_t num_pairs = exclusiveScan(offsets.data(), n + 1);
+    std::vector<uint32_t> neighbors(num_pairs);
+    #pragma omp parallel for schedule(dynamic, 4096) if(parallelChunks(n) > 1 && num_pairs > 0)
+    for (size_t i = 0; i < n; i++)
+    {
+        size_t next = offsets[i];
+        if (next < offsets[i + 1])
+        {
+            forEachNeighbor(i, [&](size_t j) { neighbors[next++] = static_cast<uint32_t>(j); });
+        }
+    }
+
+    // greedy leader clustering in index order: every vertex which is not welded yet becomes a
+    // leader and takes all vertices within epsilon of it which are not welded yet. No vertex
+    // moves farther than epsilon, so chains of close vertices, e.g. the vertices of a mesh with
+    // edges shorter than epsilon, do not collapse into a single vertex.
+    const uint32_t UNASSIGNED = ~uint32_t(0);
+    std::vector<uint32_t> labels(n, UNASSIGNED);
+    for (size_t i = 0; i < n; i++)
+    {
+        if (labels[i] != UNASSIGNED)
+        {
+            continue;
+        }
+        labels[i] = static_cast<uint32_t>(i);
+        for (size_t e = offsets[i]; e < offsets[i + 1]; e++)
+        {
+            if (labels[neighbors[e]] == UNASSIGNED)
+            {
+                labels[neighbors[e]] = static_cast<uint32_t>(i);
+            }
+        }
+    }
+
+    // the representatives are numbered in index order
+    std::vector<uint32_t> new_index(n);
+    #pragma omp parallel for schedule(static) if(parallelChunks(n) > 1)
+    for (size_t i = 0; i < n; i++)
+    {
+        new_index[i] = labels[i] == i ? 1 : 0;
+    }
+    const size_t num_welded = exclusiveScan(new_index.data(), n);
+
+    #pragma omp parallel for schedule(static) if(parallelChunks(n) > 1)
+    for (size_t i = 0; i < n; i++)
+    {
+        remap[i] = new_index[labels[i]];
+    }
+    return num_welded;
+}
+
+uint32_t exclusiveScan(uint32_t* values, size_t n)
+{
+    return exclusiveScan<uint32_t>(values, n);
+}
+
+size_t remapFaces(const uint32_t* faces, size_t n, const uint32_t* remap, uint32_t* out, uint32_t* origins)
+{
+    std::vector<size_t> offsets(n);
+    #pragma omp parallel for schedule(static) if(parallelChunks(n) > 1)
+    for (size_t f = 0; f < n; f++)
+    {
+        const uint32_t a = remap[faces[f * 3]], b = remap[faces[f * 3 + 1]], c = remap[faces[f * 3 + 2]];
+        offsets[f] = (a != b && b != c && a != c) ? 1 : 0;
+    }
+    const size_t num_faces = exclusiveScan(offsets.data(), n);
+
+    #pragma omp parallel for schedule(static) if(parallelChunks(n) > 1)
+    for (size_t f = 0; f < n; f++)
+    {
+        const uint32_t a = remap[faces[f * 3]], b = remap[faces[f * 3 + 1]], c = remap[faces[f * 3 + 2]];
+        if (a != b && b != c && a != c)
+        {
+            uint32_t* face = out + offsets[f] * 3;
+            face[0] = a;
+            face[1] = b;
+            face[2] = c;
+            if (origins)
+            {
+                origins[offsets[f]] = static_cast<uint32_t>(f);
+            }
+        }
+    }
+    return num_faces;
+}
+
+void planCloudCompaction(const uint8_t* data, const CloudGatherLayout& layout, CloudCompaction& compaction)
+{
+    const size_t n = layout.width * layout.height;
+    const size_t num_blocks = (n + GATHER_BLOCK_SIZE - 1) / GATHER_BLOCK_SIZE;
+    compaction.block_offsets.assign(num_blocks, 0);
+
+    // count the finite points per block ...
+    void* const context = trace_context;
+    #pragma omp parallel if(num_blocks > 1)
+    {
+        TraceRegion trace(context, "planCloudCompaction");
+        #pragma omp for schedule(static)
+        for (size_t block = 0; block < num_blocks; block++)
+        {
+            size_t count = 0;
+            forEachBlockSegment(data, layout, block, [&](const uint8_t* src, size_t len)
+            {
+                count += countFiniteSegment(src, len, layout);
+            });
+            compaction.block_offsets[block] = count;
+        }
+    }
+
+    // ... and turn the counts into output offsets by an exclusive scan
+    size_t offset = 0;
+    for (size_t block = 0; block < num_blocks; block++)
+    {
+        const size_t count = compaction.block_offsets[block];
+        compaction.block_offsets[block] = offset;
+        offset += count;
+    }
+    compaction.num_finite = offset;
+}
+
+void gatherCloud(
+    const uint8_t* data,
+    const CloudGatherLayout& layout,
+    CloudGatherOutput& out,
+    const CloudCompaction* compaction)
+{
+    const GatherSegmentFn segment = selectGatherSegment(layout, compaction != nullptr);
+    const size_t n = layout.width * layout.height;
+    const size_t num_blocks = (n + GATHER_BLOCK_SIZE - 1) / GATHER_BLOCK_SIZE;
+
+    const float inf = std::numeric_limits<float>::infinity();
+    for (int k = 0; k < 3; k++)
+    {
+        out.bb_min[k] = inf;
+        out.bb_max[k] = -inf;
+    }
+
+    // per block bounding boxes, merged after the parallel loop
+    std::vector<float> block_bounds(num_blocks * 6);
+
+    void* const context = trace_context;
+    #pragma omp parallel if(num_blocks > 1)
+    {
+        TraceRegion trace(context, "gatherCloud");
+        #pragma omp for schedule(static)
+        for (size_t block = 0; block < num_blocks; block++)
+        {
+            float* bb_min = &block_bounds[block * 6];
+            float* bb_max = bb_min + 3;
+            for (int k = 0; k < 3; k++)
+            {
+                bb_min[k] = inf;
+                bb_max[k] = -inf;
+            }
+
+            // every block writes to its own output range, so the blocks need no synchronization
+            size_t written = compaction ? compaction->block_offsets[block] : block * GATHER_BLOCK_SIZE;
+            forEachBlockSegment(data, layout, block, [&](const uint8_t* src, size_t len)
+            {
+                written += segment(src, len, written, layout, out, bb_min, bb_max);
+            });
+        }
+    }
+
+    for (size_t block = 0; block < num_blocks; block++)
+    {
+        for (int k = 0; k < 3; k++)
+        {
+            out.bb_min[k] = std::min(out.bb_min[k], block_bounds[block * 6 + k]);
+            out.bb_max[k] = std::max(out.bb_max[k], block_bounds[block * 6 + 3 + k]);
+        }
+    }
+}
+
+void copyStrided(const uint8_t* src, size_t src_step, uint8_t* dst, size_t dst_step, size_t bytes, size_t n)
+{
+    if (src_step == bytes && dst_step == bytes)
+    {
+        forEachChunk("copyStrided", n, [&](size_t begin, size_t end)
+        {
+            std::memcpy(dst + begin * bytes, src + begin * bytes, (end - begin) * bytes);
+        });
+        return;
+    }
+
+    const CopyStridedFn copy = selectCopyStrided(bytes);
+    forEachChunk("copyStrided", n, [&](size_t begin, size_t end)
+    {
+        copy(src + begin * src_step, src_step, dst + begin * dst_step, dst_step, bytes, end - begin);
+    });
+}
+
+void interleave(const InterleaveField* fields, size_t num_fields, uint8_t* dst, size_t point_step, size_t n)
+{
+    if (num_fields == 0 || point_step == 0)
+    {
+        return;
+    }
+
+    std::vector<CopyStridedFn> copies(num_fields);
+    for (size_t f = 0; f < num_fields; f++)
+    {
+        copies[f] = selectCopyStrided(fields[f].bytes);
+    }
+
+    const size_t block = std::max<size_t>(16, INTERLEAVE_BLOCK_BYTES / point_step);
+    forEachChunk("interleave", n, [&](size_t begin, size_t end)
+    {
+        for (size_t first = begin; first < end; first += block)
+        {
+            const size_t count = std::min(block, end - first);
+            for (size_t f = 0; f < num_fields; f++)
+            {
+                const InterleaveField& field = fields[f];
+                copies[f](
+                    field.src + first * field.bytes, field.bytes,
+                    dst + first * point_step + field.offset, point_step,
+                    field.bytes, count);
+            }
+        }
+    });
+}
+
+void floatToDouble(const float* src, void* dst, size_t n)
+{
+    uint8_t* out = static_cast<uint8_t*>(dst);
+    const Isa selected = isa();
+    forEachChunk("floatToDouble", n, [&](size_t begin, size_t end)
+    {
+        const float* s = src + begin;
+        uint8_t* d = out + begin * sizeof(double);
+        switch (selected)
+        {
+#ifdef LVR_ROS_KERNELS_X86
+            case Isa::AVX: floatToDoubleAVX(s, d, end - begin); break;
+            case Isa::SSE2: floatToDoubleSSE2(s, d, end - begin); break;
+#endif
+            default: floatToDoubleScalar(s, d, end - begin); break;
+        }
+    });
+}
+
+void doubleToFloat(const void* src, float* dst, size_t n)
+{
+    const uint8_t* in = static_cast<const uint8_t*>(src);
+    const Isa selected = isa();
+    forEachChunk("doubleToFloat", n, [&](size_t begin, size_t end)
+    {
+        const uint8_t* s = in + begin * sizeof(double);
+        float* d = dst + begin;
+        switch (selected)
+        {
+#ifdef LVR_ROS_KERNELS_X86
+            case Isa::AVX: doubleToFloatAVX(s, d, end - begin); break;
+            case Isa::SSE2: doubleToFloatSSE2(s, d, end - begin); break;
+#endif
+            default: doubleToFloatScalar(s, d, end - begin); break;
+        }
+    });
+}
+
+void copyIndices(const uint32_t* src, uint32_t* dst, size_t n)
+{
+    forEachChunk("copyIndices", n, [&](size_t begin, size_t end)
+    {
+        std::memcpy(dst + begin, src + begin, (end - begin) * sizeof(uint32_t));
+    });
+}
+
+void rgbToRGBAFloat(const uint8_t* src, size_t channels, float* dst, size_t n, float alpha)
+{
+    const float scale = 1.0f / 255.0f;
+    forEachChunk("rgbToRGBAFloat", n, [&](size_t begin, size_t end)
+    {
+        for (size_t i = begin; i < end; i++)
+        {
+            const uint8_t* color = src + i * channels;
+            float* rgba = dst + i * 4;
+            rgba[0] = color[0] * scale;
+            rgba[1] = color[1] * scale;
+            rgba[2] = color[2] * scale;
+            rgba[3] = alpha;
+        }
+    });
+}
+
+bool minMax(const float* values, size_t n, float& min, float& max)
+{
+    float lo = std::numeric_limits<float>::infinity();
+    float hi = -std::numeric_limits<float>::infinity();
+
+    #pragma omp parallel for schedule(static) reduction(min:lo) reduction(max:hi) if(parallelChunks(n) > 1)
+    for (size_t i = 0; i < n; i++)
+    {
+        const float value = values[i];
+        // comparisons with NaN are false, infinities are excluded explicitly
+        if (std::fabs(value) <= std::numeric_limits<float>::max())
+        {
+            lo = std::min(lo, value);
+            hi = std::max(hi, value);
+        }
+    }
+
+    if (lo > hi)
+    {
+        return false;
+    }
+    min = lo;
+    max = hi;
+    return true;
+}
+
+void lookupColors(
+    const float* values,
+    size_t n,
+    float min,
+    float max,
+    const float* lut,
+    size_t lut_size,
+    float* dst)
+{
+    const float range = max - min;
+    const float scale = range > 0 ? (lut_size - 1) / range : 0.0f;
+    const float last = static_cast<float>(lut_size - 1);
+    const uint32_t invalid = static_cast<uint32_t>(lut_size);
+
+    forEachChunk("lookupColors", n, [&](size_t begin, size_t end)
+    {
+        // compute the table indices of a block in a branch free loop the compiler vectorizes,
+        // then copy the colors
+        const size_t BLOCK = 256;
+        uint32_t indices[BLOCK];
+        for (size_t first = begin; first < end; first += BLOCK)
+        {
+            const size_t count = std::min(BLOCK, end - first);
+            const float* v = values + first;
+            for (size_t i = 0; i < count; i++)
+            {
+                const bool finite = std::fabs(v[i]) <= std::numeric_limits<float>::max();
+                float x = finite ? (v[i] - min) * scale : 0.0f;
+                x = std::min(std::max(x, 0.0f), last);
+                indices[i] = finite ? static_cast<uint32_t>(x + 0.5f) : invalid;
+            }
+
+            float* out = dst + first * 4;
+            for (size_t i = 0; i < count; i++)
+            {
+                std::memcpy(out + i * 4, lut + indices[i] * 4, 4 * sizeof(float));
+            }
+        }
+    });
+}
+
+/* hashing */
+
+namespace {
+
+const uint64_t PRIME64_1 = 0x9E3779B185EBCA87ULL;
+const uint64_t PRIME64_2 = 0xC2B2AE3D27D4EB4FULL;
+const uint64_t PRIME64_3 = 0x165667B19E3779F9ULL;
+const uint64_t PRIME64_4 = 0x85EBCA77C2B2AE63ULL;
+const uint64_t PRIME64_5 = 0x27D4EB2F165667C5ULL;
+
+// block size of contentHash, must not change or persisted hashes become invalid
+const size_t HASH_BLOCK = 1 << 20;
+
+inline uint64_t rotl64(uint64_t x, int r)
+{
+    return (x << r) | (x >> (64 - r));
+}
+
+inline uint64_t read64(const uint8_t* ptr)
+{
+    uint64_t value;
+    std::memcpy(&value, ptr, sizeof(value));
+    return value;
+}
+
+inline uint32_t read32(const uint8_t* ptr)
+{
+    uint32_t value;
+    std::memcpy(&value, ptr, sizeof(value));
+    return value;
+}
+
+inline uint64_t xxhRound(uint64_t acc, uint64_t input)
+{
+    acc += input * PRIME64_2;
+    acc = rotl64(acc, 31);
+    return acc * PRIME64_1;
+}
+
+inline uint64_t xxhMerge(uint64_t acc, uint64_t value)
+{
+    acc ^= xxhRound(0, value);
+    return acc * PRIME64_1 + PRIME64_4;
+}
+
+} // namespace
+
+uint64_t xxh64(const void* data, size_t bytes, uint64_t seed)
+{
+    const uint8_t* ptr = static_cast<const uint8_t*>(data);
+    const uint8_t* const end = ptr + bytes;
+    uint64_t h;
+
+    if (bytes >= 32)
+    {
+        uint64_t v1 = seed + PRIME64_1 + PRIME64_2;
+        uint64_t v2 = seed + PRIME64_2;
+        uint64_t v3 = seed;
+        uint64_t v4 = seed - PRIME64_1;
+        const uint8_t* const limit = end - 32;
+        do
+        {
+            v1 = xxhRound(v1, read64(ptr));
+            v2 = xxhRound(v2, read64(ptr + 8));
+            v3 = xxhRound(v3, read64(ptr + 16));
+            v4 = xxhRound(v4, read64(ptr + 24));
+            ptr += 32;
+        } while (ptr <= limit);
+
+        h = rotl64(v1, 1) + rotl64(v2, 7) + rotl64(v3, 12) + rotl64(v4, 18);
+        h = xxhMerge(h, v1);
+        h = xxhMerge(h, v2);
+        h = xxhMerge(h, v3);
+        h = xxhMerge(h, v4);
+    }
+    else
+    {
+        h = seed + PRIME64_5;
+    }
+
+    h += static_cast<uint64_t>(bytes);
+
+    for (; ptr + 8 <= end; ptr += 8)
+    {
+        h ^= xxhRound(0, read64(ptr));
+        h = rotl64(h, 27) * PRIME64_1 + PRIME64_4;
+    }
+    if (ptr + 4 <= end)
+    {
+        h ^= static_cast<uint64_t>(read32(ptr)) * PRIME64_1;
+        h = rotl64(h, 23) * PRIME64_2 + PRIME64_3;
+        ptr += 4;
+    }
+    for (; ptr < end; ptr++)
+    {
+        h ^= (*ptr) * PRIME64_5;
+        h = rotl64(h, 11) * PRIME64_1;
+    }
+
+    h ^= h >> 33;
+    h *= PRIME64_2;
+    h ^= h >> 29;
+    h *= PRIME64_3;
+    h ^= h >> 32;
+    return h;
+}
+
+uint64_t contentHash(const void* data, size_t bytes, uint64_t seed)
+{
+    const uint8_t* src = static_cast<const uint8_t*>(data);
+    const size_t num_blocks = (bytes + HASH_BLOCK - 1) / HASH_BLOCK;
+    if (num_blocks <= 1)
+    {
+        return xxh64(src, bytes, seed);
+    }
+
+    std::vector<uint64_t> block_hashes(num_blocks);
+    auto hashBlocks = [&](size_t begin, size_t end)
+    {
+        for (size_t block = begin; block < end; block++)
+        {
+            const size_t offset = block * HASH_BLOCK;
+            block_hashes[block] = xxh64(src + offset, std::min(HASH_BLOCK, bytes - offset), seed);
+        }
+    };
+    void* const context = trace_context;
+#ifdef _OPENMP
+    if (omp_get_max_threads() > 1 && !omp_in_parallel())
+    {
+        #pragma omp parallel
+        {
+            TraceRegion trace(context, "contentHash");
+            #pragma omp for schedule(static)
+            for (size_t block = 0; block < num_blocks; block++)
+            {
+                hashBlocks(block, block + 1);
+            }
+        }
+    }
+    else
+#endif
+    {
+        TraceRegion trace(context, "contentHash");
+        hashBlocks(0, num_blocks);
+    }
+
+    return xxh64(block_hashes.data(), num_blocks * sizeof(uint64_t), seed ^ bytes);
+}
+
+const char* instructionSet()
+{
+    switch (isa())
+    {
+        case Isa::AVX: return "AVX";
+        case Isa::SSE2: return "SSE2";
+        default: return "scalar";
+    }
+}
+
+void setTraceHook(TraceHook hook)
+{
+    trace_hook.store(hook);
+}
+
+void* setTraceContext(void* context)
+{
+    void* previous = trace_context;
+    trace_context = context;
+    return previous;
+}
+
+} // namespace kernels
+} // namespace lvr_ros
@@ -0,0 +1,337 @@
+/*
+ * UOS-ROS packages - Robot Operating System code by the University of Osnabrück
+ * Copyright (C) 2013 University of Osnabrück
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * mesh_cache.cpp
+ *
+ */
+
+#include "lvr_ros/mesh_cache.h"
+#include "lvr_ros/conversions.h"
+
+#include <algorithm>
+
+#include <boost/make_shared.hpp>
+
+#include <ros/console.h>
+
+namespace lvr_ros
+{
+
+namespace
+{
+
+size_t bufferBytes(lvr2::MeshBuffer& buffer)
+{
+    const size_t num_vertices = buffer.numVertices();
+    const size_t num_faces = buffer.numFaces();
+
+    size_t bytes = num_vertices * 3 * sizeof(float) + num_faces * 3 * sizeof(uint32_t);
+    if (buffer.hasVertexNormals())
+    {
+        bytes += num_vertices * 3 * sizeof(float);
+    }
+    if (buffer.hasVertexColors())
+    {
+        size_t width = 0;
+        buffer.getVertexColors(width);
+        bytes += num_vertices * width;
+    }
+    if (buffer.getTextureCoordinates())
+    {
+        bytes += num_vertices * 2 * sizeof(float);
+    }
+    if (buffer.hasFaceNormals())
+    {
+        bytes += num_faces * 3 * sizeof(float);
+    }
+    if (buffer.hasFaceColors())
+    {
+        size_t width = 0;
+        buffer.getFaceColors(width);
+        bytes += num_faces * width;
+    }
+    if (buffer.hasFaceMaterialIndices())
+    {
+        bytes += num_faces * sizeof(uint32_t);
+    }
+    for (const auto& texture : buffer.getTextures())
+    {
+        bytes += static_cast<size_t>(texture.m_width) * texture.m_height
+            * texture.m_numChannels * texture.m_numBytesPerChan;
+    }
+    bytes += buffer.getMaterials().size() * sizeof(lvr2::Material);
+    return bytes;
+}
+
+size_t materialsBytes(const mesh_msgs::MeshMaterials& materials)
+{
+    size_t bytes = 0;
+    for (const auto& cluster : materials.clusters)
+    {
+        bytes += sizeof(cluster) + cluster.face_indices.size() * sizeof(uint32_t);
+    }
+    bytes += materials.materials.size() * sizeof(mesh_msgs::MeshMaterial);
+    bytes += materials.cluster_materials.size() * sizeof(uint32_t);
+    bytes += materials.vertex_tex_coords.size() * sizeof(mesh_msgs::MeshVertexTexCoords);
+    return bytes;
+}
+
+} // namespace
+
+CachedMesh::CachedMesh(
+    const std::string& uuid,
+    const std_msgs::Header& header,
+    const lvr2::MeshBufferPtr& mesh_buffer
+)
+    : mesh_uuid(uuid),
+      header(header),
+      texture_flags(new std::once_flag[mesh_buffer->getTextures().size()]),
+      textures(mesh_buffer->getTextures().size()),
+      buffer_bytes(bufferBytes(*mesh_buffer)),
+      message_bytes(0)
+{
+    auto mesh_geometry = boost::make_shared<MeshBufferGeometryStamped>();
+    mesh_geometry->header = header;
+    mesh_geometry->uuid = uuid;
+    mesh_geometry->mesh_buffer = mesh_buffer;
+    geometry_stamped = mesh_geometry;
+}
+
+const std::string& CachedMesh::uuid() const
+{
+    return mesh_uuid;
+}
+
+const boost::shared_ptr<const MeshBufferGeometryStamped>& CachedMesh::geometry() const
+{
+    return geometry_stamped;
+}
+
+boost::shared_ptr<const mesh_msgs::MeshMaterialsStamped> CachedMesh::materials() const
+{
+    std::call_once(materials_flag, [this]()
+    {
+        auto materials = boost::make_shared<mesh_msgs::MeshMaterialsStamped>();
+        if (!fromMeshBufferToMeshMaterialsMessage(geometry_stamped->mesh_buffer, materials->mesh_materials))
+        {
+            ROS_ERROR_STREAM("Could not convert the materials of mesh " << mesh_uuid << "!");
+            return;
+        }
+        materials->header = header;
+        materials->uuid = mesh_uuid;
+        message_bytes += materialsBytes(materials->mesh_materials);
+        materials_stamped = materials;
+    });
+    return materials_stamped;
+}
+
+boost::shared_ptr<const mesh_msgs::MeshVertexColorsStamped> CachedMesh::vertexColors() const
+{
+    std::call_once(vertex_colors_flag, [this]()
+    {
+        auto vertex_colors = boost::make_shared<mesh_msgs::MeshVertexColorsStamped>();
+        if (!fromMeshBufferToMeshVertexColorsMessage(geometry_stamped->mesh_buffer, vertex_colors->mesh_vertex_colors))
+        {
+            ROS_ERROR_STREAM("Could not convert the vertex colors of mesh " << mesh_uuid << "!");
+            return;
+        }
+        vertex_colors->header = header;
+        vertex_colors->uuid = mesh_uuid;
+        message_bytes += vertex_colors->mesh_vertex_colors.vertex_colors.size() * sizeof(std_msgs::ColorRGBA);
+        vertex_colors_stamped = vertex_colors;
+    });
+    return vertex_colors_stamped;
+}
+
+boost::shared_ptr<const mesh_msgs::MeshTexture> CachedMesh::texture(size_t index) const
+{
+    if (index >= textures.size())
+    {
+        return boost::shared_ptr<const mesh_msgs::MeshTexture>();
+    }
+    std::call_once(texture_flags[index], [this, index]()
+    {
+        auto texture = boost::make_shared<mesh_msgs::MeshTexture>();
+        if (!fromMeshBufferToMeshTextureMessage(geometry_stamped->mesh_buffer, index, mesh_uuid, *texture))
+        {
+            return;
+        }
+        message_bytes += sizeof(*texture) + texture->image.data.size();
+        textures[index] = texture;
+    });
+    return textures[index];
+}
+
+size_t CachedMesh::numTextures() const
+{
+    return textures.size();
+}
+
+size_t CachedMesh::bytes() const
+{
+    return buffer_bytes + message_bytes;
+}
+
+MeshCache::MeshCache(size_t max_bytes)
+    : index(std::make_shared<const Index>()),
+      max_bytes(max_bytes),
+      total_bytes(0),
+      clock(0),
+      hits(0),
+      misses(0),
+      evictions(0)
+{
+}
+
+void MeshCache::account(Entry& entry)
+{
+    size_t accounted = entry.accounted;
+    const size_t bytes = entry.mesh->bytes();
+    // the total wraps around for a shrinking mesh, which adds the negative difference
+    while (accounted != EVICTED && accounted != bytes)
+    {
+        if (entry.accounted.compare_exchange_weak(accounted, bytes))
+        {
+            total_bytes += bytes - accounted;
+            return;
+        }
+    }
+}
+
+void MeshCache::release(Entry& entry)
+{
+    const size_t accounted = entry.accounted.exchange(EVICTED);
+    if (accounted != EVICTED)
+    {
+        total_bytes -= accounted;
+    }
+}
+
+std::shared_ptr<MeshCache::Entry> MeshCache::popLeastRecentlyUsed(const Index& current)
+{
+    while (!lru.empty())
+    {
+        LruItem item = lru.top();
+        lru.pop();
+        auto it = current.find(item.second->mesh->uuid());
+        if (it == current.end() || it->second != item.second)
+        {
+            continue; // evicted or replaced
+        }
+        const uint64_t last_used = item.second->last_used;
+        if (last_used != item.first)
+        {
+            lru.push(LruItem(last_used, item.second));
+            continue;
+        }
+        return item.second;
+    }
+    return std::shared_ptr<Entry>();
+}
+
+void MeshCache::insert(const CachedMeshConstPtr& mesh)
+{
+    auto entry = std::make_shared<Entry>();
+    entry->mesh = mesh;
+    entry->last_used = ++clock;
+    entry->accounted = mesh->bytes();
+
+    std::lock_guard<std::mutex> lock(insert_mutex);
+    auto next = std::make_shared<Index>(*std::atomic_load(&index));
+    std::shared_ptr<Entry>& slot = (*next)[mesh->uuid()];
+    if (slot)
+    {
+        release(*slot);
+    }
+    slot = entry;
+    total_bytes += entry->accounted;
+    lru.push(LruItem(entry->last_used, entry));
+
+    // evict the least recently used meshes, never the inserted one
+    std::vector<std::shared_ptr<Entry>> kept;
+    while (total_bytes > max_bytes && next->size() > 1)
+    {
+        std::shared_ptr<Entry> victim = popLeastRecentlyUsed(*next);
+        if (!victim)
+        {
+            break;
+        }
+        if (victim == entry)
+        {
+            kept.push_back(victim);
+            continue;
+        }
+        // the messages of the victim may have been built since it was counted
+        account(*victim);
+        ROS_INFO_STREAM("Evicting mesh " << victim->mesh->uuid() << " from the cache.");
+        release(*victim);
+        next->erase(victim->mesh->uuid());
+        evictions++;
+    }
+    for (const auto& item : kept)
+    {
+        lru.push(LruItem(item->last_used, item));
+    }
+
+    // drop the outdated items of replaced meshes once they dominate the queue
+    if (lru.size() > 2 * next->size() + 16)
+    {
+        LruQueue rebuilt;
+        for (const auto& cached : *next)
+        {
+            rebuilt.push(LruItem(cached.second->last_used, cached.second));
+        }
+        lru.swap(rebuilt);
+    }
+
+    const size_t num_entries = next->size();
+    std::atomic_store(&index, std::shared_ptr<const Index>(std::move(next)));
+
+    ROS_INFO_STREAM("Cached mesh " << mesh->uuid() << " (" << mesh->bytes() / (1024 * 1024) << " MB). Cache: "
+        << num_entries << " meshes, " << total_bytes / (1024 * 1024) << " of " << max_bytes / (1024 * 1024)
+        << " MB, " << hits << " hits, " << misses << " misses, " << evictions << " evictions.");
+}
+
+CachedMeshConstPtr MeshCache::get(const std::string& uuid)
+{
+    std::shared_ptr<const Index> current = std::atomic_load(&index);
+    auto it = current->find(uuid);
+    if (it == current->end())
+    {
+        misses++;
+        return CachedMeshConstPtr();
+    }
+    hits++;
+    it->second->last_used = ++clock;
+    account(*it->second);
+    return it->second->mesh;
+}
+
+MeshCache::Statistics MeshCache::statistics() const
+{
+    std::shared_ptr<const Index> current = std::atomic_load(&index);
+    Statistics stats;
+    stats.hits = hits;
+    stats.misses = misses;
+    stats.evictions = evictions;
+    stats.entries = current->size();
+    stats.bytes = total_bytes;
+    return stats;
+}
+
+} // namespace lvr_ros
@@ -0,0 +1,569 @@
+/*
+ * UOS-ROS packages - Robot Operating System code by the University of Osnabrück
+ * Copyright (C) 2013 University of Osnabrück
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * mesh_store.cpp
+ *
+ */
+
+#include "lvr_ros/mesh_store.h"
+#include "lvr_ros/hdf5_utils.h"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <vector>
+
+#include <hdf5_hl.h>
+
+#include <ros/console.h>
+
+namespace lvr_ros
+{
+
+namespace
+{
+
+const char* const MESHES_GROUP = "/meshes";
+const char* const INCOMPLETE_GROUP = "/incomplete";
+
+// target size of a dataset chunk
+const size_t CHUNK_BYTES = 1 << 20;
+
+using hdf5::linkExists;
+using hdf5::nativeType;
+
+bool ensureGroup(hid_t file, const char* name)
+{
+    if (linkExists(file, name))
+    {
+        return true;
+    }
+    hid_t group = H5Gcreate2(file, name, H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
+    if (group < 0)
+    {
+        return false;
+    }
+    H5Gclose(group);
+    return true;
+}
+
+/**
+ * Writes a dataset of the given dimensions, chunked along the first dimension
+ */
+template<typename T>
+bool writeDataset(hid_t group, const std::string& name, const T* data, const std::vector<hsize_t>& dims, int compression)
+{
+    hsize_t row_elements = 1;
+    for (size_t i = 1; i < dims.size(); i++)
+    {
+        row_elements *= dims[i];
+    }
+
+    hid_t space = H5Screate_simple(static_cast<int>(dims.size()), dims.data(), nullptr);
+    hid_t properties = H5Pcreate(H5P_DATASET_CREATE);
+    if (dims[0] > 0 && row_elements > 0)
+    {
+        std::vector<hsize_t> chunk = dims;
+        chunk[0] = std::max<hsize_t>(1, std::min<hsize_t>(dims[0], CHUNK_BYTES / (row_elements * sizeof(T))));
+        H5Pset_chunk(properties, static_cast<int>(chunk.size()), chunk.data());
+        if (compression > 0)
+        {
+            H5Pset_shuffle(properties);
+            H5Pset_deflate(properties, static_cast<unsigned>(compression));
+        }
+    }
+
+    hid_t dataset = H5Dcreate2(group, name.c_str(), nativeType<T>(), space, H5P_DEFAULT, properties, H5P_DEFAULT);
+    bool success = dataset >= 0;
+    if (success && dims[0] > 0 && row_elements > 0)
+    {
+        success = H5Dwrite(dataset, nativeType<T>(), H5S_ALL, H5S_ALL, H5P_DEFAULT, data) >= 0;
+    }
+
+    if (dataset >= 0)
+    {
+        H5Dclose(dataset);
+    }
+    H5Pclose(properties);
+    H5Sclose(space);
+    return success;
+}
+
+/**
+ * Reads a whole dataset
+ * @return false if the dataset does not exist or can not be read
+ */
+template<typename T>
+bool readDataset(hid_t group, const std::string& name, boost::shared_array<T>& data, std::vector<hsize_t>& dims)
+{
+    if (!linkExists(group, name))
+    {
+        return false;
+    }
+    hid_t dataset = H5Dopen2(group, name.c_str(), H5P_DEFAULT);
+    if (dataset < 0)
+    {
+        return false;
+    }
+    dims = hdf5::datasetDims(dataset);
+
+    hsize_t elements = 1;
+    for (hsize_t dim : dims)
+    {
+        elements *= dim;
+    }
+    data = boost::shared_array<T>(new T[std::max<hsize_t>(1, elements)]);
+    bool success = elements == 0
+        || H5Dread(dataset, nativeType<T>(), H5S_ALL, H5S_ALL, H5P_DEFAULT, data.get()) >= 0;
+
+    H5Dclose(dataset);
+    return success;
+}
+
+// Reads a dataset with the given number of rows, e.g. a vertex channel
+template<typename T>
+bool readChannel(hid_t group, const std::string& name, size_t rows, boost::shared_array<T>& data, size_t& width)
+{
+    std::vector<hsize_t> dims;
+    if (!readDataset(group, name, data, dims) || dims.size() != 2 || dims[0] != rows)
+    {
+        return false;
+    }
+    width = dims[1];
+    return true;
+}
+
+std::string readStringAttribute(hid_t location, const char* object, const char* name)
+{
+    H5T_class_t type_class;
+    size_t size = 0;
+    hsize_t dims = 0;
+    if (H5LTget_attribute_info(location, object, name, &dims, &type_class, &size) < 0)
+    {
+        return std::string();
+    }
+    std::vector<char> value(size + 1, '\0');
+    H5LTget_attribute_string(location, object, name, value.data());
+    return std::string(value.data());
+}
+
+} // namespace
+
+MeshStore::MeshStore(const std::string& path, int compression)
+    : path(path),
+      compression(std::min(std::max(compression, 0), 9)),
+      file(-1),
+      stopped(false)
+{
+    if (std::filesystem::exists(path))
+    {
+        file = H5Fopen(path.c_str(), H5F_ACC_RDWR, H5P_DEFAULT);
+    }
+    else
+    {
+        file = H5Fcreate(path.c_str(), H5F_ACC_EXCL, H5P_DEFAULT, H5P_DEFAULT);
+    }
+
+    if (file < 0 || !ensureGroup(file, MESHES_GROUP))
+    {
+        ROS_ERROR_STREAM("Could not open the mesh store " << path << "!");
+        return;
+    }
+
+    // meshes which were being written when the node stopped
+    if (linkExists(file, INCOMPLETE_GROUP))
+    {
+        H5Ldelete(file, INCOMPLETE_GROUP, H5P_DEFAULT);
+    }
+    ROS_INFO_STREAM("Opened the mesh store " << path << ".");
+
+    writer = std::thread(&MeshStore::writeQueued, this);
+}
+
+MeshStore::~MeshStore()
+{
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex);
+        stopped = true;
+    }
+    condition.notify_all();
+    if (writer.joinable())
+    {
+        writer.join();
+    }
+
+    if (file >= 0)
+    {
+        H5Fclose(file);
+    }
+}
+
+bool MeshStore::isOpen() const
+{
+    return file >= 0;
+}
+
+void MeshStore::store(const CachedMeshConstPtr& mesh)
+{
+    if (!isOpen())
+    {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex);
+        queue.push_back(mesh);
+    }
+    condition.notify_one();
+}
+
+CachedMeshConstPtr MeshStore::load(const std::string& uuid)
+{
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex);
+        for (const auto& mesh : queue)
+        {
+            if (mesh->uuid() == uuid)
+            {
+                return mesh;
+            }
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(hdf5_mutex);
+    if (!exists(uuid))
+    {
+        return CachedMeshConstPtr();
+    }
+    return read(uuid);
+}
+
+bool MeshStore::contains(const std::string& uuid)
+{
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex);
+        for (const auto& mesh : queue)
+        {
+            if (mesh->uuid() == uuid)
+            {
+                return true;
+            }
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(hdf5_mutex);
+    return exists(uuid);
+}
+
+void MeshStore::writeQueued()
+{
+    std::unique_lock<std::mutex> lock(queue_mutex);
+    while (true)
+    {
+        condition.wait(lock, [this]() { return stopped || !queue.empty(); });
+        if (queue.empty())
+        {
+            return;
+        }
+
+        // the mesh stays in the queue until it is written, so load finds it in the meantime
+        CachedMeshConstPtr mesh = queue.front();
+        lock.unlock();
+        {
+            std::lock_guard<std::mutex> hdf5_lock(hdf5_mutex);
+            if (!write(*mesh))
+            {
+                ROS_ERROR_STREAM("Could not write mesh " << mesh->uuid() << " to the mesh store " << path << "!");
+            }
+        }
+        lock.lock();
+        queue.pop_front();
+    }
+}
+
+bool MeshStore::exists(const std::string& uuid)
+{
+    if (!isOpen() || uuid.empty() || uuid.find('/') != std::string::npos || uuid == "." || uuid == "..")
+    {
+        return false;
+    }
+
+    auto it = index.find(uuid);
+    if (it != index.end())
+    {
+        return it->second;
+    }
+    const bool stored = linkExists(file, std::string(MESHES_GROUP) + "/" + uuid);
+    index[uuid] = stored;
+    return stored;
+}
+
+bool MeshStore::write(const CachedMesh& mesh)
+{
+    lvr2::MeshBuffer& buffer = *mesh.geometry()->mesh_buffer;
+    const std_msgs::Header& header = mesh.geometry()->header;
+    const hsize_t n_vertices = buffer.numVertices();
+    const hsize_t n_faces = buffer.numFaces();
+
+    if (!ensureGroup(file, INCOMPLETE_GROUP))
+    {
+        return false;
+    }
+    const std::string incomplete = std::string(INCOMPLETE_GROUP) + "/" + mesh.uuid();
+    if (linkExists(file, incomplete))
+    {
+        H5Ldelete(file, incomplete.c_str(), H5P_DEFAULT);
+    }
+    hid_t group = H5Gcreate2(file, incomplete.c_str(), H5P_DEFAULT, H5P_DEFAULT, H5P_DEFAULT);
+    if (group < 0)
+    {
+        return false;
+    }
+
+    bool success = writeDataset(group, "vertices", buffer.getVertices().get(), {n_vertices, 3}, compression)
+        && writeDataset(group, "faces", buffer.getFaceIndices().get(), {n_faces, 3}, compression);
+    if (success && buffer.hasVertexNormals())
+    {
+        success = writeDataset(group, "vertex_normals", buffer.getVertexNormals().get(), {n_vertices, 3}, compression);
+    }
+    if (success && buffer.hasVertexColors())
+    {
+        size_t width = 3;
+        lvr2::ucharArr colors = buffer.getVertexColors(width);
+        success = writeDataset(group, "vertex_colors", colors.get(), {n_vertices, width}, compression);
+    }
+    if (success && buffer.getTextureCoordinates())
+    {
+        success = writeDataset(
+            group, "texture_coordinates", buffer.getTextureCoordinates().get(), {n_vertices, 2}, compression);
+    }
+    if (success && buffer.hasFaceNormals())
+    {
+        success = writeDataset(group, "face_normals", buffer.getFaceNormals().get(), {n_faces, 3}, compression);
+    }
+    if (success && buffer.hasFaceColors())
+    {
+        size_t width = 3;
+        lvr2::ucharArr colors = buffer.getFaceColors(width);
+        success = writeDataset(group, "face_colors", colors.get(), {n_faces, width}, compression);
+    }
+    if (success && buffer.hasFaceMaterialIndices())
+    {
+        success = writeDataset(
+            group, "face_material_indices", buffer.getFaceMaterialIndices().get(), {n_faces, 1}, compression);
+    }
+
+    // one row per material: r, g, b and the texture index, -1 if not set
+    const auto& materials = buffer.getMaterials();
+    if (success && !materials.empty())
+    {
+        std::vector<int> rows(materials.size() * 4, -1);
+        for (size_t i = 0; i < materials.size(); i++)
+        {
+            if (materials[i].m_color)
+            {
+                for (size_t c = 0; c < 3; c++)
+                {
+                    rows[i * 4 + c] = materials[i].m_color.get()[c];
+                }
+            }
+            if (materials[i].m_texture)
+            {
+                rows[i * 4 + 3] = static_cast<int>(materials[i].m_texture.get().idx());
+            }
+        }
+        success = writeDataset(group, "materials", rows.data(), {materials.size(), 4}, compression);
+    }
+
+    const auto& textures = buffer.getTextures();
+    for (size_t i = 0; success && i < textures.size(); i++)
+    {
+        const lvr2::Texture& texture = textures[i];
+        const std::string name = "texture_" + std::to_string(i);
+        success = writeDataset(
+            group,
+            name,
+            texture.m_data,
+            {texture.m_height, texture.m_width, static_cast<hsize_t>(texture.m_numChannels) * texture.m_numBytesPerChan},
+            compression
+        );
+        if (success)
+        {
+            const unsigned int format[] = {texture.m_numChannels, texture.m_numBytesPerChan};
+            H5LTset_attribute_uint(group, name.c_str(), "format", format, 2);
+            H5LTset_attribute_float(group, name.c_str(), "texel_size", &texture.m_texelSize, 1);
+        }
+    }
+
+    if (success)
+    {
+        const unsigned int stamp[] = {header.stamp.sec, header.stamp.nsec};
+        const unsigned int num_textures = static_cast<unsigned int>(textures.size());
+        success = H5LTset_attribute_string(group, ".", "uuid", mesh.uuid().c_str()) >= 0
+            && H5LTset_attribute_string(group, ".", "frame_id", header.frame_id.c_str()) >= 0
+            && H5LTset_attribute_uint(group, ".", "stamp", stamp, 2) >= 0
+            && H5LTset_attribute_uint(group, ".", "num_textures", &num_textures, 1) >= 0;
+    }
+    H5Gclose(group);
+
+    if (!success)
+    {
+        H5Ldelete(file, incomplete.c_str(), H5P_DEFAULT);
+        return false;
+    }
+
+    const std::string complete = std::string(MESHES_GROUP) + "/" + mesh.uuid();
+    if (linkExists(file, complete))
+    {
+        H5Ldelete(file, complete.c_str(), H5P_DEFAULT);
+    }
+    if (H5Lmove(file, incomplete.c_str(), file, complete.c_str(), H5P_DEFAULT, H5P_DEFAULT) < 0)
+    {
+        return false;
+    }
+    H5Fflush(file, H5F_SCOPE_GLOBAL);
+    index[mesh.uuid()] = true;
+    return true;
+}
+
+CachedMeshConstPtr MeshStore::read(const std::string& uuid)
+{
+    const std::string name = std::string(MESHES_GROUP) + "/" + uuid;
+    hid_t group = H5Gopen2(file, name.c_str(), H5P_DEFAULT);
+    if (group < 0)
+    {
+        return CachedMeshConstPtr();
+    }
+
+    lvr2::MeshBufferPtr buffer(new lvr2::MeshBuffer);
+    std::vector<hsize_t> dims;
+    bool success = true;
+
+    lvr2::floatArr vertices;
+    lvr2::indexArray faces;
+    std::vector<hsize_t> face_dims;
+    if (!readDataset(group, "vertices", vertices, dims) || dims.size() != 2 || dims[1] != 3
+        || !readDataset(group, "faces", faces, face_dims) || face_dims.size() != 2 || face_dims[1] != 3)
+    {
+        ROS_ERROR_STREAM("The mesh " << uuid << " in the mesh store has no valid geometry!");
+        H5Gclose(group);
+        return CachedMeshConstPtr();
+    }
+    const size_t n_vertices = dims[0];
+    const size_t n_faces = face_dims[0];
+    buffer->setVertices(vertices, n_vertices);
+    buffer->setFaceIndices(faces, n_faces);
+
+    size_t width;
+    lvr2::floatArr floats;
+    lvr2::ucharArr bytes;
+    lvr2::indexArray indices;
+    if (readChannel(group, "vertex_normals", n_vertices, floats, width) && width == 3)
+    {
+        buffer->setVertexNormals(floats);
+    }
+    if (readChannel(group, "vertex_colors", n_vertices, bytes, width))
+    {
+        buffer->setVertexColors(bytes, width);
+    }
+    if (readChannel(group, "texture_coordinates", n_vertices, floats, width) && width == 2)
+    {
+        buffer->setTextureCoordinates(floats);
+    }
+    if (readChannel(group, "face_normals", n_faces, floats, width) && width == 3)
+    {
+        buffer->setFaceNormals(floats);
+    }
+    if (readChannel(group, "face_colors", n_faces, bytes, width))
+    {
+        buffer->setFaceColors(bytes, width);
+    }
+    if (readChannel(group, "face_material_indices", n_faces, indices, width) && width == 1)
+    {
+        buffer->setFaceMaterialIndices(indices);
+    }
+
+    boost::shared_array<int> material_rows;
+    if (readDataset(group, "materials", material_rows, dims) && dims.size() == 2 && dims[1] == 4)
+    {
+        std::vector<lvr2::Material> materials(dims[0]);
+        for (size_t i = 0; i < materials.size(); i++)
+        {
+            const int* row = material_rows.get() + i * 4;
+            if (row[0] >= 0)
+            {
+                lvr2::Rgb8Color color;
+                for (size_t c = 0; c < 3; c++)
+                {
+                    color[c] = static_cast<uint8_t>(row[c]);
+                }
+                materials[i].m_color = color;
+            }
+            if (row[3] >= 0)
+            {
+                materials[i].m_texture = lvr2::TextureHandle(row[3]);
+            }
+        }
+        buffer->setMaterials(materials);
+    }
+
+    unsigned int num_textures = 0;
+    H5LTget_attribute_uint(group, ".", "num_textures", &num_textures);
+    std::vector<lvr2::Texture> textures;
+    textures.reserve(num_textures);
+    for (unsigned int i = 0; success && i < num_textures; i++)
+    {
+        const std::string texture_name = "texture_" + std::to_string(i);
+        unsigned int format[2] = {3, 1};
+        float texel_size = 1.0f;
+        success = readDataset(group, texture_name, bytes, dims) && dims.size() == 3
+            && H5LTget_attribute_uint(group, texture_name.c_str(), "format", format) >= 0
+            && H5LTget_attribute_float(group, texture_name.c_str(), "texel_size", &texel_size) >= 0
+            && dims[2] == static_cast<hsize_t>(format[0]) * format[1];
+        if (success)
+        {
+            textures.emplace_back(
+                static_cast<int>(i),
+                static_cast<unsigned short>(dims[1]),
+                static_cast<unsigned short>(dims[0]),
+                static_cast<unsigned char>(format[0]),
+                static_cast<unsigned char>(format[1]),
+                texel_size,
+                bytes.get()
+            );
+        }
+    }
+    if (!success)
+    {
+        ROS_ERROR_STREAM("Could not read the textures of mesh " << uuid << " from the mesh store!");
+        H5Gclose(group);
+        return CachedMeshConstPtr();
+    }
+    buffer->setTextures(textures);
+
+    std_msgs::Header header;
+    unsigned int stamp[2] = {0, 0};
+    H5LTget_attribute_uint(group, ".", "stamp", stamp);
+    header.stamp.sec = stamp[0];
+    header.stamp.nsec = stamp[1];
+    header.frame_id = readStringAttribute(group, ".", "frame_id");
+    H5Gclose(group);
+
+    return std::make_shared<CachedMesh>(uuid, header, buffer);
+}
+
+} // namespace lvr_ros
@@ -0,0 +1,194 @@
+/*
+ * UOS-ROS packages - Robot Operating System code by the University of Osnabrück
+ * Copyright (C) 2013 University of Osnabrück
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * offline_reconstruction.cpp
+ *
+ * Reconstructs a mesh from a point cloud file without a ROS master, with the same pipeline and
+ * parameters as the reconstruction node, and reports the timing and memory of every step.
+ *
+ * Usage: lvr_ros_offline_reconstruction [options] <input cloud> <output mesh>
+ *   --config <file>  parameters in the format of config/lvr_params.yaml
+ *   --report <file>  JSON report of every run, "-" for stdout
+ *   --trace <file>   Chrome trace of the last run
+ *   --repeat <n>     reconstruct the cloud n times, e.g. to benchmark a release
+ *
+ */
+
+#include "lvr_ros/conversions.h"
+#include "lvr_ros/kernels.h"
+#include "lvr_ros/reconstruction_pipeline.h"
+#include "lvr_ros/thread_budget.h"
+#include "lvr_ros/trace_recorder.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <ros/console.h>
+
+namespace
+{
+
+struct Options
+{
+    std::string input;
+    std::string output;
+    std::string config;
+    std::string report;
+    std::string trace;
+    int repeat = 1;
+};
+
+void printUsage()
+{
+    std::cerr << "Usage: lvr_ros_offline_reconstruction [options] <input cloud> <output mesh>\n"
+        << "  --config <file>  parameters in the format of config/lvr_params.yaml\n"
+        << "  --report <file>  JSON report of every run, \"-\" for stdout\n"
+        << "  --trace <file>   Chrome trace of the last run\n"
+        << "  --repeat <n>     reconstruct the cloud n times\n";
+}
+
+bool parseOptions(int argc, char** args, Options& options)
+{
+    std::vector<std::string> positional;
+    for (int i = 1; i < argc; i++)
+    {
+        const std::string arg = args[i];
+        if ((arg == "--config" || arg == "--report" || arg == "--trace" || arg == "--repeat") && i + 1 < argc)
+        {
+            const std::string value = args[++i];
+            if (arg == "--config") options.config = value;
+            else if (arg == "--report") options.report = value;
+            else if (arg == "--trace") options.trace = value;
+            else options.repeat = std::max(1, std::atoi(value.c_str()));
+        }
+        else if (arg.compare(0, 2, "--") == 0)
+        {
+            return false;
+        }
+        else
+        {
+            positional.push_back(arg);
+        }
+    }
+    if (positional.size() != 2)
+    {
+        return false;
+    }
+    options.input = positional[0];
+    options.output = positional[1];
+    return true;
+}
+
+double secondsSince(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+} // namespace
+
+int main(int argc, char** args)
+{
+    Options options;
+    if (!parseOptions(argc, args, options))
+    {
+        printUsage();
+        return 2;
+    }
+
+    lvr_ros::ReconstructionConfig config = lvr_ros::ReconstructionConfig::__getDefault__();
+    if (!options.config.empty() && !lvr_ros::readConfigFile(options.config, config))
+    {
+        return 1;
+    }
+
+    const size_t threads = std::min(static_cast<size_t>(std::max(1, config.threads)), lvr_ros::threadLimit());
+
+    std::ostringstream report;
+    report << "{\"input\": \"" << options.input << "\", \"config\": \"" << options.config
+        << "\", \"instruction_set\": \"" << lvr_ros::kernels::instructionSet() << "\", \"threads\": "
+        << threads << ", \"runs\": [";
+
+    lvr2::MeshBufferPtr mesh_buffer;
+    for (int run = 0; run < options.repeat; run++)
+    {
+        // every run starts from the file, the pipeline adds normals to the points
+        auto read_start = std::chrono::steady_clock::now();
+        lvr2::PointBufferPtr point_buffer;
+        if (!lvr_ros::readPointBuffer(point_buffer, options.input))
+        {
+            ROS_ERROR_STREAM("Could not read any points from " << options.input << "!");
+            return 1;
+        }
+        const double read_seconds = secondsSince(read_start);
+
+        const bool traced = !options.trace.empty() && run + 1 == options.repeat;
+        std::unique_ptr<lvr_ros::TraceRecorder> trace(traced ? new lvr_ros::TraceRecorder(options.input) : nullptr);
+        lvr_ros::TraceRecorder::Activation activation(trace.get(), "main");
+
+        lvr_ros::ReconstructionProgress progress;
+        lvr_ros::ReconstructionTiming timing;
+        timing.setInputSize(point_buffer->numPoints());
+        if (!lvr_ros::reconstructMeshBuffer(point_buffer, mesh_buffer, config, progress, timing))
+        {
+            ROS_ERROR_STREAM("The reconstruction of " << options.input << " failed!");
+            return 1;
+        }
+        timing.setOutputSize(mesh_buffer->numVertices(), mesh_buffer->numFaces());
+        ROS_INFO_STREAM("Run " << run + 1 << "/" << options.repeat << ": " << timing.summary());
+
+        report << (run == 0 ? "\n" : ",\n") << "{\"read_seconds\": " << read_seconds << ", \"reconstruction\": ";
+        timing.writeJson(report);
+        report << "}";
+
+        if (trace && !trace->write(options.trace))
+        {
+            ROS_ERROR_STREAM("Could not write the trace to " << options.trace << "!");
+        }
+    }
+
+    auto write_start = std::chrono::steady_clock::now();
+    if (!lvr_ros::writeMeshBuffer(mesh_buffer, options.output))
+    {
+        ROS_ERROR_STREAM("Could not write the mesh to " << options.output << "!");
+        return 1;
+    }
+    report << "\n], \"write_seconds\": " << secondsSince(write_start) << "}\n";
+
+    if (options.report == "-")
+    {
+        std::cout << report.str();
+    }
+    else if (!options.report.empty())
+    {
+        std::ofstream file(options.report);
+        file << report.str();
+        if (!file)
+        {
+            ROS_ERROR_STREAM("Could not write the report to " << options.report << "!");
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,628 @@
+/*
+ * UOS-ROS packages - Robot Operating System code by the University of Osnabrück
+ * Copyright (C) 2013 University of Osnabrück
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * parameter_sweep.cpp
+ *
+ * Reconstructs a cloud with every combination of a grid of parameters and reports the time of
+ * every step, the peak memory, the size of the mesh and its distance to the input points. The
+ * configurations which are not dominated in time, memory and error form the Pareto front, e.g.
+ *
+ *   lvr_ros_parameter_sweep --config config/lvr_params.yaml --param voxelsize=0.05,0.1,0.2
+ *       --param pcm=FLANN,NANOFLANN --csv sweep.csv cloud.ply
+ *
+ * Options:
+ *   --config <file>          base parameters in the format of config/lvr_params.yaml
+ *   --param <name=a,b,..>    values of a parameter of cfg/Reconstruction.cfg, may be repeated
+ *   --jobs <n>               concurrent reconstructions, default the cores divided by the
+ *                            threads of the base config
+ *   --samples <n>            input points to measure the error with, default 10000
+ *   --csv <file>             every configuration, "-" for stdout
+ *   --markdown <file>        the Pareto front, "-" for stdout, the default without --csv
+ *
+ * Instead of a file, the input may be a synthetic scene of synthetic_scenes.h, e.g.
+ * "scene:room:1000000". Every configuration runs in its own process, which measures its own
+ * peak memory and does not share the mesh extraction lock of lvr2 with the others.
+ *
+ */
+
+#include "lvr_ros/conversions.h"
+#include "lvr_ros/reconstruction_pipeline.h"
+#include "lvr_ros/synthetic_scenes.h"
+#include "lvr_ros/thread_budget.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <ros/console.h>
+
+namespace
+{
+
+struct Parameter
+{
+    std::string name;
+    std::vector<std::string> values;
+};
+
+struct Result
+{
+    bool success = false;
+    double seconds = 0.0;
+    size_t peak_memory = 0;
+    size_t vertices = 0;
+    size_t faces = 0;
+    // distance of the sampled input points to the mesh
+    double mean_error = 0.0;
+    double rms_error = 0.0;
+    double max_error = 0.0;
+    std::vector<std::pair<std::string, double>> steps;
+    bool pareto = false;
+};
+
+struct Run
+{
+    // the swept values, in the order of the parameters
+    std::vector<std::string> values;
+    lvr_ros::ReconstructionConfig config;
+    Result result;
+    pid_t pid = -1;
+    int fd = -1;
+};
+
+std::vector<std::string> split(const std::string& list, char separator)
+{
+    std::vector<std::string> items;
+    std::istringstream stream(list);
+    std::string item;
+    while (std::getline(stream, item, separator))
+    {
+        if (!item.empty())
+        {
+            items.push_back(item);
+        }
+    }
+    return items;
+}
+
+bool loadInput(const std::string& input, lvr2::PointBufferPtr& buffer)
+{
+    const std::vector<std::string> scene_spec = split(input, ':');
+    if (scene_spec.size() == 3 && scene_spec[0] == "scene")
+    {
+        lvr_ros::SyntheticScene scene;
+        if (!lvr_ros::parseSyntheticSceneType(scene_spec[1], scene.type))
+        {
+            return false;
+        }
+        scene.points = std::strtoull(scene_spec[2].c_str(), nullptr, 10);
+        sensor_msgs::PointCloud2 cloud;
+        lvr_ros::generateSyntheticScene(scene, cloud);
+        buffer.reset(new lvr2::PointBuffer);
+        lvr2::BoundingBox<lvr_ros::Vec> bounding_box;
+        return lvr_ros::fromPointCloud2ToPointBuffer(cloud, *buffer, bounding_box, true);
+    }
+    return lvr_ros::readPointBuffer(buffer, input);
+}
+
+/**********************************************************************************************************************/
+// Geometric error
+
+typedef std::array<float, 3> Point;
+
+Point sub(const Point& a, const Point& b)
+{
+    return {a[0] - b[0], a[1] - b[1], a[2] - b[2]};
+}
+
+float dot(const Point& a, const Point& b)
+{
+    return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+}
+
+// squared distance of p to the triangle abc, Ericson, Real-Time Collision Detection, 5.1.5
+float squaredTriangleDistance(const Point& p, const Point& a, const Point& b, const Point& c)
+{
+    const Point ab = sub(b, a), ac = sub(c, a), ap = sub(p, a);
+    const float d1 = dot(ab, ap), d2 = dot(ac, ap);
+    Point closest;
+    if (d1 <= 0 && d2 <= 0)
+    {
+        closest = a;
+    }
+    else
+    {
+        const Point bp = sub(p, b);
+        const float d3 = dot(ab, bp), d4 = dot(ac, bp);
+        const Point cp = sub(p, c);
+        const float d5 = dot(ab, cp), d6 = dot(ac, cp);
+        const float vc = d1 * d4 - d3 * d2, vb = d5 * d2 - d1 * d6, va = d3 * d6 - d5 * d4;
+        float v, w;
+        if (d3 >= 0 && d4 <= d3) { v = 1; w = 0; }
+        else if (vc <= 0 && d1 >= 0 && d3 <= 0) { v = d1 / (d1 - d3); w = 0; }
+        else if (d6 >= 0 && d5 <= d6) { v = 0; w = 1; }
+        else if (vb <= 0 && d2 >= 0 && d6 <= 0) { v = 0; w = d2 / (d2 - d6); }
+        else if (va <= 0 && (d4 - d3) >= 0 && (d5 - d6) >= 0)
+        {
+            w = (d4 - d3) / ((d4 - d3) + (d5 - d6));
+            v = 1 - w;
+        }
+        else
+        {
+            const float denominator = 1 / (va + vb + vc);
+            v = vb * denominator;
+            w = vc * denominator;
+        }
+        for (int k = 0; k < 3; k++)
+        {
+            closest[k] = a[k] + ab[k] * v + ac[k] * w;
+        }
+    }
+    const Point d = sub(p, closest);
+    return dot(d, d);
+}
+
+/**
+ * Distances of evenly spaced input points to the nearest face of the mesh, the faces are binned
+ * into a uniform grid. Points without a face within the search radius, e.g. in holes of the
+ * mesh, count with the search radius.
+ */
+void measureError(const lvr2::PointBufferPtr& points, const lvr2::MeshBufferPtr& mesh, size_t samples, float radius, Result& result)
+{
+    const size_t num_points = points->numPoints();
+    const size_t num_faces = mesh->numFaces();
+    if (num_points == 0 || samples == 0)
+    {
+        return;
+    }
+    const lvr2::floatArr point_array = points->getPointArray();
+    const lvr2::floatArr vertices = mesh->getVertices();
+    const lvr2::indexArray faces = mesh->getFaceIndices();
+
+    const float cell = radius;
+    auto cellOf = [cell](float x) { return static_cast<int64_t>(std::floor(x / cell)); };
+    auto key = [](int64_t x, int64_t y, int64_t z)
+    {
+        return (static_cast<uint64_t>(x) * 73856093u) ^ (static_cast<uint64_t>(y) * 19349663u)
+            ^ (static_cast<uint64_t>(z) * 83492791u);
+    };
+    std::unordered_map<uint64_t, std::vector<uint32_t>> grid;
+    for (size_t f = 0; f < num_faces; f++)
+    {
+        int64_t lo[3], hi[3];
+        for (int k = 0; k < 3; k++)
+        {
+            float min = std::numeric_limits<float>::max(), max = -min;
+            for (int corner = 0; corner < 3; corner++)
+            {
+                const float value = vertices[faces[f * 3 + corner] * 3 + k];
+                min = std::min(min, value);
+                max = std::max(max, value);
+            }
+            lo[k] = cellOf(min);
+            hi[k] = cellOf(max);
+        }
+        for (int64_t x = lo[0]; x <= hi[0]; x++)
+            for (int64_t y = lo[1]; y <= hi[1]; y++)
+                for (int64_t z = lo[2]; z <= hi[2]; z++)
+                    grid[key(x, y, z)].push_back(static_cast<uint32_t>(f));
+    }
+
+    const size_t stride = std::max<size_t>(1, num_points / samples);
+    size_t count = 0;
+    double sum = 0.0, squared_sum = 0.0, max = 0.0;
+    for (size_t i = 0; i < num_points; i += stride)
+    {
+        const Point p = {point_array[i * 3], point_array[i * 3 + 1], point_array[i * 3 + 2]};
+        float best = radius * radius;
+        const int64_t cx = cellOf(p[0]), cy = cellOf(p[1]), cz = cellOf(p[2]);
+        for (int64_t x = cx - 1; x <= cx + 1; x++)
+            for (int64_t y = cy - 1; y <= cy + 1; y++)
+                for (int64_t z = cz - 1; z <= cz + 1; z++)
+                {
+                    auto it = grid.find(key(x, y, z));
+                    if (it == grid.end())
+                    {
+                        continue;
+                    }
+                    for (uint32_t f : it->second)
+                    {
+                        const Point a = {vertices[faces[f * 3] * 3], vertices[faces[f * 3] * 3 + 1], vertices[faces[f * 3] * 3 + 2]};
+                        const Point b = {vertices[faces[f * 3 + 1] * 3], vertices[faces[f * 3 + 1] * 3 + 1], vertices[faces[f * 3 + 1] * 3 + 2]};
+                        const Point c = {vertices[faces[f * 3 + 2] * 3], vertices[faces[f * 3 + 2] * 3 + 1], vertices[faces[f * 3 + 2] * 3 + 2]};
+                        best = std::min(best, squaredTriangleDistance(p, a, b, c));
+                    }
+                }
+        const double distance = std::sqrt(best);
+        sum += distance;
+        squared_sum += distance * distance;
+        max = std::max(max, distance);
+        count++;
+    }
+    result.mean_error = sum / count;
+    result.rms_error = std::sqrt(squared_sum / count);
+    result.max_error = max;
+}
+
+/**********************************************************************************************************************/
+// Runs
+
+/**
+ * Reconstructs the input with the config of a run in the child process and writes the result to fd
+ */
+void runChild(const std::string& input, const lvr_ros::ReconstructionConfig& config, size_t samples, int fd)
+{
+    // also limits the generation of a synthetic scene
+    lvr_ros::setThreadLimit(static_cast<size_t>(std::max(1, config.threads)));
+    lvr2::PointBufferPtr point_buffer;
+    if (!loadInput(input, point_buffer))
+    {
+        return;
+    }
+    lvr_ros::ReconstructionProgress progress;
+    lvr_ros::ReconstructionTiming timing;
+    lvr2::MeshBufferPtr mesh_buffer;
+    timing.setInputSize(point_buffer->numPoints());
+    if (!lvr_ros::reconstructMeshBuffer(point_buffer, mesh_buffer, config, progress, timing))
+    {
+        return;
+    }
+
+    Result result;
+    result.seconds = timing.totalSeconds();
+    result.peak_memory = lvr_ros::ReconstructionTiming::peakMemory();
+    result.vertices = mesh_buffer->numVertices();
+    result.faces = mesh_buffer->numFaces();
+    // two voxels, beyond that a point is not covered by the mesh
+    measureError(point_buffer, mesh_buffer, samples, static_cast<float>(2 * config.voxelsize), result);
+
+    std::ostringstream out;
+    out << std::setprecision(9) << result.seconds << " " << result.peak_memory << " " << result.vertices << " "
+        << result.faces << " " << result.mean_error << " " << result.rms_error << " " << result.max_error << "\n";
+    for (const auto& step : timing.steps())
+    {
+        out << step.seconds << " " << step.name << "\n";
+    }
+    const std::string text = out.str();
+    for (size_t written = 0; written < text.size();)
+    {
+        const ssize_t n = write(fd, text.data() + written, text.size() - written);
+        if (n <= 0)
+        {
+            return;
+        }
+        written += static_cast<size_t>(n);
+    }
+}
+
+bool startRun(const std::string& input, size_t samples, Run& run)
+{
+    int fds[2];
+    if (pipe(fds) != 0)
+    {
+        return false;
+    }
+    run.pid = fork();
+    if (run.pid < 0)
+    {
+        close(fds[0]);
+        close(fds[1]);
+        return false;
+    }
+    if (run.pid == 0)
+    {
+        close(fds[0]);
+        runChild(input, run.config, samples, fds[1]);
+        close(fds[1]);
+        _exit(0);
+    }
+    close(fds[1]);
+    run.fd = fds[0];
+    return true;
+}
+
+void finishRun(Run& run)
+{
+    std::string text;
+    char buffer[4096];
+    ssize_t n;
+    while ((n = read(run.fd, buffer, sizeof(buffer))) > 0)
+    {
+        text.append(buffer, static_cast<size_t>(n));
+    }
+    close(run.fd);
+    int status = 0;
+    waitpid(run.pid, &status, 0);
+
+    std::istringstream in(text);
+    Result& result = run.result;
+    result.success = static_cast<bool>(in >> result.seconds >> result.peak_memory >> result.vertices >> result.faces
+        >> result.mean_error >> result.rms_error >> result.max_error);
+    double seconds;
+    std::string name;
+    while (in >> seconds && std::getline(in >> std::ws, name))
+    {
+        result.steps.emplace_back(name, seconds);
+    }
+}
+
+// a dominates b if it is not worse in time, memory and error, and better in one of them
+bool dominates(const Result& a, const Result& b)
+{
+    const bool not_worse = a.seconds <= b.seconds && a.peak_memory <= b.peak_memory && a.mean_error <= b.mean_error;
+    const bool better = a.seconds < b.seconds || a.peak_memory < b.peak_memory || a.mean_error < b.mean_error;
+    return not_worse && better;
+}
+
+/**********************************************************************************************************************/
+// Output
+
+void writeCsv(std::ostream& out, const std::vector<Parameter>& parameters, const std::vector<Run>& runs)
+{
+    std::vector<std::string> steps;
+    for (const auto& run : runs)
+    {
+        for (const auto& step : run.result.steps)
+        {
+            if (std::find(steps.begin(), steps.end(), step.first) == steps.end())
+            {
+                steps.push_back(step.first);
+            }
+        }
+    }
+
+    for (const auto& parameter : parameters)
+    {
+        out << parameter.name << ",";
+    }
+    out << "success,pareto,seconds,peak_memory_mb,vertices,faces,mean_error,rms_error,max_error";
+    for (const auto& step : steps)
+    {
+        out << "," << step << " [s]";
+    }
+    out << "\n";
+
+    for (const auto& run : runs)
+    {
+        const Result& r = run.result;
+        for (const auto& value : run.values)
+        {
+            out << value << ",";
+        }
+        out << (r.success ? 1 : 0) << "," << (r.pareto ? 1 : 0) << "," << r.seconds << ","
+            << r.peak_memory / (1024 * 1024) << "," << r.vertices << "," << r.faces << ","
+            << r.mean_error << "," << r.rms_error << "," << r.max_error;
+        for (const auto& step : steps)
+        {
+            auto it = std::find_if(r.steps.begin(), r.steps.end(),
+                [&step](const std::pair<std::string, double>& s) { return s.first == step; });
+            out << ",";
+            if (it != r.steps.end())
+            {
+                out << it->second;
+            }
+        }
+        out << "\n";
+    }
+}
+
+void writeMarkdown(std::ostream& out, const std::vector<Parameter>& parameters, const std::vector<Run>& runs)
+{
+    std::vector<const Run*> front;
+    for (const auto& run : runs)
+    {
+        if (run.result.pareto)
+        {
+            front.push_back(&run);
+        }
+    }
+    std::sort(front.begin(), front.end(),
+        [](const Run* a, const Run* b) { return a->result.seconds < b->result.seconds; });
+
+    out << "|";
+    for (const auto& parameter : parameters)
+    {
+        out << " " << parameter.name << " |";
+    }
+    out << " time [s] | peak memory [MB] | vertices | faces | mean error | rms error | slowest step |\n|";
+    for (size_t i = 0; i < parameters.size() + 7; i++)
+    {
+        out << " --- |";
+    }
+    out << "\n";
+    for (const Run* run : front)
+    {
+        const Result& r = run->result;
+        out << "|";
+        for (const auto& value : run->values)
+        {
+            out << " " << value << " |";
+        }
+        auto slowest = std::max_element(r.steps.begin(), r.steps.end(),
+            [](const std::pair<std::string, double>& a, const std::pair<std::string, double>& b)
+            {
+                return a.second < b.second;
+            });
+        out << std::fixed << std::setprecision(3) << " " << r.seconds << " | " << r.peak_memory / (1024 * 1024)
+            << " | " << r.vertices << " | " << r.faces << " | " << std::setprecision(5) << r.mean_error << " | "
+            << r.rms_error << " | " << (slowest != r.steps.end() ? slowest->first : "") << " |\n";
+        out.unsetf(std::ios::floatfield);
+    }
+}
+
+bool writeOutput(const std::string& path, const std::function<void(std::ostream&)>& write)
+{
+    if (path == "-")
+    {
+        write(std::cout);
+        return true;
+    }
+    std::ofstream file(path);
+    write(file);
+    if (!file)
+    {
+        ROS_ERROR_STREAM("Could not write " << path << "!");
+        return false;
+    }
+    return true;
+}
+
+void printUsage()
+{
+    std::cerr << "Usage: lvr_ros_parameter_sweep [--config file] [--param name=a,b,..]... [--jobs n] "
+        << "[--samples n] [--csv file] [--markdown file] <input cloud | scene:<type>:<points>>\n";
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    std::string config_path, csv_path, markdown_path, input;
+    std::vector<Parameter> parameters;
+    size_t jobs = 0;
+    size_t samples = 10000;
+    for (int i = 1; i < argc; i++)
+    {
+        const std::string arg = argv[i];
+        const bool has_value = i + 1 < argc;
+        if (arg == "--config" && has_value) config_path = argv[++i];
+        else if (arg == "--csv" && has_value) csv_path = argv[++i];
+        else if (arg == "--markdown" && has_value) markdown_path = argv[++i];
+        else if (arg == "--jobs" && has_value) jobs = std::strtoull(argv[++i], nullptr, 10);
+        else if (arg == "--samples" && has_value) samples = std::strtoull(argv[++i], nullptr, 10);
+        else if (arg == "--param" && has_value)
+        {
+            const std::string spec = argv[++i];
+            const size_t equals = spec.find('=');
+            Parameter parameter;
+            parameter.name = spec.substr(0, equals);
+            if (equals != std::string::npos)
+            {
+                parameter.values = split(spec.substr(equals + 1), ',');
+            }
+            if (parameter.values.empty())
+            {
+                printUsage();
+                return 2;
+            }
+            parameters.push_back(parameter);
+        }
+        else if (input.empty() && arg.compare(0, 2, "--") != 0) input = arg;
+        else
+        {
+            printUsage();
+            return 2;
+        }
+    }
+    if (input.empty())
+    {
+        printUsage();
+        return 2;
+    }
+    if (csv_path.empty() && markdown_path.empty())
+    {
+        markdown_path = "-";
+    }
+
+    lvr_ros::ReconstructionConfig base = lvr_ros::ReconstructionConfig::__getDefault__();
+    if (!config_path.empty() && !lvr_ros::readConfigFile(config_path, base))
+    {
+        return 1;
+    }
+    if (jobs == 0)
+    {
+        jobs = std::max<size_t>(1, std::thread::hardware_concurrency() / std::max(1, base.threads));
+    }
+
+    // the cartesian product of the values, the last parameter varies fastest
+    std::vector<Run> runs(1);
+    runs[0].config = base;
+    for (const auto& parameter : parameters)
+    {
+        std::vector<Run> product;
+        for (const auto& run : runs)
+        {
+            for (const auto& value : parameter.values)
+            {
+                Run next = run;
+                next.values.push_back(value);
+                if (!lvr_ros::setConfigValue(next.config, parameter.name, value))
+                {
+                    return 2;
+                }
+                product.push_back(next);
+            }
+        }
+        runs.swap(product);
+    }
+    ROS_INFO_STREAM("Sweeping " << runs.size() << " configurations with " << jobs << " concurrent jobs.");
+
+    // keep at most jobs children running, they finish in the order they have been started
+    size_t started = 0, finished = 0;
+    while (finished < runs.size())
+    {
+        while (started < runs.size() && started - finished < jobs)
+        {
+            if (!startRun(input, samples, runs[started]))
+            {
+                ROS_ERROR_STREAM("Could not start a reconstruction!");
+                return 1;
+            }
+            started++;
+        }
+        finishRun(runs[finished]);
+        const Result& r = runs[finished].result;
+        ROS_INFO_STREAM("Configuration " << finished + 1 << "/" << runs.size() << ": "
+            << (r.success ? std::to_string(r.seconds) + " s, " + std::to_string(r.faces) + " faces" : "failed"));
+        finished++;
+    }
+
+    for (auto& run : runs)
+    {
+        run.result.pareto = run.result.success && std::none_of(runs.begin(), runs.end(),
+            [&run](const Run& other) { return other.result.success && dominates(other.result, run.result); });
+    }
+
+    bool written = true;
+    if (!csv_path.empty())
+    {
+        written &= writeOutput(csv_path, [&](std::ostream& out) { writeCsv(out, parameters, runs); });
+    }
+    if (!markdown_path.empty())
+    {
+        written &= writeOutput(markdown_path, [&](std::ostream& out) { writeMarkdown(out, parameters, runs); });
+    }
+    return written ? 0 : 1;
+}
@@ -22,80 +22,159 @@
  *
  */
 
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <fstream>
 #include <iostream>
 #include <memory>
+#include <thread>
 
 using std::make_shared;
 using std::move;
 
 
+#include <boost/lexical_cast.hpp>
+#include <boost/make_shared.hpp>
 #include <boost/uuid/uuid.hpp>
 #include <boost/uuid/uuid_generators.hpp>
 #include <boost/uuid/uuid_io.hpp>
 
 #include "lvr_ros/reconstruction.h"
 #include "lvr_ros/conversions.h"
+#include "lvr_ros/reconstruction_pipeline.h"
+#include "lvr_ros/thread_budget.h"
+
+#include <diagnostic_msgs/DiagnosticArray.h>
 
-#include <lvr2/io/PLYIO.hpp>
 #include <lvr2/config/lvropenmp.hpp>
-#include <lvr2/geometry/Matrix4.hpp>
-#include <lvr2/texture/Texture.hpp>
-#include <lvr2/algorithm/Texturizer.hpp>
-
-//#include <lvr2/geometry/HalfEdgeMesh.hpp>
-#include <lvr2/geometry/BaseVector.hpp>
-#include <lvr2/geometry/Normal.hpp>
-//#include <lvr2/algorithm/FinalizeAlgorithms.hpp>
 #include <lvr2/geometry/BoundingBox.hpp>
-#include <lvr2/algorithm/NormalAlgorithms.hpp>
-#include <lvr2/algorithm/CleanupAlgorithms.hpp>
-#include <lvr2/algorithm/ClusterAlgorithms.hpp>
-#include <lvr2/algorithm/ClusterPainter.hpp>
-#include <lvr2/geometry/Handles.hpp>
-#include <lvr2/util/ClusterBiMap.hpp>
-
-#include <lvr2/reconstruction/AdaptiveKSearchSurface.hpp>
-#include <lvr2/reconstruction/BilinearFastBox.hpp>
-#include <lvr2/reconstruction/FastReconstruction.hpp>
-#include <lvr2/reconstruction/PointsetSurface.hpp>
-#include <lvr2/reconstruction/SearchTree.hpp>
-#include <lvr2/reconstruction/SearchTreeFlann.hpp>
-#include <lvr2/reconstruction/HashGrid.hpp>
-#include <lvr2/reconstruction/PointsetGrid.hpp>
 #include <lvr2/io/PointBuffer.hpp>
-#include <lvr2/util/Factories.hpp>
-#include <lvr2/util/Panic.hpp>
 
-#if defined CUDA_FOUND
-    #define GPU_FOUND
+namespace lvr_ros
+{
 
-    #include <lvr2/reconstruction/cuda/CudaSurface.hpp>
-    typedef lvr2::CudaSurface GpuSurface;
-#elif defined OPENCL_FOUND
-    #define GPU_FOUND
-    #include <lvr2/reconstruction/opencl/ClSurface.hpp>
-    typedef lvr2::ClSurface GpuSurface;
-#endif
+namespace
+{
 
-namespace lvr_ros
+std_msgs::Header cloudHeader(const sensor_msgs::PointCloud2& cloud)
 {
+    std_msgs::Header header;
+    header.frame_id = cloud.header.frame_id;
+    header.stamp = cloud.header.stamp;
+    return header;
+}
+
+/**
+ * A reused mesh keeps the header it was cached and stored with under its UUID, only the published
+ * messages carry the header of the current cloud. They are copied if the headers differ.
+ */
+template<typename MessageT>
+boost::shared_ptr<const MessageT> restamped(
+    const boost::shared_ptr<const MessageT>& message,
+    const std_msgs::Header& header
+)
+{
+    if (message->header.stamp == header.stamp && message->header.frame_id == header.frame_id)
+    {
+        return message;
+    }
+    boost::shared_ptr<MessageT> copy = boost::make_shared<MessageT>(*message);
+    copy->header = header;
+    return copy;
+}
+
+} // namespace
 
 /**********************************************************************************************************************/
 // Constructor
 
 Reconstruction::Reconstruction()
-    : as_(node_handle, "reconstruction", boost::bind(&Reconstruction::reconstruct, this, _1), false)
+    : as_(
+        node_handle,
+        "reconstruction",
+        boost::bind(&Reconstruction::goalCallback, this, _1),
+        boost::bind(&Reconstruction::cancelCallback, this, _1),
+        false
+    )
 {
     ros::NodeHandle nh("~");
 
+    // Setup the workers, they run goals and clouds of the topic concurrently
+    int num_workers, thread_budget, queue_size;
+    nh.param("workers", num_workers, 2);
+    nh.param("threadBudget", thread_budget, static_cast<int>(std::max(1u, std::thread::hardware_concurrency())));
+    nh.param("queueSize", queue_size, 8);
+
+    // Setup the mesh cache, the budget is given in MB
+    int cache_budget;
+    nh.param("cacheBudget", cache_budget, 1024);
+    mesh_cache.reset(new MeshCache(static_cast<size_t>(std::max(0, cache_budget)) * 1024 * 1024));
+
+    // Setup the mesh store, which keeps the meshes across restarts
+    std::string mesh_store_file;
+    int mesh_store_compression;
+    nh.param("meshStore", mesh_store_file, std::string());
+    nh.param("meshStoreCompression", mesh_store_compression, 0);
+    if (!mesh_store_file.empty())
+    {
+        mesh_store.reset(new MeshStore(mesh_store_file, mesh_store_compression));
+    }
+
+    // Setup the result cache, which answers repeated clouds with the same parameters without
+    // reconstructing them again. Its index may be persisted in a directory, the meshes it points
+    // to are read from the mesh store after a restart.
+    bool use_result_cache;
+    int result_cache_size;
+    std::string result_cache_dir;
+    nh.param("resultCache", use_result_cache, true);
+    nh.param("resultCacheSize", result_cache_size, 4096);
+    nh.param("resultCacheDir", result_cache_dir, std::string());
+    if (use_result_cache)
+    {
+        if (!result_cache_dir.empty() && !mesh_store)
+        {
+            ROS_WARN_STREAM("The result cache directory is set without a mesh store, "
+                "the results can not be reused after a restart.");
+        }
+        // a persisted result is only kept if its mesh can still be read from the mesh store
+        result_cache.reset(new ResultCache(
+            result_cache_dir,
+            static_cast<size_t>(std::max(1, result_cache_size)),
+            [this](const std::string& uuid) { return mesh_store && mesh_store->contains(uuid); }
+        ));
+    }
+
+    scheduler.reset(new ReconstructionScheduler(
+        static_cast<size_t>(std::max(1, num_workers)),
+        static_cast<size_t>(std::max(1, thread_budget)),
+        static_cast<size_t>(std::max(1, queue_size))
+    ));
+
     cloud_subscriber = node_handle.subscribe(
         "/pointcloud",
         1,
         &Reconstruction::pointCloudCallback,
         this
     );
+    // With latched topics, the geometry and attributes of the last mesh are available to late
+    // subscribers without calling the services
+    nh.param("latch", latch_topics, false);
+    int num_service_threads;
+    nh.param("serviceThreads", num_service_threads, 2);
+    service_threads = static_cast<size_t>(std::max(1, num_service_threads));
+
     mesh_publisher = node_handle.advertise<mesh_msgs::MeshGeometryStamped>("/mesh", 1);
-    mesh_geometry_publisher = node_handle.advertise<mesh_msgs::MeshGeometryStamped>("/mesh_geometry", 1);
+    mesh_geometry_publisher = node_handle.advertise<mesh_msgs::MeshGeometryStamped>("/mesh_geometry", 1, latch_topics);
+    mesh_materials_publisher = node_handle.advertise<mesh_msgs::MeshMaterialsStamped>("/mesh_materials", 1, latch_topics);
+    mesh_vertex_colors_publisher = node_handle.advertise<mesh_msgs::MeshVertexColorsStamped>(
+        "/mesh_vertex_colors",
+        1,
+        latch_topics
+    );
+
+    // Timing, sizes and throughput of every reconstruction
+    diagnostics_publisher = node_handle.advertise<diagnostic_msgs::DiagnosticArray>("/diagnostics", 10);
 
     // Setup dynamic reconfigure
     reconfigure_server_ptr = DynReconfigureServerPtr(new DynReconfigureServer(nh));
@@ -121,78 +200,230 @@ Reconstruction::Reconstruction()
 /**********************************************************************************************************************/
 // Actions & Services
 
-void Reconstruction::reconstruct(const lvr_ros::ReconstructGoalConstPtr& goal)
+Reconstruction::~Reconstruction()
+{
+    // stop the running reconstructions at their next checkpoint
+    {
+        std::lock_guard<std::recursive_mutex> lock(active_jobs_mutex);
+        for (auto& active_job : active_jobs)
+        {
+            active_job.second.progress->cancel();
+        }
+    }
+    scheduler->shutdown();
+
+    std::shared_ptr<TraceRecorder> trace = std::atomic_load(&service_trace);
+    if (trace)
+    {
+        writeTrace("services", getConfig().traceDir, *trace);
+    }
+}
+
+void Reconstruction::goalCallback(GoalHandle goal_handle)
+{
+    const std::string name = "goal " + goal_handle.getGoalID().id;
+    const ReconstructionConfig job_config = getConfig();
+
+    // report every stage as feedback of the goal
+    auto progress = std::make_shared<ReconstructionProgress>(
+        [goal_handle](ReconstructionProgress::Stage stage, float fraction) mutable
+        {
+            lvr_ros::ReconstructFeedback feedback;
+            feedback.stage = ReconstructionProgress::stageName(stage);
+            feedback.progress = fraction;
+            goal_handle.publishFeedback(feedback);
+        }
+    );
+
+    ReconstructionJob job;
+    job.name = name;
+    job.priority = ReconstructionJob::GOAL;
+    job.threads = static_cast<size_t>(std::max(1, job_config.threads));
+    job.run = [this, goal_handle, name, job_config, progress](size_t threads) mutable
+    {
+        ROS_INFO_STREAM("Starting " << name << " with " << threads << " threads.");
+        std::unique_ptr<TraceRecorder> trace(job_config.trace ? new TraceRecorder(name) : nullptr);
+        {
+            TraceRecorder::Activation activation(trace.get(), "worker");
+            goal_handle.setAccepted("Reconstructing.");
+            reconstruct(goal_handle, job_config, *progress);
+        }
+        if (trace)
+        {
+            writeTrace(name, job_config.traceDir, *trace);
+        }
+        removeActiveJob(name);
+    };
+    job.discard = [this, goal_handle, name](ReconstructionJob::DiscardReason reason) mutable
+    {
+        removeActiveJob(name);
+        if (reason == ReconstructionJob::CANCELED)
+        {
+            goal_handle.setCanceled(lvr_ros::ReconstructResult(), "Canceled while queued.");
+        }
+        else if (reason == ReconstructionJob::QUEUE_FULL)
+        {
+            goal_handle.setRejected(lvr_ros::ReconstructResult(), "The reconstruction queue is full.");
+        }
+        else
+        {
+            goal_handle.setRejected(lvr_ros::ReconstructResult(), "The reconstruction node is shutting down.");
+        }
+    };
+
+    // the job may finish or be discarded before submit returns, both wait for the lock
+    std::lock_guard<std::recursive_mutex> lock(active_jobs_mutex);
+    ReconstructionScheduler::JobId job_id = scheduler->submit(std::move(job));
+    if (job_id != 0)
+    {
+        active_jobs[name] = ActiveJob{job_id, progress};
+    }
+}
+
+void Reconstruction::cancelCallback(GoalHandle goal_handle)
+{
+    std::lock_guard<std::recursive_mutex> lock(active_jobs_mutex);
+    auto it = active_jobs.find("goal " + goal_handle.getGoalID().id);
+    if (it == active_jobs.end())
+    {
+        return;
+    }
+    // the progress is canceled as well in case the job has just been started
+    const ActiveJob active_job = it->second;
+    active_job.progress->cancel();
+    if (!scheduler->cancel(active_job.id))
+    {
+        ROS_INFO_STREAM("Canceling goal " << goal_handle.getGoalID().id << " during "
+            << ReconstructionProgress::stageName(active_job.progress->stage()) << ".");
+    }
+}
+
+void Reconstruction::removeActiveJob(const std::string& name)
+{
+    std::lock_guard<std::recursive_mutex> lock(active_jobs_mutex);
+    active_jobs.erase(name);
+}
+
+void Reconstruction::reconstruct(
+    GoalHandle goal_handle,
+    const ReconstructionConfig& config,
+    ReconstructionProgress& progress
+)
 {
     ROS_INFO("Action: Reconstruct");
+    const std::string name = "goal " + goal_handle.getGoalID().id;
     try
     {
         lvr_ros::ReconstructResult result;
-        mesh_msgs::MeshGeometryStamped mesh; // deprecated
-        createMeshMessageFromPointCloud(goal->cloud, mesh);
-        result.mesh = cache_mesh_geometry_stamped;
-        as_.setSucceeded(result, "Published mesh.");
+        CachedMeshConstPtr mesh;
+        ReconstructionTiming timing;
+        if (!createMeshMessageFromPointCloud(goal_handle.getGoal()->cloud, mesh, config, progress, timing))
+        {
+            result.statistics = diagnosticStatus(name, timing, progress, false);
+            publishDiagnostics(result.statistics);
+            if (progress.isCanceled())
+            {
+                goal_handle.setCanceled(result, "Canceled.");
+            }
+            else
+            {
+                goal_handle.setAborted(result, "Reconstruction failed.");
+            }
+            return;
+        }
+        const MeshBufferGeometryStamped& mesh_geometry = *mesh->geometry();
+        result.mesh.header = cloudHeader(goal_handle.getGoal()->cloud);
+        result.mesh.uuid = mesh_geometry.uuid;
+        {
+            ReconstructionTiming::Scope timer(timing, "message conversion");
+            fromMeshBufferToMeshGeometryMessage(mesh_geometry.mesh_buffer, result.mesh.mesh_geometry);
+        }
+        result.statistics = diagnosticStatus(name, timing, progress, true);
+        publishDiagnostics(result.statistics);
+        TraceRecorder::Span span("send result", "publish");
+        goal_handle.setSucceeded(result, "Published mesh.");
     }
     catch(std::exception& e)
     {
         ROS_ERROR_STREAM("Error: " << e.what());
-        as_.setAborted();
+        goal_handle.setAborted();
     }
 }
 
 bool Reconstruction::service_getGeometry(
     mesh_msgs::GetGeometry::Request& req,
-    mesh_msgs::GetGeometry::Response& res
+    MeshBufferGetGeometryResponse& res
 )
 {
     ROS_INFO("Service: Get Geometry");
-    if (!cache_initialized || req.uuid != cache_uuid)
+    setThreadLimit(service_threads);
+    const std::shared_ptr<TraceRecorder> trace = std::atomic_load(&service_trace);
+    TraceRecorder::Activation activation(trace.get(), "service");
+    TraceRecorder::Span span("get_geometry", "service");
+    CachedMeshConstPtr mesh = getMesh(req.uuid);
+    if (!mesh)
     {
         return false;
     }
-    res.mesh_geometry_stamped = cache_mesh_geometry_stamped;
+    res.mesh_geometry_stamped = *mesh->geometry();
     return true;
 }
 
 bool Reconstruction::service_getMaterials(
     mesh_msgs::GetMaterials::Request& req,
-    mesh_msgs::GetMaterials::Response& res
+    SharedGetMaterialsResponse& res
 )
 {
     ROS_INFO("Service: Get Materials");
-    if (!cache_initialized || req.uuid != cache_uuid)
+    setThreadLimit(service_threads);
+    const std::shared_ptr<TraceRecorder> trace = std::atomic_load(&service_trace);
+    TraceRecorder::Activation activation(trace.get(), "service");
+    TraceRecorder::Span span("get_materials", "service");
+    CachedMeshConstPtr mesh = getMesh(req.uuid);
+    if (!mesh)
     {
         return false;
     }
-    res.mesh_materials_stamped = cache_mesh_materials_stamped;
-    return true;
+    res.message = mesh->materials();
+    return res.message != nullptr;
 }
 
 bool Reconstruction::service_getTexture(
     mesh_msgs::GetTexture::Request& req,
-    mesh_msgs::GetTexture::Response& res
+    SharedGetTextureResponse& res
 )
 {
     ROS_INFO("Service: Get Texture");
-    if (!cache_initialized || req.uuid != cache_uuid || req.texture_index > cache_textures.size() - 1)
+    setThreadLimit(service_threads);
+    const std::shared_ptr<TraceRecorder> trace = std::atomic_load(&service_trace);
+    TraceRecorder::Activation activation(trace.get(), "service");
+    TraceRecorder::Span span("get_texture", "service");
+    CachedMeshConstPtr mesh = getMesh(req.uuid);
+    if (!mesh)
     {
         return false;
     }
-    res.texture = cache_textures.at(req.texture_index);
-    return true;
+    res.message = mesh->texture(req.texture_index);
+    return res.message != nullptr;
 }
 
 bool Reconstruction::service_getVertexColors(
     mesh_msgs::GetVertexColors::Request& req,
-    mesh_msgs::GetVertexColors::Response& res
+    SharedGetVertexColorsResponse& res
 )
 {
     ROS_INFO("Service: Get Vertex Colors");
-    if (!cache_initialized || req.uuid != cache_uuid)
+    setThreadLimit(service_threads);
+    const std::shared_ptr<TraceRecorder> trace = std::atomic_load(&service_trace);
+    TraceRecorder::Activation activation(trace.get(), "service");
+    TraceRecorder::Span span("get_vertex_colors", "service");
+    CachedMeshConstPtr mesh = getMesh(req.uuid);
+    if (!mesh)
     {
         return false;
     }
-    res.mesh_vertex_colors_stamped = cache_mesh_vertex_colors_stamped;
-    return true;
+    res.message = mesh->vertexColors();
+    return res.message != nullptr;
 }
 /*
 bool Reconstruction::service_getUUID(
@@ -214,23 +445,204 @@ bool Reconstruction::service_getUUID(
 
 void Reconstruction::pointCloudCallback(const sensor_msgs::PointCloud2::ConstPtr& cloud)
 {
-    mesh_msgs::MeshGeometryStamped mesh;
-    if (!createMeshMessageFromPointCloud(*cloud, mesh))
+    const std::string name = "cloud " + std::to_string(++num_clouds);
+    const ReconstructionConfig job_config = getConfig();
+    auto progress = std::make_shared<ReconstructionProgress>();
+
+    // a newer cloud replaces a cloud which is still waiting
+    ReconstructionJob job;
+    job.name = name;
+    job.priority = ReconstructionJob::TOPIC;
+    job.supersedable = true;
+    job.threads = static_cast<size_t>(std::max(1, job_config.threads));
+    job.run = [this, cloud, name, job_config, progress](size_t threads)
+    {
+        ROS_INFO_STREAM("Starting " << name << " with " << threads << " threads.");
+        std::unique_ptr<TraceRecorder> trace(job_config.trace ? new TraceRecorder(name) : nullptr);
+        {
+            TraceRecorder::Activation activation(trace.get(), "worker");
+            reconstructCloud(name, cloud, job_config, *progress);
+        }
+        if (trace)
+        {
+            writeTrace(name, job_config.traceDir, *trace);
+        }
+        removeActiveJob(name);
+    };
+    job.discard = [this, name](ReconstructionJob::DiscardReason)
+    {
+        removeActiveJob(name);
+    };
+
+    std::lock_guard<std::recursive_mutex> lock(active_jobs_mutex);
+    ReconstructionScheduler::JobId job_id = scheduler->submit(std::move(job));
+    if (job_id != 0)
     {
-        ROS_ERROR_STREAM("Error in PointCloud callback");
+        active_jobs[name] = ActiveJob{job_id, progress};
+    }
+}
+
+void Reconstruction::reconstructCloud(
+    const std::string& name,
+    const sensor_msgs::PointCloud2::ConstPtr& cloud,
+    const ReconstructionConfig& config,
+    ReconstructionProgress& progress
+)
+{
+    CachedMeshConstPtr cached_mesh;
+    ReconstructionTiming timing;
+    if (!createMeshMessageFromPointCloud(*cloud, cached_mesh, config, progress, timing))
+    {
+        if (!progress.isCanceled())
+        {
+            ROS_ERROR_STREAM("Error in PointCloud callback");
+        }
+        publishDiagnostics(diagnosticStatus(name, timing, progress, false));
+        return;
     }
 
     ROS_INFO_STREAM("Publish mesh geometry");
 
     // Reconstruction is done, publish TriangleMesh (deprecated!)
+    TraceRecorder::Span publish_span("publish geometry", "publish");
+    const std_msgs::Header header = cloudHeader(*cloud);
+    mesh_msgs::MeshGeometryStamped mesh;
+    mesh.header = header;
     mesh_publisher.publish(mesh);
-    // .. and also publish MeshGeometry (new! use this)
-    mesh_geometry_publisher.publish(cache_mesh_geometry_stamped);
+    // .. and also publish MeshGeometry (new! use this) and the attributes. The cached messages are
+    // published as shared pointers, so they are neither copied nor serialized for local subscribers.
+    // The attributes are only built if someone listens, or may listen later on a latched topic.
+    mesh_geometry_publisher.publish(restamped(cached_mesh->geometry(), header));
+    publish_span.stop();
+    ReconstructionTiming::Scope timer(timing, "message conversion");
+    if (latch_topics || mesh_materials_publisher.getNumSubscribers() > 0)
+    {
+        TraceRecorder::Span span("publish materials", "publish");
+        mesh_materials_publisher.publish(restamped(cached_mesh->materials(), header));
+    }
+    if (latch_topics || mesh_vertex_colors_publisher.getNumSubscribers() > 0)
+    {
+        TraceRecorder::Span span("publish vertex colors", "publish");
+        mesh_vertex_colors_publisher.publish(restamped(cached_mesh->vertexColors(), header));
+    }
+    timer.stop();
+
+    publishDiagnostics(diagnosticStatus(name, timing, progress, true));
+}
+
+diagnostic_msgs::DiagnosticStatus Reconstruction::diagnosticStatus(
+    const std::string& name,
+    const ReconstructionTiming& timing,
+    const ReconstructionProgress& progress,
+    bool success
+) const
+{
+    diagnostic_msgs::DiagnosticStatus status;
+    status.name = "lvr_ros: reconstruction";
+    status.hardware_id = ros::this_node::getName();
+    if (success)
+    {
+        status.level = diagnostic_msgs::DiagnosticStatus::OK;
+        status.message = name + ": " + timing.summary();
+    }
+    else if (progress.isCanceled())
+    {
+        status.level = diagnostic_msgs::DiagnosticStatus::WARN;
+        status.message = name + " canceled during " + ReconstructionProgress::stageName(progress.stage());
+    }
+    else
+    {
+        status.level = diagnostic_msgs::DiagnosticStatus::ERROR;
+        status.message = name + " failed during " + ReconstructionProgress::stageName(progress.stage());
+    }
+    timing.toDiagnosticStatus(status);
+    return status;
+}
+
+void Reconstruction::writeTrace(const std::string& name, const std::string& directory, const TraceRecorder& trace)
+{
+    std::string file_name = name;
+    std::replace_if(file_name.begin(), file_name.end(), [](char c) { return !std::isalnum(static_cast<unsigned char>(c)); }, '_');
+    const auto now = std::chrono::system_clock::now().time_since_epoch();
+    const std::string path = (directory.empty() ? std::string(".") : directory) + "/trace_" + file_name + "_"
+        + std::to_string(std::chrono::duration_cast<std::chrono::milliseconds>(now).count()) + ".json";
+
+    if (trace.write(path))
+    {
+        ROS_INFO_STREAM("Wrote the trace of " << name << " with " << trace.numEvents() << " spans to " << path << ".");
+    }
+    else
+    {
+        ROS_ERROR_STREAM("Could not write the trace of " << name << " to " << path << "!");
+    }
+}
+
+void Reconstruction::publishDiagnostics(const diagnostic_msgs::DiagnosticStatus& status)
+{
+    if (status.level == diagnostic_msgs::DiagnosticStatus::OK)
+    {
+        ROS_INFO_STREAM(status.message);
+    }
+    diagnostic_msgs::DiagnosticArray diagnostics;
+    diagnostics.header.stamp = ros::Time::now();
+    diagnostics.status.push_back(status);
+    diagnostics_publisher.publish(diagnostics);
+}
+
+CachedMeshConstPtr Reconstruction::findResult(uint64_t key)
+{
+    const std::string uuid = result_cache->find(key);
+    if (uuid.empty())
+    {
+        return CachedMeshConstPtr();
+    }
+
+    // the mesh may have been evicted from the memory, then it is read from the mesh store
+    CachedMeshConstPtr mesh = getMesh(uuid);
+    if (!mesh)
+    {
+        result_cache->erase(key, uuid);
+    }
+    return mesh;
+}
+
+CachedMeshConstPtr Reconstruction::getMesh(const std::string& uuid)
+{
+    CachedMeshConstPtr mesh = mesh_cache->get(uuid);
+    if (!mesh && mesh_store)
+    {
+        mesh = mesh_store->load(uuid);
+        if (mesh)
+        {
+            ROS_INFO_STREAM("Loaded mesh " << uuid << " from the mesh store.");
+            mesh_cache->insert(mesh);
+        }
+    }
+    return mesh;
 }
 
 void Reconstruction::reconfigureCallback(lvr_ros::ReconstructionConfig& config, uint32_t level)
 {
+    std::lock_guard<std::mutex> lock(config_mutex);
     this->config = config;
+
+    // The service calls are traced from enabling the tracing until it is disabled again
+    std::shared_ptr<TraceRecorder> trace = std::atomic_load(&service_trace);
+    if (config.trace && !trace)
+    {
+        std::atomic_store(&service_trace, std::make_shared<TraceRecorder>("services"));
+    }
+    else if (!config.trace && trace)
+    {
+        std::atomic_store(&service_trace, std::shared_ptr<TraceRecorder>());
+        writeTrace("services", config.traceDir, *trace);
+    }
+}
+
+ReconstructionConfig Reconstruction::getConfig()
+{
+    std::lock_guard<std::mutex> lock(config_mutex);
+    return config;
 }
 
 /**********************************************************************************************************************/
@@ -238,9 +650,34 @@ void Reconstruction::reconfigureCallback(lvr_ros::ReconstructionConfig& config,
 
 bool Reconstruction::createMeshMessageFromPointCloud(
     const sensor_msgs::PointCloud2& cloud,
-    mesh_msgs::MeshGeometryStamped& mesh_msg
+    CachedMeshConstPtr& mesh,
+    const ReconstructionConfig& config,
+    ReconstructionProgress& progress,
+    ReconstructionTiming& timing
 )
 {
+    timing.setInputSize(cloud.width * cloud.height);
+
+    // Answer a cloud which has been reconstructed with the same parameters before
+    uint64_t result_key = 0;
+    if (result_cache)
+    {
+        ReconstructionTiming::Scope timer(timing, "result lookup");
+        result_key = ResultCache::key(cloud, config);
+        mesh = findResult(result_key);
+        timer.stop();
+        if (mesh)
+        {
+            // the mesh keeps its header, the caller publishes it with the header of the current cloud
+            const lvr2::MeshBufferPtr& mesh_buffer = mesh->geometry()->mesh_buffer;
+            timing.setReused(true);
+            timing.setOutputSize(mesh_buffer->numVertices(), mesh_buffer->numFaces());
+            ROS_INFO_STREAM("Reusing mesh " << mesh->uuid() << ", it was reconstructed from the same cloud "
+                "and parameters.");
+            return true;
+        }
+    }
+
     // Generate uuid for new mesh
     boost::uuids::uuid boost_uuid = boost::uuids::random_generator()();
     std::string uuid = boost::lexical_cast<std::string>(boost_uuid);
@@ -258,10 +695,21 @@ bool Reconstruction::createMeshMessageFromPointCloud(
      */
 
 
+    if (!progress.enter(ReconstructionProgress::POINT_CONVERSION))
+    {
+        return false;
+    }
+
     PointBufferPtr point_buffer_ptr(new PointBuffer);
     lvr2::MeshBufferPtr mesh_buffer_ptr(new lvr2::MeshBuffer);
 
-    if (!lvr_ros::fromPointCloud2ToPointBuffer(cloud, *point_buffer_ptr))
+    lvr2::BoundingBox<Vec> bounding_box;
+    size_t num_dropped = 0;
+    ReconstructionTiming::Scope conversion_timer(timing, "point conversion");
+    const bool converted = lvr_ros::fromPointCloud2ToPointBuffer(
+        cloud, *point_buffer_ptr, bounding_box, config.removeNonFinite, &num_dropped);
+    conversion_timer.stop();
+    if (!converted)
     {
         ROS_ERROR_STREAM(
             "Could not convert point cloud from \"sensor_msgs::PointCloud2\" "
@@ -269,283 +717,49 @@ bool Reconstruction::createMeshMessageFromPointCloud(
         );
         return false;
     }
-    if (!createMeshBufferFromPointBuffer(point_buffer_ptr, mesh_buffer_ptr))
+    if (num_dropped > 0)
     {
-        ROS_ERROR_STREAM("Reconstruction failed!");
-        return false;
+        ROS_INFO_STREAM("Removed " << num_dropped << " of " << cloud.width * cloud.height
+            << " points with non-finite coordinates.");
     }
-    if (!lvr_ros::fromMeshBufferToMeshMessages(
-            mesh_buffer_ptr,
-            cache_mesh_geometry_stamped.mesh_geometry,
-            cache_mesh_materials_stamped.mesh_materials,
-            cache_mesh_vertex_colors_stamped.mesh_vertex_colors,
-            cache_textures,
-            uuid
-    ))
+    if (point_buffer_ptr->numPoints() == 0)
     {
-        ROS_ERROR_STREAM("Could not convert \"lvr2::MeshBuffer\" to mesh messages!");
+        ROS_ERROR_STREAM("The point cloud contains no valid points!");
         return false;
     }
-
-
-    // Setting header frame and stamp for TriangleMesh
-    mesh_msg.header.frame_id = cloud.header.frame_id;
-    mesh_msg.header.stamp = cloud.header.stamp;
-
-    // The following segment will update new MeshGeometry and MeshAttribute messages in cache
-    // These messages will be available via action/service
-    cache_initialized = true;
-
-    // Setting header frame and stamp
-    cache_mesh_geometry_stamped.header.frame_id = cloud.header.frame_id;
-    cache_mesh_geometry_stamped.header.stamp = cloud.header.stamp;
-    cache_mesh_materials_stamped.header.frame_id = cloud.header.frame_id;
-    cache_mesh_materials_stamped.header.stamp = cloud.header.stamp;
-    cache_mesh_vertex_colors_stamped.header.frame_id = cloud.header.frame_id;
-    cache_mesh_vertex_colors_stamped.header.stamp = cloud.header.stamp;
-
-    cache_mesh_geometry_stamped.uuid = uuid;
-    cache_mesh_materials_stamped.uuid = uuid;
-    cache_mesh_vertex_colors_stamped.uuid = uuid;
-
-    cache_uuid = uuid;
-
-    return true;
-}
-
-bool Reconstruction::createMeshBufferFromPointBuffer(
-    PointBufferPtr& point_buffer,
-    lvr2::MeshBufferPtr& mesh_buffer
-)
-{
-    // Create a point cloud manager
-    string pcm_name = config.pcm;
-    lvr2::PointsetSurfacePtr<Vec> surface;
-    bool use_gpu = config.useGPU;
-
-    // Create point set surface object
-    if (pcm_name == "PCL")
-    {
-        lvr2::panic("PCL not supported right now!");
-    }
-    else if (
-        pcm_name == "STANN" ||
-        pcm_name == "FLANN" ||
-        pcm_name == "NABO" ||
-        pcm_name == "NANOFLANN"
-        )
-    {
-        surface = make_shared < lvr2::AdaptiveKSearchSurface < Vec >> (
-            point_buffer,
-            pcm_name,
-            config.kn,
-            config.ki,
-            config.kd,
-            config.ransac
-        );
-    }
-    else
+    timing.setInputSize(point_buffer_ptr->numPoints());
+    if (!reconstructMeshBuffer(point_buffer_ptr, mesh_buffer_ptr, config, progress, timing))
     {
-        ROS_ERROR_STREAM("Unable to create PointCloudManager.");
-        ROS_ERROR_STREAM("Unknown option '" << pcm_name << "'.");
-        ROS_ERROR_STREAM("Available PCMs are: ");
-        ROS_ERROR_STREAM("STANN, STANN_RANSAC, PCL");
-        return 0;
-    }
-
-    // Set search config for normal estimation and distance evaluation
-    surface->setKd(config.kd);
-    surface->setKi(config.ki);
-    surface->setKn(config.kn);
-
-    // Calculate normals if necessary
-    if (!point_buffer->hasNormals() || config.recalcNormals)
-    {
-        if(use_gpu){
-            #ifdef GPU_FOUND
-                size_t num_points = point_buffer->numPoints();
-                lvr2::floatArr points = point_buffer->getPointArray();
-                lvr2::floatArr normals = lvr2::floatArr(new float[ num_points * 3 ]);
-                ROS_INFO_STREAM("Generate GPU kd-tree...");
-                GpuSurface gpu_surface(points, num_points);
-                ROS_INFO_STREAM("GPU kd-tree done.");
-
-                gpu_surface.setKn(config.kn);
-                gpu_surface.setKi(config.ki);
-                gpu_surface.setFlippoint(config.flipx, config.flipy, config.flipz);
-                ROS_INFO_STREAM("Start normal calculation...");
-                gpu_surface.calculateNormals();
-                gpu_surface.getNormals(normals);
-                ROS_INFO_STREAM("Normal computation done.");
-
-                point_buffer->setNormalArray(normals, num_points * 3);
-                gpu_surface.freeGPU();
-            #else
-                ROS_ERROR("\"use_gpu\" is active, but GPU driver not installed!");
-                surface->calculateSurfaceNormals();
-            #endif
-        }
-        else
+        if (!progress.isCanceled())
         {
-            surface->calculateSurfaceNormals();
+            ROS_ERROR_STREAM("Reconstruction failed!");
         }
+        return false;
     }
-    else
-    {
-        ROS_INFO_STREAM("Using given normals.");
-    }
-
-    // Create an empty mesh
-    lvr2::HalfEdgeMesh <Vec> mesh;
-
-    // Determine whether to use intersections or voxelsize
-    float resolution;
-    bool useVoxelsize;
-    if (config.intersections > 0)
-    {
-        resolution = config.intersections;
-        useVoxelsize = false;
-    }
-    else
-    {
-        resolution = config.voxelsize;
-        useVoxelsize = true;
-    }
-
-    // Create a point set grid for reconstruction
-    string decomposition = config.decomposition;
-
-    // Fail safe check
-    if (decomposition != "MC" && decomposition != "PMC" && decomposition != "SF")
-    {
-        ROS_ERROR_STREAM("Unsupported decomposition type " << decomposition << ". Defaulting to PMC.");
-        decomposition = "PMC";
-    }
-
-    shared_ptr <lvr2::GridBase> grid;
-    unique_ptr <lvr2::FastReconstructionBase<Vec>> reconstruction;
-    if (decomposition == "MC")
-    {
-        lvr2::panic("MC decomposition type not supported right now!");
-    }
-    else if (decomposition == "PMC")
-    {
-        lvr2::BilinearFastBox<Vec>::m_surface = surface;
-        auto ps_grid = std::make_shared<lvr2::PointsetGrid<Vec, lvr2::BilinearFastBox<Vec>>>(
-            resolution,
-            surface,
-            surface->getBoundingBox(),
-            useVoxelsize,
-            !config.noExtrusion
-        );
-        ps_grid->calcDistanceValues();
-        grid = ps_grid;
-        reconstruction = make_unique<lvr2::FastReconstruction<Vec, lvr2::BilinearFastBox<Vec>>>(ps_grid);
-    }
-    else if (decomposition == "SF")
-    {
-        lvr2::panic("SF decomposition type not supported right now!");
-    }
-
-    // Create mesh
-    reconstruction->getMesh(mesh);
-
-
-    // =======================================================================
-    // Optimize and finalize mesh
-    // =======================================================================
-    if(config.rda != 0)
-    {
-        removeDanglingCluster(mesh, static_cast<size_t>(config.rda));
-    }
-
-    // Magic number from lvr1 `cleanContours`...
-    cleanContours(mesh, config.cleanContours, 0.0001);
-
-    naiveFillSmallHoles(mesh, static_cast<size_t>(config.fillHoles), false);
-
-    auto faceNormals = calcFaceNormals(mesh);
-
-    lvr2::ClusterBiMap <lvr2::FaceHandle> clusterBiMap;
-    if (config.optimizePlanes)
-    {
-        clusterBiMap = iterativePlanarClusterGrowing(
-            mesh,
-            faceNormals,
-            config.pnt,
-            config.planeIterations,
-            config.mp
-        );
+    timing.setOutputSize(mesh_buffer_ptr->numVertices(), mesh_buffer_ptr->numFaces());
 
-        if (config.smallRegionThreshold > 0)
-        {
-            deleteSmallPlanarCluster(
-                mesh,
-                clusterBiMap,
-                static_cast<size_t>(config.smallRegionThreshold)
-            );
-        }
-    }
-    else
+    if (!progress.enter(ReconstructionProgress::MESH_CONVERSION))
     {
-        clusterBiMap = planarClusterGrowing(mesh, faceNormals, config.pnt);
+        return false;
     }
-
-    // Calc normaBaseVecTls for vertices
-    auto vertexNormals = calcVertexNormals(mesh, faceNormals, *surface);
-
-    // Prepare color data for finalizing
-    auto vertexColors = calcColorFromPointCloud(mesh, surface);
-
-    // When using textures ...
-    if (config.generateTextures)
+    const std_msgs::Header header = cloudHeader(cloud);
+
+    // The following segment will add the new mesh to the cache, its MeshGeometry and MeshAttribute
+    // messages will be available via action/service. Only the geometry is streamed from the buffer
+    // right away, the attribute messages are built when they are requested for the first time.
+    ReconstructionTiming::Scope caching_timer(timing, "caching");
+    auto cached_mesh = std::make_shared<CachedMesh>(uuid, header, mesh_buffer_ptr);
+    mesh_cache->insert(cached_mesh);
+    if (mesh_store)
     {
-        // Prepare finalize algorithm
-        lvr2::TextureFinalizer<Vec> finalize(clusterBiMap);
-        finalize.setVertexNormals(vertexNormals);
-        if (vertexColors)
-        {
-            finalize.setVertexColors(*vertexColors);
-        }
-
-        // Materializer for face materials (colors and/or textures)
-        lvr2::Materializer<Vec> materializer(
-            mesh,
-            clusterBiMap,
-            faceNormals,
-            *surface
-        );
-
-        // Set texturizer
-        //old version
-        lvr2::Texturizer<Vec> texturizer(
-            config.texelSize,
-            config.texMinClusterSize,
-            config.texMaxClusterSize
-        );
-
-        // new version versuch
-        //auto texturizer = lvr2::Texturizer<Vec>>(new lvr2::Texturizer<Vec>( config.texelSize,config.texMinClusterSize,config.texMaxClusterSize));
-
-
-        materializer.setTexturizer(texturizer);
-
-        // Generate materials
-        lvr2::MaterializerResult<Vec> matResult = materializer.generateMaterials();
-        // Add data to finalize algorithm
-        finalize.setMaterializerResult(matResult);
-
-        mesh_buffer = finalize.apply(mesh);
+        mesh_store->store(cached_mesh);
     }
-    else
+    if (result_cache)
     {
-        // Finalize mesh (convert it to simple `MeshBuffer`)
-        lvr2::SimpleFinalizer<Vec> finalize;
-        finalize.setNormalData(vertexNormals);
-        mesh_buffer = finalize.apply(mesh);
+        result_cache->insert(result_key, uuid);
     }
+    mesh = cached_mesh;
 
-    ROS_INFO_STREAM("Reconstruction finished!");
     return true;
 }
 
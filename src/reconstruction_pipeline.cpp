@@ -0,0 +1,561 @@
+/*
+ * UOS-ROS packages - Robot Operating System code by the University of Osnabrück
+ * Copyright (C) 2013 University of Osnabrück
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * reconstruction_pipeline.cpp
+ *
+ */
+
+#include "lvr_ros/reconstruction_pipeline.h"
+#include "lvr_ros/thread_budget.h"
+#include "lvr_ros/trace_recorder.h"
+#include "lvr_ros/voxel_filter.h"
+
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+
+#include <dynamic_reconfigure/Config.h>
+#include <ros/console.h>
+
+#include <lvr2/io/PLYIO.hpp>
+#include <lvr2/config/lvropenmp.hpp>
+#include <lvr2/geometry/Matrix4.hpp>
+#include <lvr2/texture/Texture.hpp>
+#include <lvr2/algorithm/Texturizer.hpp>
+
+//#include <lvr2/geometry/HalfEdgeMesh.hpp>
+#include <lvr2/geometry/BaseVector.hpp>
+#include <lvr2/geometry/Normal.hpp>
+//#include <lvr2/algorithm/FinalizeAlgorithms.hpp>
+#include <lvr2/geometry/BoundingBox.hpp>
+#include <lvr2/algorithm/NormalAlgorithms.hpp>
+#include <lvr2/algorithm/CleanupAlgorithms.hpp>
+#include <lvr2/algorithm/ClusterAlgorithms.hpp>
+#include <lvr2/algorithm/ClusterPainter.hpp>
+#include <lvr2/geometry/Handles.hpp>
+#include <lvr2/util/ClusterBiMap.hpp>
+
+#include <lvr2/reconstruction/AdaptiveKSearchSurface.hpp>
+#include <lvr2/reconstruction/BilinearFastBox.hpp>
+#include <lvr2/reconstruction/FastReconstruction.hpp>
+#include <lvr2/reconstruction/PointsetSurface.hpp>
+#include <lvr2/reconstruction/SearchTree.hpp>
+#include <lvr2/reconstruction/SearchTreeFlann.hpp>
+#include <lvr2/reconstruction/HashGrid.hpp>
+#include <lvr2/reconstruction/PointsetGrid.hpp>
+#include <lvr2/io/PointBuffer.hpp>
+#include <lvr2/util/Factories.hpp>
+#include <lvr2/util/Panic.hpp>
+
+#if defined CUDA_FOUND
+    #define GPU_FOUND
+
+    #include <lvr2/reconstruction/cuda/CudaSurface.hpp>
+    typedef lvr2::CudaSurface GpuSurface;
+#elif defined OPENCL_FOUND
+    #define GPU_FOUND
+    #include <lvr2/reconstruction/opencl/ClSurface.hpp>
+    typedef lvr2::ClSurface GpuSurface;
+#endif
+
+namespace lvr_ros
+{
+
+using Vec = lvr2::BaseVector<float>;
+
+namespace
+{
+
+// leaf size of the downsampling relative to the voxelsize, if no leafSize is given
+const double DEFAULT_LEAF_RATIO = 0.25;
+
+// lvr2::BilinearFastBox reads the surface from a static member while the mesh is extracted
+std::mutex bilinear_fast_box_mutex;
+
+std::string trim(const std::string& value)
+{
+    const size_t first = value.find_first_not_of(" \t\r");
+    const size_t last = value.find_last_not_of(" \t\r");
+    return first == std::string::npos ? std::string() : value.substr(first, last - first + 1);
+}
+
+// Removes a trailing comment and the quotes of a YAML scalar
+std::string yamlScalar(const std::string& text)
+{
+    std::string value = trim(text);
+    if (!value.empty() && (value[0] == '"' || value[0] == '\''))
+    {
+        const size_t end = value.find(value[0], 1);
+        return value.substr(1, end == std::string::npos ? std::string::npos : end - 1);
+    }
+    const size_t comment = value.find('#');
+    return trim(comment == std::string::npos ? value : value.substr(0, comment));
+}
+
+} // namespace
+
+bool reconstructMeshBuffer(
+    lvr2::PointBufferPtr& input_buffer,
+    lvr2::MeshBufferPtr& mesh_buffer,
+    const ReconstructionConfig& config,
+    ReconstructionProgress& progress,
+    ReconstructionTiming& timing
+)
+{
+    ScopedThreadLimit thread_limit(static_cast<size_t>(std::max(1, config.threads)));
+
+    // the downsampled points replace the input only within the pipeline, the caller keeps its buffer
+    lvr2::PointBufferPtr point_buffer = input_buffer;
+
+    if (config.downsample)
+    {
+        const double leaf_size = config.leafSize > 0 ? config.leafSize : config.voxelsize * DEFAULT_LEAF_RATIO;
+        ReconstructionTiming::Scope timer(timing, "downsampling");
+        lvr2::PointBufferPtr downsampled;
+        if (leaf_size > 0 && voxelDownsample(point_buffer, leaf_size, downsampled))
+        {
+            ROS_INFO_STREAM("Downsampled " << point_buffer->numPoints() << " to " << downsampled->numPoints()
+                << " points with a leaf size of " << leaf_size << ".");
+            point_buffer = downsampled;
+        }
+        else
+        {
+            ROS_WARN_STREAM("Could not downsample the points with a leaf size of " << leaf_size << ", use all points.");
+        }
+    }
+
+    if (!progress.enter(ReconstructionProgress::NORMALS))
+    {
+        return false;
+    }
+
+    // Create a point cloud manager
+    std::string pcm_name = config.pcm;
+    lvr2::PointsetSurfacePtr<Vec> surface;
+    bool use_gpu = config.useGPU;
+
+    // Create point set surface object
+    if (pcm_name == "PCL")
+    {
+        lvr2::panic("PCL not supported right now!");
+    }
+    else if (
+        pcm_name == "STANN" ||
+        pcm_name == "FLANN" ||
+        pcm_name == "NABO" ||
+        pcm_name == "NANOFLANN"
+        )
+    {
+        ReconstructionTiming::Scope timer(timing, "search tree");
+        surface = std::make_shared < lvr2::AdaptiveKSearchSurface < Vec >> (
+            point_buffer,
+            pcm_name,
+            config.kn,
+            config.ki,
+            config.kd,
+            config.ransac
+        );
+    }
+    else
+    {
+        ROS_ERROR_STREAM("Unable to create PointCloudManager.");
+        ROS_ERROR_STREAM("Unknown option '" << pcm_name << "'.");
+        ROS_ERROR_STREAM("Available PCMs are: ");
+        ROS_ERROR_STREAM("STANN, STANN_RANSAC, PCL");
+        return 0;
+    }
+
+    // Set search config for normal estimation and distance evaluation
+    surface->setKd(config.kd);
+    surface->setKi(config.ki);
+    surface->setKn(config.kn);
+
+    // Calculate normals if necessary
+    if (!point_buffer->hasNormals() || config.recalcNormals)
+    {
+        if(use_gpu){
+            #ifdef GPU_FOUND
+                size_t num_points = point_buffer->numPoints();
+                lvr2::floatArr points = point_buffer->getPointArray();
+                lvr2::floatArr normals = lvr2::floatArr(new float[ num_points * 3 ]);
+                ROS_INFO_STREAM("Generate GPU kd-tree...");
+                ReconstructionTiming::Scope tree_timer(timing, "search tree");
+                GpuSurface gpu_surface(points, num_points);
+                tree_timer.stop();
+                ROS_INFO_STREAM("GPU kd-tree done.");
+                if (!progress.update(0.3f))
+                {
+                    return false;
+                }
+
+                gpu_surface.setKn(config.kn);
+                gpu_surface.setKi(config.ki);
+                gpu_surface.setFlippoint(config.flipx, config.flipy, config.flipz);
+                ROS_INFO_STREAM("Start normal calculation...");
+                ReconstructionTiming::Scope normals_timer(timing, "normal estimation");
+                gpu_surface.calculateNormals();
+                gpu_surface.getNormals(normals);
+                normals_timer.stop();
+                ROS_INFO_STREAM("Normal computation done.");
+
+                point_buffer->setNormalArray(normals, num_points * 3);
+                gpu_surface.freeGPU();
+            #else
+                ROS_ERROR("\"use_gpu\" is active, but GPU driver not installed!");
+                ReconstructionTiming::Scope timer(timing, "normal estimation");
+                surface->calculateSurfaceNormals();
+            #endif
+        }
+        else
+        {
+            ReconstructionTiming::Scope timer(timing, "normal estimation");
+            surface->calculateSurfaceNormals();
+        }
+    }
+    else
+    {
+        ROS_INFO_STREAM("Using given normals.");
+    }
+
+    if (!progress.enter(ReconstructionProgress::DISTANCE_VALUES))
+    {
+        return false;
+    }
+
+    // Create an empty mesh
+    lvr2::HalfEdgeMesh <Vec> mesh;
+
+    // Determine whether to use intersections or voxelsize
+    float resolution;
+    bool useVoxelsize;
+    if (config.intersections > 0)
+    {
+        resolution = config.intersections;
+        useVoxelsize = false;
+    }
+    else
+    {
+        resolution = config.voxelsize;
+        useVoxelsize = true;
+    }
+
+    // Create a point set grid for reconstruction
+    std::string decomposition = config.decomposition;
+
+    // Fail safe check
+    if (decomposition != "MC" && decomposition != "PMC" && decomposition != "SF")
+    {
+        ROS_ERROR_STREAM("Unsupported decomposition type " << decomposition << ". Defaulting to PMC.");
+        decomposition = "PMC";
+    }
+
+    std::shared_ptr <lvr2::GridBase> grid;
+    std::unique_ptr <lvr2::FastReconstructionBase<Vec>> reconstruction;
+    if (decomposition == "MC")
+    {
+        lvr2::panic("MC decomposition type not supported right now!");
+    }
+    else if (decomposition == "PMC")
+    {
+        ReconstructionTiming::Scope grid_timer(timing, "grid construction");
+        auto ps_grid = std::make_shared<lvr2::PointsetGrid<Vec, lvr2::BilinearFastBox<Vec>>>(
+            resolution,
+            surface,
+            surface->getBoundingBox(),
+            useVoxelsize,
+            !config.noExtrusion
+        );
+        grid_timer.stop();
+        if (!progress.update(0.3f))
+        {
+            return false;
+        }
+        ReconstructionTiming::Scope distance_timer(timing, "distance values");
+        ps_grid->calcDistanceValues();
+        distance_timer.stop();
+        grid = ps_grid;
+        reconstruction = std::make_unique<lvr2::FastReconstruction<Vec, lvr2::BilinearFastBox<Vec>>>(ps_grid);
+    }
+    else if (decomposition == "SF")
+    {
+        lvr2::panic("SF decomposition type not supported right now!");
+    }
+
+    if (!progress.enter(ReconstructionProgress::MARCHING))
+    {
+        return false;
+    }
+
+    // Create mesh, one job at a time as the surface of the boxes is shared
+    {
+        TraceRecorder::Span wait_span("wait for marching cubes", "lock");
+        std::lock_guard<std::mutex> lock(bilinear_fast_box_mutex);
+        wait_span.stop();
+        if (progress.isCanceled())
+        {
+            return false;
+        }
+        lvr2::BilinearFastBox<Vec>::m_surface = surface;
+        ReconstructionTiming::Scope timer(timing, "marching cubes");
+        reconstruction->getMesh(mesh);
+    }
+
+
+    // =======================================================================
+    // Optimize and finalize mesh
+    // =======================================================================
+    if (!progress.enter(ReconstructionProgress::CLEANUP))
+    {
+        return false;
+    }
+
+    ReconstructionTiming::Scope cleanup_timer(timing, "cleanup");
+    if(config.rda != 0)
+    {
+        removeDanglingCluster(mesh, static_cast<size_t>(config.rda));
+    }
+
+    // Magic number from lvr1 `cleanContours`...
+    if (!progress.update(0.3f))
+    {
+        return false;
+    }
+    cleanContours(mesh, config.cleanContours, 0.0001);
+
+    if (!progress.update(0.6f))
+    {
+        return false;
+    }
+    naiveFillSmallHoles(mesh, static_cast<size_t>(config.fillHoles), false);
+    cleanup_timer.stop();
+
+    if (!progress.enter(ReconstructionProgress::CLUSTERING))
+    {
+        return false;
+    }
+
+    ReconstructionTiming::Scope face_normals_timer(timing, "face normals");
+    auto faceNormals = calcFaceNormals(mesh);
+    face_normals_timer.stop();
+
+    ReconstructionTiming::Scope clustering_timer(timing, "cluster growing");
+    lvr2::ClusterBiMap <lvr2::FaceHandle> clusterBiMap;
+    if (config.optimizePlanes)
+    {
+        clusterBiMap = iterativePlanarClusterGrowing(
+            mesh,
+            faceNormals,
+            config.pnt,
+            config.planeIterations,
+            config.mp
+        );
+
+        if (!progress.update(0.8f))
+        {
+            return false;
+        }
+
+        if (config.smallRegionThreshold > 0)
+        {
+            deleteSmallPlanarCluster(
+                mesh,
+                clusterBiMap,
+                static_cast<size_t>(config.smallRegionThreshold)
+            );
+        }
+    }
+    else
+    {
+        clusterBiMap = planarClusterGrowing(mesh, faceNormals, config.pnt);
+    }
+    clustering_timer.stop();
+
+    if (!progress.enter(ReconstructionProgress::FINALIZE))
+    {
+        return false;
+    }
+
+    // Calc normaBaseVecTls for vertices
+    ReconstructionTiming::Scope vertex_normals_timer(timing, "vertex normals");
+    auto vertexNormals = calcVertexNormals(mesh, faceNormals, *surface);
+    vertex_normals_timer.stop();
+
+    // Prepare color data for finalizing
+    if (!progress.update(0.2f))
+    {
+        return false;
+    }
+    ReconstructionTiming::Scope colors_timer(timing, "color transfer");
+    auto vertexColors = calcColorFromPointCloud(mesh, surface);
+    colors_timer.stop();
+
+    if (!progress.update(0.4f))
+    {
+        return false;
+    }
+
+    // When using textures ...
+    if (config.generateTextures)
+    {
+        // Prepare finalize algorithm
+        lvr2::TextureFinalizer<Vec> finalize(clusterBiMap);
+        finalize.setVertexNormals(vertexNormals);
+        if (vertexColors)
+        {
+            finalize.setVertexColors(*vertexColors);
+        }
+
+        // Materializer for face materials (colors and/or textures)
+        lvr2::Materializer<Vec> materializer(
+            mesh,
+            clusterBiMap,
+            faceNormals,
+            *surface
+        );
+
+        // Set texturizer
+        //old version
+        lvr2::Texturizer<Vec> texturizer(
+            config.texelSize,
+            config.texMinClusterSize,
+            config.texMaxClusterSize
+        );
+
+        // new version versuch
+        //auto texturizer = lvr2::Texturizer<Vec>>(new lvr2::Texturizer<Vec>( config.texelSize,config.texMinClusterSize,config.texMaxClusterSize));
+
+
+        materializer.setTexturizer(texturizer);
+
+        // Generate materials
+        ReconstructionTiming::Scope materials_timer(timing, "materials and textures");
+        lvr2::MaterializerResult<Vec> matResult = materializer.generateMaterials();
+        materials_timer.stop();
+        if (!progress.update(0.8f))
+        {
+            return false;
+        }
+        // Add data to finalize algorithm
+        finalize.setMaterializerResult(matResult);
+
+        ReconstructionTiming::Scope timer(timing, "finalize");
+        mesh_buffer = finalize.apply(mesh);
+    }
+    else
+    {
+        // Finalize mesh (convert it to simple `MeshBuffer`)
+        lvr2::SimpleFinalizer<Vec> finalize;
+        finalize.setNormalData(vertexNormals);
+        ReconstructionTiming::Scope timer(timing, "finalize");
+        mesh_buffer = finalize.apply(mesh);
+    }
+
+    ROS_INFO_STREAM("Reconstruction finished!");
+    return true;
+}
+
+bool setConfigValue(ReconstructionConfig& config, const std::string& name, const std::string& value)
+{
+    // convert the value to the type of the parameter with the same name
+    for (const auto& description : ReconstructionConfig::__getParamDescriptions__())
+    {
+        if (description->name != name)
+        {
+            continue;
+        }
+        dynamic_reconfigure::Config message;
+        std::istringstream stream(value);
+        bool valid = true;
+        if (description->type == "bool")
+        {
+            dynamic_reconfigure::BoolParameter parameter;
+            parameter.name = name;
+            parameter.value = value == "true" || value == "True" || value == "TRUE";
+            valid = parameter.value || value == "false" || value == "False" || value == "FALSE";
+            message.bools.push_back(parameter);
+        }
+        else if (description->type == "int")
+        {
+            dynamic_reconfigure::IntParameter parameter;
+            parameter.name = name;
+            valid = static_cast<bool>(stream >> parameter.value);
+            message.ints.push_back(parameter);
+        }
+        else if (description->type == "double")
+        {
+            dynamic_reconfigure::DoubleParameter parameter;
+            parameter.name = name;
+            valid = static_cast<bool>(stream >> parameter.value);
+            message.doubles.push_back(parameter);
+        }
+        else
+        {
+            dynamic_reconfigure::StrParameter parameter;
+            parameter.name = name;
+            parameter.value = value;
+            message.strs.push_back(parameter);
+        }
+        if (!valid || !config.__fromMessage__(message))
+        {
+            ROS_ERROR_STREAM("Invalid value \"" << value << "\" of the parameter " << name << "!");
+            return false;
+        }
+        config.__clamp__();
+        return true;
+    }
+    ROS_ERROR_STREAM("Unknown parameter " << name << "!");
+    return false;
+}
+
+bool readConfigFile(const std::string& path, ReconstructionConfig& config)
+{
+    std::ifstream file(path);
+    if (!file)
+    {
+        ROS_ERROR_STREAM("Could not read the config file " << path << "!");
+        return false;
+    }
+
+    std::map<std::string, std::string> values;
+    std::string line;
+    while (std::getline(file, line))
+    {
+        const std::string content = trim(line);
+        const size_t colon = content.find(':');
+        if (content.empty() || content[0] == '#' || colon == std::string::npos)
+        {
+            continue;
+        }
+        values[trim(content.substr(0, colon))] = yamlScalar(content.substr(colon + 1));
+    }
+
+    for (const auto& description : ReconstructionConfig::__getParamDescriptions__())
+    {
+        auto it = values.find(description->name);
+        if (it != values.end() && !setConfigValue(config, it->first, it->second))
+        {
+            ROS_ERROR_STREAM("The config file " << path << " is invalid!");
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace lvr_ros
@@ -0,0 +1,116 @@
+/*
+ * UOS-ROS packages - Robot Operating System code by the University of Osnabrück
+ * Copyright (C) 2013 University of Osnabrück
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * reconstruction_progress.cpp
+ *
+ */
+
+#include "lvr_ros/reconstruction_progress.h"
+
+#include <algorithm>
+
+namespace lvr_ros
+{
+
+namespace
+{
+
+// rough share of every stage in the runtime of a typical reconstruction
+const float STAGE_WEIGHTS[ReconstructionProgress::NUM_STAGES] = {
+    0.02f,  // POINT_CONVERSION
+    0.30f,  // NORMALS
+    0.25f,  // DISTANCE_VALUES
+    0.15f,  // MARCHING
+    0.08f,  // CLEANUP
+    0.08f,  // CLUSTERING
+    0.07f,  // FINALIZE
+    0.05f   // MESH_CONVERSION
+};
+
+const char* STAGE_NAMES[ReconstructionProgress::NUM_STAGES] = {
+    "point conversion",
+    "normals",
+    "distance values",
+    "marching",
+    "cleanup",
+    "clustering",
+    "finalize",
+    "mesh conversion"
+};
+
+float stageStart(int stage)
+{
+    float start = 0.0f;
+    for (int i = 0; i < stage; i++)
+    {
+        start += STAGE_WEIGHTS[i];
+    }
+    return start;
+}
+
+} // namespace
+
+ReconstructionProgress::ReconstructionProgress(Callback callback)
+    : callback(callback),
+      canceled(false),
+      current_stage(POINT_CONVERSION)
+{
+}
+
+bool ReconstructionProgress::enter(Stage stage)
+{
+    current_stage = stage;
+    return update(0.0f);
+}
+
+bool ReconstructionProgress::update(float fraction)
+{
+    if (canceled)
+    {
+        return false;
+    }
+    if (callback)
+    {
+        const int stage = current_stage;
+        fraction = std::min(std::max(fraction, 0.0f), 1.0f);
+        callback(static_cast<Stage>(stage), stageStart(stage) + fraction * STAGE_WEIGHTS[stage]);
+    }
+    return !canceled;
+}
+
+void ReconstructionProgress::cancel()
+{
+    canceled = true;
+}
+
+bool ReconstructionProgress::isCanceled() const
+{
+    return canceled;
+}
+
+ReconstructionProgress::Stage ReconstructionProgress::stage() const
+{
+    return static_cast<Stage>(current_stage.load());
+}
+
+const char* ReconstructionProgress::stageName(Stage stage)
+{
+    return stage < NUM_STAGES ? STAGE_NAMES[stage] : "done";
+}
+
+} // namespace lvr_ros
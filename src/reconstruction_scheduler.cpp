@@ -0,0 +1,242 @@
+/*
+ * UOS-ROS packages - Robot Operating System code by the University of Osnabrück
+ * Copyright (C) 2013 University of Osnabrück
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * reconstruction_scheduler.cpp
+ *
+ */
+
+#include "lvr_ros/reconstruction_scheduler.h"
+#include "lvr_ros/thread_budget.h"
+
+#include <algorithm>
+#include <exception>
+
+#include <ros/console.h>
+
+namespace lvr_ros
+{
+
+ReconstructionScheduler::ReconstructionScheduler(size_t num_workers, size_t thread_budget, size_t max_queued)
+    : thread_budget(std::max<size_t>(1, thread_budget)),
+      max_queued(std::max<size_t>(1, max_queued))
+{
+    num_workers = std::max<size_t>(1, num_workers);
+    ROS_INFO_STREAM("Starting " << num_workers << " reconstruction workers with a budget of "
+        << this->thread_budget << " threads.");
+    workers.reserve(num_workers);
+    for (size_t i = 0; i < num_workers; i++)
+    {
+        workers.emplace_back(&ReconstructionScheduler::work, this);
+    }
+}
+
+ReconstructionScheduler::~ReconstructionScheduler()
+{
+    shutdown();
+}
+
+ReconstructionScheduler::JobId ReconstructionScheduler::submit(ReconstructionJob job)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    if (stopped)
+    {
+        lock.unlock();
+        if (job.discard)
+        {
+            job.discard(ReconstructionJob::SHUTDOWN);
+        }
+        return 0;
+    }
+
+    // a newer supersedable job replaces the waiting one of the same priority
+    auto victim = queue.end();
+    if (job.supersedable)
+    {
+        victim = std::find_if(queue.begin(), queue.end(), [&job](const QueuedJob& queued) {
+            return queued.job.supersedable && queued.job.priority == job.priority;
+        });
+    }
+
+    // otherwise make room in a full queue by dropping the oldest supersedable job of a lower priority
+    if (victim == queue.end() && queue.size() >= max_queued)
+    {
+        for (auto it = queue.begin(); it != queue.end(); ++it)
+        {
+            if (it->job.supersedable && it->job.priority < job.priority
+                && (victim == queue.end() || it->job.priority < victim->job.priority))
+            {
+                victim = it;
+            }
+        }
+        if (victim == queue.end())
+        {
+            lock.unlock();
+            ROS_WARN_STREAM("Reconstruction queue is full, rejecting " << job.name << ".");
+            if (job.discard)
+            {
+                job.discard(ReconstructionJob::QUEUE_FULL);
+            }
+            return 0;
+        }
+    }
+
+    ReconstructionJob superseded;
+    const bool has_superseded = victim != queue.end();
+    if (has_superseded)
+    {
+        superseded = std::move(victim->job);
+        queue.erase(victim);
+    }
+
+    // keep the queue ordered by priority, jobs of the same priority in submission order
+    const JobId id = next_id++;
+    auto position = std::find_if(queue.begin(), queue.end(),
+        [&job](const QueuedJob& queued) { return queued.job.priority < job.priority; });
+    ROS_INFO_STREAM("Queued " << job.name << " (" << queue.size() + 1 << " waiting, "
+        << num_running << " running).");
+    queue.insert(position, QueuedJob{id, std::move(job)});
+    lock.unlock();
+    condition.notify_all();
+
+    if (has_superseded)
+    {
+        ROS_INFO_STREAM("Dropped " << superseded.name << ", superseded by a newer job.");
+        if (superseded.discard)
+        {
+            superseded.discard(ReconstructionJob::SUPERSEDED);
+        }
+    }
+    return id;
+}
+
+bool ReconstructionScheduler::cancel(JobId id)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    auto it = std::find_if(queue.begin(), queue.end(), [id](const QueuedJob& queued) { return queued.id == id; });
+    if (it == queue.end())
+    {
+        return false;
+    }
+    ReconstructionJob job = std::move(it->job);
+    queue.erase(it);
+    lock.unlock();
+    condition.notify_all();
+
+    if (job.discard)
+    {
+        job.discard(ReconstructionJob::CANCELED);
+    }
+    return true;
+}
+
+void ReconstructionScheduler::shutdown()
+{
+    std::deque<QueuedJob> discarded;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (stopped)
+        {
+            return;
+        }
+        stopped = true;
+        discarded.swap(queue);
+    }
+    condition.notify_all();
+
+    for (auto& queued : discarded)
+    {
+        if (queued.job.discard)
+        {
+            queued.job.discard(ReconstructionJob::SHUTDOWN);
+        }
+    }
+    for (auto& worker : workers)
+    {
+        worker.join();
+    }
+}
+
+size_t ReconstructionScheduler::numQueued() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return queue.size();
+}
+
+size_t ReconstructionScheduler::numRunning() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return num_running;
+}
+
+size_t ReconstructionScheduler::threadBudget() const
+{
+    return thread_budget;
+}
+
+size_t ReconstructionScheduler::grantedThreads(const ReconstructionJob& job) const
+{
+    return std::min(std::max<size_t>(1, job.threads), thread_budget);
+}
+
+void ReconstructionScheduler::work()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true)
+    {
+        // only the head of the queue may start, so jobs start in queue order
+        condition.wait(lock, [this] {
+            return stopped
+                || (!queue.empty() && threads_in_use + grantedThreads(queue.front().job) <= thread_budget);
+        });
+        if (stopped)
+        {
+            return;
+        }
+
+        ReconstructionJob job = std::move(queue.front().job);
+        queue.pop_front();
+        const size_t threads = grantedThreads(job);
+        threads_in_use += threads;
+        num_running++;
+        lock.unlock();
+
+        ROS_INFO_STREAM("Starting " << job.name << " with " << threads << " threads.");
+        setThreadLimit(threads);
+        try
+        {
+            job.run(threads);
+        }
+        catch (std::exception& e)
+        {
+            ROS_ERROR_STREAM("Error in " << job.name << ": " << e.what());
+        }
+        catch (...)
+        {
+            ROS_ERROR_STREAM("Unknown error in " << job.name << ".");
+        }
+        // release the resources held by the job, e.g. its cloud, outside of the lock
+        job = ReconstructionJob();
+
+        lock.lock();
+        threads_in_use -= threads;
+        num_running--;
+        condition.notify_all();
+    }
+}
+
+} // namespace lvr_ros
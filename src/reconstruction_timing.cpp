@@ -0,0 +1,240 @@
+/*
+ * UOS-ROS packages - Robot Operating System code by the University of Osnabrück
+ * Copyright (C) 2013 University of Osnabrück
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * reconstruction_timing.cpp
+ *
+ */
+
+#include "lvr_ros/reconstruction_timing.h"
+#include "lvr_ros/trace_recorder.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include <diagnostic_msgs/KeyValue.h>
+
+namespace lvr_ros
+{
+
+namespace
+{
+
+// number of steps named in the summary
+const size_t SUMMARY_STEPS = 3;
+
+void addValue(diagnostic_msgs::DiagnosticStatus& status, const std::string& key, const std::string& value)
+{
+    diagnostic_msgs::KeyValue key_value;
+    key_value.key = key;
+    key_value.value = value;
+    status.values.push_back(key_value);
+}
+
+std::string formatSeconds(double seconds)
+{
+    std::ostringstream stream;
+    stream << std::fixed << std::setprecision(4) << seconds;
+    return stream.str();
+}
+
+} // namespace
+
+ReconstructionTiming::Scope::Scope(ReconstructionTiming& timing, const std::string& step)
+    : timing(&timing),
+      step(step),
+      start(Clock::now())
+{
+}
+
+ReconstructionTiming::Scope::~Scope()
+{
+    stop();
+}
+
+void ReconstructionTiming::Scope::stop()
+{
+    if (timing)
+    {
+        const Clock::time_point end = Clock::now();
+        timing->add(step, std::chrono::duration<double>(end - start).count());
+        if (TraceRecorder* recorder = TraceRecorder::current())
+        {
+            recorder->record(step, "stage", start, end);
+        }
+        timing = nullptr;
+    }
+}
+
+ReconstructionTiming::ReconstructionTiming()
+    : start(Clock::now()),
+      start_memory(residentMemory()),
+      input_points(0),
+      output_vertices(0),
+      output_faces(0),
+      reused(false)
+{
+}
+
+void ReconstructionTiming::add(const std::string& step, double seconds)
+{
+    const size_t resident_memory = residentMemory();
+    auto it = std::find_if(durations.begin(), durations.end(),
+        [&step](const Step& duration) { return duration.name == step; });
+    if (it != durations.end())
+    {
+        it->seconds += seconds;
+        it->resident_memory = resident_memory;
+    }
+    else
+    {
+        durations.push_back(Step{step, seconds, resident_memory});
+    }
+}
+
+void ReconstructionTiming::setInputSize(size_t points)
+{
+    input_points = points;
+}
+
+void ReconstructionTiming::setOutputSize(size_t vertices, size_t faces)
+{
+    output_vertices = vertices;
+    output_faces = faces;
+}
+
+void ReconstructionTiming::setReused(bool reused)
+{
+    this->reused = reused;
+}
+
+double ReconstructionTiming::totalSeconds() const
+{
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+const std::vector<ReconstructionTiming::Step>& ReconstructionTiming::steps() const
+{
+    return durations;
+}
+
+void ReconstructionTiming::toDiagnosticStatus(diagnostic_msgs::DiagnosticStatus& status) const
+{
+    const double total = totalSeconds();
+    addValue(status, "input points", std::to_string(input_points));
+    addValue(status, "output vertices", std::to_string(output_vertices));
+    addValue(status, "output faces", std::to_string(output_faces));
+    addValue(status, "reused", reused ? "true" : "false");
+    addValue(status, "total [s]", formatSeconds(total));
+    addValue(status, "points per second", std::to_string(static_cast<uint64_t>(total > 0.0 ? input_points / total : 0.0)));
+    addValue(status, "memory growth [MB]", std::to_string(memoryGrowth() / (1024 * 1024)));
+    addValue(status, "resident memory [MB]", std::to_string(residentMemory() / (1024 * 1024)));
+    addValue(status, "process peak memory [MB]", std::to_string(peakMemory() / (1024 * 1024)));
+    for (const auto& duration : durations)
+    {
+        addValue(status, duration.name + " [s]", formatSeconds(duration.seconds));
+    }
+}
+
+void ReconstructionTiming::writeJson(std::ostream& out) const
+{
+    const double total = totalSeconds();
+    out << "{\"input_points\": " << input_points
+        << ", \"output_vertices\": " << output_vertices
+        << ", \"output_faces\": " << output_faces
+        << ", \"reused\": " << (reused ? "true" : "false")
+        << ", \"total_seconds\": " << formatSeconds(total)
+        << ", \"points_per_second\": " << static_cast<uint64_t>(total > 0.0 ? input_points / total : 0.0)
+        << ", \"memory_growth_bytes\": " << memoryGrowth()
+        << ", \"resident_memory_bytes\": " << residentMemory()
+        << ", \"process_peak_memory_bytes\": " << peakMemory()
+        << ", \"steps\": [";
+    for (size_t i = 0; i < durations.size(); i++)
+    {
+        out << (i == 0 ? "" : ", ") << "{\"name\": \"" << durations[i].name << "\", \"seconds\": "
+            << formatSeconds(durations[i].seconds) << ", \"resident_memory_bytes\": " << durations[i].resident_memory << "}";
+    }
+    out << "]}";
+}
+
+std::string ReconstructionTiming::summary() const
+{
+    const double total = totalSeconds();
+    std::ostringstream stream;
+    stream << std::fixed << std::setprecision(3) << input_points << " points to " << output_vertices
+        << " vertices and " << output_faces << " faces in " << total << " s";
+    if (total > 0.0)
+    {
+        stream << " (" << static_cast<uint64_t>(input_points / total) << " points/s)";
+    }
+
+    std::vector<Step> slowest(durations);
+    std::sort(slowest.begin(), slowest.end(),
+        [](const Step& a, const Step& b)
+        {
+            return a.seconds > b.seconds;
+        });
+    slowest.resize(std::min(slowest.size(), SUMMARY_STEPS));
+    for (size_t i = 0; i < slowest.size(); i++)
+    {
+        stream << (i == 0 ? ", slowest: " : ", ") << slowest[i].name << " " << slowest[i].seconds << " s";
+    }
+    return stream.str();
+}
+
+size_t ReconstructionTiming::memoryGrowth() const
+{
+    size_t growth = 0;
+    for (const auto& duration : durations)
+    {
+        if (duration.resident_memory > start_memory)
+        {
+            growth = std::max(growth, duration.resident_memory - start_memory);
+        }
+    }
+    return growth;
+}
+
+size_t ReconstructionTiming::residentMemory()
+{
+    // the second value of statm is the number of resident pages
+    std::ifstream statm("/proc/self/statm");
+    size_t size = 0, resident = 0;
+    if (!(statm >> size >> resident))
+    {
+        return 0;
+    }
+    return resident * static_cast<size_t>(sysconf(_SC_PAGESIZE));
+}
+
+size_t ReconstructionTiming::peakMemory()
+{
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+    {
+        return 0;
+    }
+    // kilobytes on Linux
+    return static_cast<size_t>(usage.ru_maxrss) * 1024;
+}
+
+} // namespace lvr_ros
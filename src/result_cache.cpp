@@ -0,0 +1,311 @@
+/*
+ * UOS-ROS packages - Robot Operating System code by the University of Osnabrück
+ * Copyright (C) 2013 University of Osnabrück
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * result_cache.cpp
+ *
+ */
+
+#include "lvr_ros/result_cache.h"
+#include "lvr_ros/kernels.h"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <vector>
+
+#include <dynamic_reconfigure/Config.h>
+#include <ros/console.h>
+
+namespace lvr_ros
+{
+
+namespace
+{
+
+// part of every key, change it whenever the hashed data or the pipeline output changes
+const uint64_t KEY_VERSION = 1;
+
+// length of the textual UUIDs of the meshes
+const size_t UUID_LENGTH = 36;
+
+// parameters which do not change the reconstructed mesh
+const char* const IGNORED_PARAMETERS[] = {"threads", "trace", "traceDir"};
+
+bool isIgnored(const std::string& name)
+{
+    return std::find(std::begin(IGNORED_PARAMETERS), std::end(IGNORED_PARAMETERS), name)
+        != std::end(IGNORED_PARAMETERS);
+}
+
+uint64_t hashString(const std::string& value, uint64_t seed)
+{
+    return kernels::xxh64(value.data(), value.size(), seed);
+}
+
+} // namespace
+
+uint64_t hashPointCloud(const sensor_msgs::PointCloud2& cloud)
+{
+    std::ostringstream layout;
+    layout << cloud.header.frame_id << '\n'
+        << cloud.height << ' ' << cloud.width << ' ' << cloud.point_step << ' ' << cloud.row_step << ' '
+        << static_cast<int>(cloud.is_bigendian) << ' ' << static_cast<int>(cloud.is_dense) << '\n';
+    for (const auto& field : cloud.fields)
+    {
+        layout << field.name << ' ' << field.offset << ' ' << static_cast<int>(field.datatype) << ' '
+            << field.count << '\n';
+    }
+
+    const uint64_t data_hash = kernels::contentHash(cloud.data.data(), cloud.data.size());
+    return hashString(layout.str(), data_hash);
+}
+
+uint64_t hashConfig(const ReconstructionConfig& config)
+{
+    dynamic_reconfigure::Config message;
+    config.__toMessage__(message);
+
+    // one line per parameter, doubles with all bits, sorted by name
+    std::vector<std::string> parameters;
+    auto add = [&](const std::string& name, const std::string& value)
+    {
+        if (!isIgnored(name))
+        {
+            parameters.push_back(name + '=' + value);
+        }
+    };
+    for (const auto& parameter : message.bools)
+    {
+        add(parameter.name, parameter.value ? "true" : "false");
+    }
+    for (const auto& parameter : message.ints)
+    {
+        add(parameter.name, std::to_string(parameter.value));
+    }
+    for (const auto& parameter : message.doubles)
+    {
+        std::ostringstream value;
+        value << std::hexfloat << parameter.value;
+        add(parameter.name, value.str());
+    }
+    for (const auto& parameter : message.strs)
+    {
+        add(parameter.name, '"' + parameter.value + '"');
+    }
+    std::sort(parameters.begin(), parameters.end());
+
+    std::string canonical;
+    for (const auto& parameter : parameters)
+    {
+        canonical += parameter;
+        canonical += '\n';
+    }
+    return hashString(canonical, KEY_VERSION);
+}
+
+ResultCache::ResultCache(
+    const std::string& directory,
+    size_t max_entries,
+    const std::function<bool(const std::string&)>& available
+)
+    : directory(directory),
+      max_entries(std::max<size_t>(1, max_entries)),
+      index_lines(0)
+{
+    if (directory.empty())
+    {
+        return;
+    }
+
+    std::error_code error;
+    std::filesystem::create_directories(directory, error);
+    if (error)
+    {
+        ROS_ERROR_STREAM("Could not create the result cache directory " << directory << ": " << error.message());
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    if (readIndex(available))
+    {
+        ROS_INFO_STREAM("Read " << results.size() << " reconstruction results from " << directory << ".");
+    }
+}
+
+uint64_t ResultCache::key(const sensor_msgs::PointCloud2& cloud, const ReconstructionConfig& config)
+{
+    const uint64_t cloud_hash = hashPointCloud(cloud);
+    const uint64_t config_hash = hashConfig(config);
+    const uint64_t hashes[] = {cloud_hash, config_hash};
+    return kernels::xxh64(hashes, sizeof(hashes), KEY_VERSION);
+}
+
+std::string ResultCache::find(uint64_t key)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = results.find(key);
+    if (it == results.end())
+    {
+        return std::string();
+    }
+    order.splice(order.begin(), order, it->second.position);
+    return it->second.uuid;
+}
+
+void ResultCache::insert(uint64_t key, const std::string& uuid)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    add(key, uuid);
+    if (directory.empty())
+    {
+        return;
+    }
+
+    // compact the index once it may be mostly made of replaced and dropped results
+    if (index_lines >= 2 * max_entries)
+    {
+        writeIndex();
+        return;
+    }
+    std::ofstream index(directory + "/index", std::ios::app);
+    index << std::hex << std::setw(16) << std::setfill('0') << key << std::dec << ' ' << uuid << '\n';
+    if (!index)
+    {
+        ROS_ERROR_STREAM("Could not append to the result index in " << directory << "!");
+        return;
+    }
+    index_lines++;
+}
+
+void ResultCache::erase(uint64_t key, const std::string& uuid)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = results.find(key);
+    if (it != results.end() && it->second.uuid == uuid)
+    {
+        order.erase(it->second.position);
+        results.erase(it);
+    }
+}
+
+bool ResultCache::persistent() const
+{
+    return !directory.empty();
+}
+
+void ResultCache::add(uint64_t key, const std::string& uuid)
+{
+    auto it = results.find(key);
+    if (it != results.end())
+    {
+        it->second.uuid = uuid;
+        order.splice(order.begin(), order, it->second.position);
+        return;
+    }
+
+    order.push_front(key);
+    results[key] = Result{uuid, order.begin()};
+    if (results.size() > max_entries)
+    {
+        results.erase(order.back());
+        order.pop_back();
+    }
+}
+
+bool ResultCache::readIndex(const std::function<bool(const std::string&)>& available)
+{
+    std::ifstream index(directory + "/index");
+    if (!index)
+    {
+        return false;
+    }
+
+    // later lines replace earlier ones with the same key, a line cut off by a crash is skipped
+    std::vector<std::pair<uint64_t, std::string>> lines;
+    std::string line;
+    while (std::getline(index, line))
+    {
+        std::istringstream fields(line);
+        uint64_t key;
+        std::string uuid;
+        if (!(fields >> std::hex >> key >> std::dec >> uuid) || uuid.size() != UUID_LENGTH)
+        {
+            ROS_WARN_STREAM("Skipping the malformed result index line \"" << line << "\".");
+            continue;
+        }
+        lines.emplace_back(key, uuid);
+    }
+    index.close();
+
+    size_t num_unavailable = 0;
+    for (const auto& result : lines)
+    {
+        if (!available || available(result.second))
+        {
+            add(result.first, result.second);
+        }
+        else
+        {
+            num_unavailable++;
+        }
+    }
+    if (num_unavailable > 0)
+    {
+        ROS_INFO_STREAM("Dropped " << num_unavailable << " reconstruction results whose meshes are no longer stored.");
+    }
+
+    index_lines = lines.size();
+    if (index_lines > results.size())
+    {
+        writeIndex();
+    }
+    return true;
+}
+
+bool ResultCache::writeIndex()
+{
+    // the least recently used result first, so it is dropped first when the index is read again
+    const std::string path = directory + "/index";
+    const std::string temporary = path + ".tmp";
+    {
+        std::ofstream index(temporary, std::ios::trunc);
+        for (auto it = order.rbegin(); it != order.rend(); ++it)
+        {
+            index << std::hex << std::setw(16) << std::setfill('0') << *it << std::dec << ' '
+                << results[*it].uuid << '\n';
+        }
+        if (!index)
+        {
+            ROS_ERROR_STREAM("Could not rewrite the result index in " << directory << "!");
+            return false;
+        }
+    }
+
+    std::error_code error;
+    std::filesystem::rename(temporary, path, error);
+    if (error)
+    {
+        ROS_ERROR_STREAM("Could not replace the result index in " << directory << ": " << error.message());
+        return false;
+    }
+    index_lines = results.size();
+    return true;
+}
+
+} // namespace lvr_ros
@@ -0,0 +1,360 @@
+/*
+ * UOS-ROS packages - Robot Operating System code by the University of Osnabrück
+ * Copyright (C) 2013 University of Osnabrück
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * synthetic_scenes.cpp
+ *
+ */
+
+#include "lvr_ros/synthetic_scenes.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+namespace lvr_ros
+{
+
+namespace
+{
+
+const double PI = 3.14159265358979323846;
+
+// proportions of the corridor relative to its length
+const double CORRIDOR_WIDTH = 0.1;
+const double CORRIDOR_HEIGHT = 0.125;
+
+// height of the room relative to its edge length
+const double ROOM_HEIGHT = 0.45;
+
+// horizontal field of view of the depth camera, the vertical one follows from the 4:3 image
+const double DEPTH_FIELD_OF_VIEW = 60.0 * PI / 180.0;
+
+// maximum range of the depth camera relative to the edge length of its room
+const double DEPTH_RANGE = 0.6;
+
+/**
+ * The random sequence of a single point, splitmix64 seeded with the scene seed and the index
+ */
+class PointRandom
+{
+public:
+    PointRandom(uint64_t seed, uint64_t index)
+        : state(seed ^ (index * 0xd1b54a32d192ed03ull))
+    {
+    }
+
+    uint64_t next()
+    {
+        uint64_t z = (state += 0x9e3779b97f4a7c15ull);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+        return z ^ (z >> 31);
+    }
+
+    // uniform in [0, 1)
+    double uniform()
+    {
+        return (next() >> 11) * (1.0 / 9007199254740992.0);
+    }
+
+    // standard normal distributed, Box-Muller
+    double gaussian()
+    {
+        const double u = 1.0 - uniform();
+        return std::sqrt(-2.0 * std::log(u)) * std::cos(2.0 * PI * uniform());
+    }
+
+private:
+    uint64_t state;
+};
+
+// axis aligned rectangle: origin + a * u + b * v with a, b in [0, 1)
+struct Rectangle
+{
+    double origin[3];
+    double u[3];
+    double v[3];
+    double area;
+};
+
+Rectangle rectangle(
+    double ox, double oy, double oz,
+    double ux, double uy, double uz,
+    double vx, double vy, double vz)
+{
+    Rectangle r = {{ox, oy, oz}, {ux, uy, uz}, {vx, vy, vz}, 0.0};
+    const double u_length = std::sqrt(ux * ux + uy * uy + uz * uz);
+    const double v_length = std::sqrt(vx * vx + vy * vy + vz * vz);
+    r.area = u_length * v_length;
+    return r;
+}
+
+// the floor, the ceiling and the walls of a box centered around the origin in x and y
+std::vector<Rectangle> boxRectangles(double length, double width, double height, bool closed)
+{
+    const double x = -length / 2, y = -width / 2;
+    std::vector<Rectangle> rectangles = {
+        rectangle(x, y, 0, length, 0, 0, 0, width, 0),
+        rectangle(x, y, height, length, 0, 0, 0, width, 0),
+        rectangle(x, y, 0, length, 0, 0, 0, 0, height),
+        rectangle(x, -y, 0, length, 0, 0, 0, 0, height)
+    };
+    if (closed)
+    {
+        rectangles.push_back(rectangle(x, y, 0, 0, width, 0, 0, 0, height));
+        rectangles.push_back(rectangle(-x, y, 0, 0, width, 0, 0, 0, height));
+    }
+    return rectangles;
+}
+
+std::vector<Rectangle> sceneRectangles(const SyntheticScene& scene)
+{
+    if (scene.type == SyntheticScene::ROOM)
+    {
+        return boxRectangles(scene.size, scene.size, scene.size * ROOM_HEIGHT, true);
+    }
+    if (scene.type == SyntheticScene::CORRIDOR)
+    {
+        return boxRectangles(scene.size, scene.size * CORRIDOR_WIDTH, scene.size * CORRIDOR_HEIGHT, false);
+    }
+    return std::vector<Rectangle>();
+}
+
+void sampleRectangles(const std::vector<Rectangle>& rectangles, PointRandom& random, float* point)
+{
+    double total = 0.0;
+    for (const auto& r : rectangles)
+    {
+        total += r.area;
+    }
+    // pick a rectangle proportional to its area
+    double pick = random.uniform() * total;
+    const Rectangle* r = &rectangles.back();
+    for (const auto& candidate : rectangles)
+    {
+        if (pick < candidate.area)
+        {
+            r = &candidate;
+            break;
+        }
+        pick -= candidate.area;
+    }
+    const double a = random.uniform(), b = random.uniform();
+    for (int k = 0; k < 3; k++)
+    {
+        point[k] = static_cast<float>(r->origin[k] + a * r->u[k] + b * r->v[k]);
+    }
+}
+
+void sampleSphere(double radius, PointRandom& random, float* point)
+{
+    const double z = 2.0 * random.uniform() - 1.0;
+    const double phi = 2.0 * PI * random.uniform();
+    const double r = std::sqrt(std::max(0.0, 1.0 - z * z));
+    point[0] = static_cast<float>(radius * r * std::cos(phi));
+    point[1] = static_cast<float>(radius * r * std::sin(phi));
+    point[2] = static_cast<float>(radius * z);
+}
+
+double terrainHeight(double size, double x, double y)
+{
+    const double f = 2.0 * PI / size;
+    // rolling hills, a ridge and a rough high frequency part
+    return 0.04 * size * std::sin(2 * f * x) * std::cos(3 * f * y)
+        + 0.02 * size * std::sin(5 * f * (x + y))
+        + 0.002 * size * std::sin(41 * f * x) * std::sin(37 * f * y);
+}
+
+void sampleTerrain(double size, PointRandom& random, float* point)
+{
+    const double x = (random.uniform() - 0.5) * size;
+    const double y = (random.uniform() - 0.5) * size;
+    point[0] = static_cast<float>(x);
+    point[1] = static_cast<float>(y);
+    point[2] = static_cast<float>(terrainHeight(size, x, y));
+}
+
+/**
+ * The first hit of the ray (dx, dy, dz) from the origin, in the camera frame with z pointing
+ * forward, inside a cube of the edge length size with a ball in front of the camera
+ */
+double castDepthRay(double size, double dx, double dy, double dz)
+{
+    const double half = size / 2;
+    double distance = std::numeric_limits<double>::infinity();
+    const double direction[3] = {dx, dy, dz};
+    for (int k = 0; k < 3; k++)
+    {
+        if (direction[k] != 0.0)
+        {
+            distance = std::min(distance, half / std::abs(direction[k]));
+        }
+    }
+
+    // ball at (0, 0, size / 4) with radius size / 10
+    const double center = size / 4, radius = size / 10;
+    const double b = dz * center;
+    const double c = center * center - radius * radius;
+    const double discriminant = b * b - c;
+    if (discriminant >= 0.0)
+    {
+        const double hit = b - std::sqrt(discriminant);
+        if (hit > 0.0)
+        {
+            distance = std::min(distance, hit);
+        }
+    }
+    return distance;
+}
+
+void sampleDepthGrid(const SyntheticScene& scene, size_t width, size_t height, size_t index, float* point)
+{
+    PointRandom random(scene.seed, index);
+    const double focal = (width / 2.0) / std::tan(DEPTH_FIELD_OF_VIEW / 2);
+    const double column = static_cast<double>(index % width) + 0.5 - width / 2.0;
+    const double row = static_cast<double>(index / width) + 0.5 - height / 2.0;
+    const double norm = std::sqrt(column * column + row * row + focal * focal);
+    const double dx = column / norm, dy = row / norm, dz = focal / norm;
+
+    double distance = castDepthRay(scene.size, dx, dy, dz) + scene.noise * random.gaussian();
+    if (distance > DEPTH_RANGE * scene.size)
+    {
+        point[0] = point[1] = point[2] = std::numeric_limits<float>::quiet_NaN();
+        return;
+    }
+    point[0] = static_cast<float>(dx * distance);
+    point[1] = static_cast<float>(dy * distance);
+    point[2] = static_cast<float>(dz * distance);
+}
+
+} // namespace
+
+bool parseSyntheticSceneType(const std::string& name, SyntheticScene::Type& type)
+{
+    for (int t = SyntheticScene::ROOM; t <= SyntheticScene::DEPTH_GRID; t++)
+    {
+        if (name == syntheticSceneTypeName(static_cast<SyntheticScene::Type>(t)))
+        {
+            type = static_cast<SyntheticScene::Type>(t);
+            return true;
+        }
+    }
+    return false;
+}
+
+const char* syntheticSceneTypeName(SyntheticScene::Type type)
+{
+    switch (type)
+    {
+        case SyntheticScene::ROOM: return "room";
+        case SyntheticScene::CORRIDOR: return "corridor";
+        case SyntheticScene::SPHERE: return "sphere";
+        case SyntheticScene::TERRAIN: return "terrain";
+        case SyntheticScene::DEPTH_GRID: return "depth_grid";
+    }
+    return "unknown";
+}
+
+double syntheticSceneArea(const SyntheticScene& scene)
+{
+    switch (scene.type)
+    {
+        case SyntheticScene::ROOM:
+        case SyntheticScene::CORRIDOR:
+        {
+            double area = 0.0;
+            for (const auto& r : sceneRectangles(scene))
+            {
+                area += r.area;
+            }
+            return area;
+        }
+        case SyntheticScene::SPHERE:
+            return PI * scene.size * scene.size;
+        case SyntheticScene::TERRAIN:
+            return scene.size * scene.size;
+        case SyntheticScene::DEPTH_GRID:
+            break;
+    }
+    return 0.0;
+}
+
+void generateSyntheticScene(const SyntheticScene& scene, sensor_msgs::PointCloud2& cloud, const std::string& frame)
+{
+    size_t width = scene.points, height = 1;
+    if (scene.type == SyntheticScene::DEPTH_GRID)
+    {
+        width = std::max<size_t>(1, static_cast<size_t>(std::lround(std::sqrt(scene.points * 4.0 / 3.0))));
+        height = std::max<size_t>(1, scene.points / width);
+    }
+    const size_t n = width * height;
+
+    cloud.header.frame_id = frame;
+    cloud.height = static_cast<uint32_t>(height);
+    cloud.width = static_cast<uint32_t>(width);
+    cloud.fields.resize(3);
+    const char* names[3] = {"x", "y", "z"};
+    for (int k = 0; k < 3; k++)
+    {
+        cloud.fields[k].name = names[k];
+        cloud.fields[k].offset = 4 * k;
+        cloud.fields[k].datatype = sensor_msgs::PointField::FLOAT32;
+        cloud.fields[k].count = 1;
+    }
+    cloud.is_bigendian = false;
+    cloud.point_step = 12;
+    cloud.row_step = cloud.point_step * cloud.width;
+    cloud.is_dense = scene.type != SyntheticScene::DEPTH_GRID;
+    cloud.data.resize(n * cloud.point_step);
+
+    float* points = reinterpret_cast<float*>(cloud.data.data());
+    const std::vector<Rectangle> rectangles = sceneRectangles(scene);
+    const int64_t count = static_cast<int64_t>(n);
+
+    #pragma omp parallel for schedule(static)
+    for (int64_t i = 0; i < count; i++)
+    {
+        float* point = points + i * 3;
+        if (scene.type == SyntheticScene::DEPTH_GRID)
+        {
+            sampleDepthGrid(scene, width, height, static_cast<size_t>(i), point);
+            continue;
+        }
+
+        PointRandom random(scene.seed, static_cast<uint64_t>(i));
+        if (scene.type == SyntheticScene::SPHERE)
+        {
+            sampleSphere(scene.size / 2, random, point);
+        }
+        else if (scene.type == SyntheticScene::TERRAIN)
+        {
+            sampleTerrain(scene.size, random, point);
+        }
+        else
+        {
+            sampleRectangles(rectangles, random, point);
+        }
+        for (int k = 0; k < 3; k++)
+        {
+            point[k] += static_cast<float>(scene.noise * random.gaussian());
+        }
+    }
+}
+
+} // namespace lvr_ros
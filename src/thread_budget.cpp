@@ -0,0 +1,53 @@
+/*
+ * UOS-ROS packages - Robot Operating System code by the University of Osnabrück
+ * Copyright (C) 2013 University of Osnabrück
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * thread_budget.cpp
+ *
+ */
+
+#include "lvr_ros/thread_budget.h"
+
+#include <algorithm>
+
+#include <lvr2/config/lvropenmp.hpp>
+
+namespace lvr_ros
+{
+
+void setThreadLimit(size_t threads)
+{
+    lvr2::OpenMPConfig::setNumThreads(static_cast<int>(std::max<size_t>(1, threads)));
+}
+
+size_t threadLimit()
+{
+    return static_cast<size_t>(std::max(1, lvr2::OpenMPConfig::getNumThreads()));
+}
+
+ScopedThreadLimit::ScopedThreadLimit(size_t threads)
+    : previous(threadLimit())
+{
+    setThreadLimit(std::min(std::max<size_t>(1, threads), previous));
+}
+
+ScopedThreadLimit::~ScopedThreadLimit()
+{
+    setThreadLimit(previous);
+}
+
+} // namespace lvr_ros
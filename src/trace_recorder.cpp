@@ -0,0 +1,198 @@
+/*
+ * UOS-ROS packages - Robot Operating System code by the University of Osnabrück
+ * Copyright (C) 2013 University of Osnabrück
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * trace_recorder.cpp
+ *
+ */
+
+#include "lvr_ros/trace_recorder.h"
+#include "lvr_ros/kernels.h"
+
+#include <atomic>
+#include <fstream>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+namespace lvr_ros
+{
+
+namespace
+{
+
+std::atomic<int> next_thread_id(1);
+thread_local const int thread_id = next_thread_id++;
+thread_local TraceRecorder* active_recorder = nullptr;
+
+// start of the current kernel region of the thread, the regions of a thread do not nest
+thread_local TraceRecorder::Clock::time_point region_start;
+
+void kernelTraceHook(void* context, const char* region, bool begin)
+{
+    if (begin)
+    {
+        region_start = TraceRecorder::Clock::now();
+    }
+    else
+    {
+        static_cast<TraceRecorder*>(context)->record(region, "openmp", region_start, TraceRecorder::Clock::now());
+    }
+}
+
+std::string escapeJson(const std::string& value)
+{
+    std::string escaped;
+    escaped.reserve(value.size());
+    for (char c : value)
+    {
+        if (c == '"' || c == '\\')
+        {
+            escaped += '\\';
+            escaped += c;
+        }
+        else if (static_cast<unsigned char>(c) < 0x20)
+        {
+            escaped += ' ';
+        }
+        else
+        {
+            escaped += c;
+        }
+    }
+    return escaped;
+}
+
+} // namespace
+
+TraceRecorder::Activation::Activation(TraceRecorder* recorder, const std::string& thread_name)
+    : previous(active_recorder)
+{
+    active_recorder = recorder;
+    if (recorder)
+    {
+        recorder->nameThread(thread_id, thread_name);
+        kernels::setTraceHook(kernelTraceHook);
+    }
+    kernels::setTraceContext(recorder);
+}
+
+TraceRecorder::Activation::~Activation()
+{
+    active_recorder = previous;
+    kernels::setTraceContext(previous);
+}
+
+TraceRecorder::Span::Span(const char* name, const char* category)
+    : recorder(active_recorder),
+      name(name),
+      category(category)
+{
+    if (recorder)
+    {
+        start = Clock::now();
+    }
+}
+
+TraceRecorder::Span::~Span()
+{
+    stop();
+}
+
+void TraceRecorder::Span::stop()
+{
+    if (recorder)
+    {
+        recorder->record(name, category, start, Clock::now());
+        recorder = nullptr;
+    }
+}
+
+TraceRecorder::TraceRecorder(const std::string& name)
+    : name(name),
+      origin(Clock::now())
+{
+}
+
+TraceRecorder* TraceRecorder::current()
+{
+    return active_recorder;
+}
+
+void TraceRecorder::record(const std::string& name, const char* category, Clock::time_point start, Clock::time_point end)
+{
+    Event event;
+    event.name = name;
+    event.category = category;
+    event.thread = thread_id;
+    event.start_us = std::chrono::duration_cast<std::chrono::microseconds>(start - origin).count();
+    event.duration_us = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+
+    std::string thread_name = "thread " + std::to_string(thread_id);
+#ifdef _OPENMP
+    if (omp_in_parallel())
+    {
+        thread_name = "OpenMP thread " + std::to_string(thread_id);
+    }
+#endif
+
+    std::lock_guard<std::mutex> lock(mutex);
+    events.push_back(std::move(event));
+    thread_names.emplace(thread_id, thread_name);
+}
+
+void TraceRecorder::nameThread(int thread, const std::string& name)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    thread_names.emplace(thread, name);
+}
+
+bool TraceRecorder::write(const std::string& path) const
+{
+    std::ofstream out(path);
+    if (!out)
+    {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    out << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\""
+        << escapeJson(name) << "\"}}";
+    for (const auto& thread_name : thread_names)
+    {
+        out << ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << thread_name.first
+            << ",\"args\":{\"name\":\"" << escapeJson(thread_name.second) << "\"}}";
+    }
+    for (const auto& event : events)
+    {
+        out << ",\n{\"name\":\"" << escapeJson(event.name) << "\",\"cat\":\"" << event.category
+            << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << event.thread << ",\"ts\":" << event.start_us
+            << ",\"dur\":" << event.duration_us << "}";
+    }
+    out << "\n]}\n";
+    return static_cast<bool>(out);
+}
+
+size_t TraceRecorder::numEvents() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return events.size();
+}
+
+} // namespace lvr_ros
@@ -0,0 +1,279 @@
+/*
+ * UOS-ROS packages - Robot Operating System code by the University of Osnabrück
+ * Copyright (C) 2013 University of Osnabrück
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ *
+ * voxel_filter.cpp
+ *
+ */
+
+#include "lvr_ros/voxel_filter.h"
+#include "lvr_ros/kernels.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <map>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include <ros/console.h>
+
+namespace lvr_ros
+{
+
+namespace
+{
+
+// bits of a cell coordinate in the key of a cell
+const int KEY_BITS = 21;
+const uint64_t MAX_CELL = (uint64_t(1) << KEY_BITS) - 1;
+
+// key of the points with non-finite coordinates, sorted behind all cells
+const uint64_t INVALID_KEY = std::numeric_limits<uint64_t>::max();
+
+// below this number of points, the points are sorted by a single thread
+const size_t PARALLEL_SORT_THRESHOLD = 1 << 16;
+
+struct CellEntry
+{
+    uint64_t key;
+    uint32_t index;
+
+    bool operator<(const CellEntry& other) const
+    {
+        return key < other.key || (key == other.key && index < other.index);
+    }
+};
+
+/**
+ * Sorts chunks of the entries in parallel and merges them pairwise, the entries are unique, so
+ * the order does not depend on the number of threads
+ */
+void parallelSort(std::vector<CellEntry>& entries)
+{
+    size_t threads = 1;
+#ifdef _OPENMP
+    threads = static_cast<size_t>(std::max(1, omp_get_max_threads()));
+#endif
+    if (threads == 1 || entries.size() < PARALLEL_SORT_THRESHOLD)
+    {
+        std::sort(entries.begin(), entries.end());
+        return;
+    }
+
+    size_t chunks = 1;
+    while (chunks < threads)
+    {
+        chunks *= 2;
+    }
+    std::vector<size_t> bounds(chunks + 1);
+    for (size_t c = 0; c <= chunks; c++)
+    {
+        bounds[c] = entries.size() * c / chunks;
+    }
+    const auto begin = entries.begin();
+
+    #pragma omp parallel for schedule(dynamic, 1)
+    for (int64_t c = 0; c < static_cast<int64_t>(chunks); c++)
+    {
+        std::sort(begin + bounds[c], begin + bounds[c + 1]);
+    }
+    for (size_t width = 1; width < chunks; width *= 2)
+    {
+        #pragma omp parallel for schedule(dynamic, 1)
+        for (int64_t c = 0; c < static_cast<int64_t>(chunks); c += 2 * width)
+        {
+            std::inplace_merge(begin + bounds[c], begin + bounds[c + width], begin + bounds[c + 2 * width]);
+        }
+    }
+}
+
+/**
+ * Averages every channel of type T over the points of each cell, the points of cell k are
+ * entries[first[k]] to entries[first[k + 1]] - 1
+ */
+template<typename T>
+void averageChannels(
+    lvr2::PointBuffer& input,
+    size_t num_points,
+    const std::vector<CellEntry>& entries,
+    const std::vector<uint32_t>& first,
+    lvr2::PointBuffer& output)
+{
+    std::map<std::string, lvr2::Channel<T>> channels;
+    input.getAllChannelsOfType<T>(channels);
+    const size_t num_cells = first.size() - 1;
+    for (auto& channel : channels)
+    {
+        if (channel.second.numElements() != num_points)
+        {
+            ROS_WARN_STREAM("Channel \"" << channel.first << "\" has " << channel.second.numElements()
+                << " instead of " << num_points << " elements, ignore it!");
+            continue;
+        }
+        const size_t width = channel.second.width();
+        const T* values = channel.second.dataPtr().get();
+        boost::shared_array<T> averaged(new T[num_cells * width]);
+        const bool normalize = channel.first == "normals" && width == 3;
+
+        #pragma omp parallel for schedule(static)
+        for (int64_t k = 0; k < static_cast<int64_t>(num_cells); k++)
+        {
+            double sum[16];
+            for (size_t offset = 0; offset < width; offset += 16)
+            {
+                const size_t block = std::min<size_t>(16, width - offset);
+                std::fill(sum, sum + block, 0.0);
+                for (uint32_t e = first[k]; e < first[k + 1]; e++)
+                {
+                    const T* value = values + static_cast<size_t>(entries[e].index) * width + offset;
+                    for (size_t w = 0; w < block; w++)
+                    {
+                        sum[w] += value[w];
+                    }
+                }
+                const double count = first[k + 1] - first[k];
+                double length = 1.0;
+                if (normalize)
+                {
+                    length = std::sqrt(sum[0] * sum[0] + sum[1] * sum[1] + sum[2] * sum[2]) / count;
+                    if (length == 0.0)
+                    {
+                        length = 1.0;
+                    }
+                }
+                for (size_t w = 0; w < block; w++)
+                {
+                    const double mean = sum[w] / count / length;
+                    averaged[k * width + offset + w] = std::is_integral<T>::value
+                        ? static_cast<T>(std::lround(mean)) : static_cast<T>(mean);
+                }
+            }
+        }
+        output.addChannel<T>(averaged, channel.first, num_cells, width);
+    }
+}
+
+} // namespace
+
+bool voxelDownsample(const lvr2::PointBufferPtr& input, double leaf_size, lvr2::PointBufferPtr& output)
+{
+    const size_t n = input ? input->numPoints() : 0;
+    if (!(leaf_size > 0.0) || n == 0)
+    {
+        return false;
+    }
+    if (n > std::numeric_limits<uint32_t>::max())
+    {
+        ROS_ERROR_STREAM("Can not downsample more than " << std::numeric_limits<uint32_t>::max() << " points!");
+        return false;
+    }
+    const lvr2::floatArr points = input->getPointArray();
+    const int64_t count = static_cast<int64_t>(n);
+
+    // bounding box of the finite points
+    float min_x = std::numeric_limits<float>::max(), min_y = min_x, min_z = min_x;
+    float max_x = -min_x, max_y = -min_x, max_z = -min_x;
+    #pragma omp parallel for schedule(static) reduction(min: min_x, min_y, min_z) reduction(max: max_x, max_y, max_z)
+    for (int64_t i = 0; i < count; i++)
+    {
+        const float x = points[i * 3], y = points[i * 3 + 1], z = points[i * 3 + 2];
+        if (std::isfinite(x) && std::isfinite(y) && std::isfinite(z))
+        {
+            min_x = std::min(min_x, x);
+            min_y = std::min(min_y, y);
+            min_z = std::min(min_z, z);
+            max_x = std::max(max_x, x);
+            max_y = std::max(max_y, y);
+            max_z = std::max(max_z, z);
+        }
+    }
+    if (min_x > max_x)
+    {
+        return false;
+    }
+
+    const double extent = std::max({max_x - min_x, max_y - min_y, max_z - min_z});
+    if (extent / leaf_size >= static_cast<double>(MAX_CELL))
+    {
+        const double enlarged = extent / static_cast<double>(MAX_CELL - 1);
+        ROS_WARN_STREAM("The leaf size " << leaf_size << " is too small for a cloud of " << extent
+            << " m, using " << enlarged << ".");
+        leaf_size = enlarged;
+    }
+    const double inverse_leaf = 1.0 / leaf_size;
+
+    std::vector<CellEntry> entries(n);
+    #pragma omp parallel for schedule(static)
+    for (int64_t i = 0; i < count; i++)
+    {
+        const float x = points[i * 3], y = points[i * 3 + 1], z = points[i * 3 + 2];
+        uint64_t key = INVALID_KEY;
+        if (std::isfinite(x) && std::isfinite(y) && std::isfinite(z))
+        {
+            const uint64_t cx = std::min<uint64_t>(MAX_CELL, static_cast<uint64_t>((x - min_x) * inverse_leaf));
+            const uint64_t cy = std::min<uint64_t>(MAX_CELL, static_cast<uint64_t>((y - min_y) * inverse_leaf));
+            const uint64_t cz = std::min<uint64_t>(MAX_CELL, static_cast<uint64_t>((z - min_z) * inverse_leaf));
+            key = (cx << (2 * KEY_BITS)) | (cy << KEY_BITS) | cz;
+        }
+        entries[i] = CellEntry{key, static_cast<uint32_t>(i)};
+    }
+    parallelSort(entries);
+
+    // the finite points are sorted in front of the non-finite ones
+    const size_t num_finite = static_cast<size_t>(std::lower_bound(entries.begin(), entries.end(),
+        CellEntry{INVALID_KEY, 0}) - entries.begin());
+
+    // flag the first entry of every cell and turn the flags into the indices of the cells
+    std::vector<uint32_t> cell_index(num_finite);
+    #pragma omp parallel for schedule(static)
+    for (int64_t e = 0; e < static_cast<int64_t>(num_finite); e++)
+    {
+        cell_index[e] = e == 0 || entries[e].key != entries[e - 1].key ? 1 : 0;
+    }
+    std::vector<uint32_t> is_first(cell_index);
+    const uint32_t num_cells = kernels::exclusiveScan(cell_index.data(), num_finite);
+
+    std::vector<uint32_t> first(num_cells + 1);
+    first[num_cells] = static_cast<uint32_t>(num_finite);
+    #pragma omp parallel for schedule(static)
+    for (int64_t e = 0; e < static_cast<int64_t>(num_finite); e++)
+    {
+        if (is_first[e])
+        {
+            first[cell_index[e]] = static_cast<uint32_t>(e);
+        }
+    }
+
+    output.reset(new lvr2::PointBuffer);
+    averageChannels<char>(*input, n, entries, first, *output);
+    averageChannels<unsigned char>(*input, n, entries, first, *output);
+    averageChannels<short>(*input, n, entries, first, *output);
+    averageChannels<unsigned short>(*input, n, entries, first, *output);
+    averageChannels<int>(*input, n, entries, first, *output);
+    averageChannels<unsigned int>(*input, n, entries, first, *output);
+    averageChannels<float>(*input, n, entries, first, *output);
+    averageChannels<double>(*input, n, entries, first, *output);
+    return true;
+}
+
+} // namespace lvr_ros